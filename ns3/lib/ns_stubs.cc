@@ -178,11 +178,11 @@ ocaml_ns3_del_timer_event(value p_id) {
  */
 static void
 DeviceHandler(Ptr<NetDevice> dev) {
+  CAMLparam0();
+  CAMLlocal2(ml_name, ml_mac);
   string name;
   uint8_t *mac;
-  value ml_mac;
 
-  caml_register_global_root(&ml_mac);
   name = Names::FindName(dev->GetNode());
   nodes[name]->blocked_dev_mask = 
     (bool *)realloc(nodes[name]->blocked_dev_mask, nodes[name]->node->GetNDevices());
@@ -198,17 +198,17 @@ DeviceHandler(Ptr<NetDevice> dev) {
   free(mac);
 
   // passing event to caml code
+  ml_name = caml_copy_string((const char *)name.c_str());
   caml_callback3(*caml_named_value("plug_dev"), 
-      caml_copy_string((const char *)name.c_str()),
-      Val_int(dev->GetIfIndex()), ml_mac);
-  caml_remove_global_root(&ml_mac);
+      ml_name, Val_int(dev->GetIfIndex()), ml_mac);
+  CAMLreturn0;
 }
 
 bool
 PktDemux(Ptr<NetDevice> dev, Ptr<const Packet> pktIn, uint16_t proto, 
     const Address &src, const Address &dst, NetDevice::PacketType type) {
-  value ml_data;
-  caml_register_global_root(&ml_data);
+  CAMLparam0();
+  CAMLlocal2(ml_name, ml_data);
   Ptr<Packet> pkt = pktIn->Copy();
   int pkt_len = pkt->GetSize();
   if ((pkt_len < 10 ) || (pkt_len > 1514)) {
@@ -229,11 +229,10 @@ PktDemux(Ptr<NetDevice> dev, Ptr<const Packet> pktIn, uint16_t proto,
   }
 
   // call packet handling code in caml
+  ml_name = caml_copy_string((const char *)node_name.c_str());
   caml_callback3(*ns3_cb->pkt_in_cb,
-      caml_copy_string((const char *)node_name.c_str()),
-      Val_int(dev->GetIfIndex()), ml_data );
-  caml_remove_global_root(&ml_data);
-  return true;
+      ml_name, Val_int(dev->GetIfIndex()), ml_data );
+  CAMLreturnT(bool, true);
 }
 
 CAMLprim value
@@ -477,17 +476,17 @@ ns3_init(void) {
 
 static void
 call_init_method (string name) {
-  value ml_name;
 #if USE_MPI
   if ((MpiInterface::GetSystemId ()) !=
       nodes[name]->node_id)
     return;
 #endif
-  caml_register_global_root(&ml_name);
+  CAMLparam0();
+  CAMLlocal1(ml_name);
   ml_name = caml_alloc_string(name.size());
   memcpy( String_val(ml_name), name.c_str(), name.size());
   caml_callback(*(ns3_cb->init_cb), ml_name);
-  caml_remove_global_root(&ml_name);
+  CAMLreturn0;
 }
 
 
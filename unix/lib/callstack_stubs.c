@@ -0,0 +1,65 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Code addresses of the frames of a [Printexc.raw_backtrace], for the
+   profilers of lib/memprof.ml and lib/profiler.ml.
+
+   Each slot of a raw backtrace is a pointer with its low bit set.  In
+   native code it points to the frame descriptor of the call site,
+   whose first word is the return address; in bytecode it is the
+   address of the bytecode instruction.  Only the native runtime
+   defines [caml_frame_descriptors], which tells them apart. */
+
+#include <stdint.h>
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/memory.h>
+
+extern void *caml_frame_descriptors __attribute__((weak));
+
+static uint64_t
+frame_pc(value slot)
+{
+  uintnat p = (uintnat) slot & ~(uintnat) 1;
+
+  if (&caml_frame_descriptors != NULL)
+    return *(uintnat *) p;
+  return p;
+}
+
+/* The frames of [bt] after the first [skip] ones, innermost first, as
+   64-bit little-endian words in a string. */
+CAMLprim value
+caml_callstack_frames(value bt, value vskip)
+{
+  CAMLparam1(bt);
+  CAMLlocal1(res);
+  mlsize_t n = Wosize_val(bt), skip = Long_val(vskip), i;
+  unsigned char *p;
+  uint64_t pc;
+  int j;
+
+  if (skip > n) skip = n;
+  res = caml_alloc_string(8 * (n - skip));
+  p = (unsigned char *) String_val(res);
+  for (i = skip; i < n; i++) {
+    pc = frame_pc(Field(bt, i));
+    for (j = 0; j < 8; j++) {
+      *p++ = pc & 0xFF;
+      pc >>= 8;
+    }
+  }
+  CAMLreturn(res);
+}
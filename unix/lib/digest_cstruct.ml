@@ -0,0 +1,26 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(* The order of the constructors is known to digest_stubs.c *)
+type algorithm = MD5 | SHA1 | SHA256
+
+let size = function MD5 -> 16 | SHA1 -> 20 | SHA256 -> 32
+
+external cstruct : algorithm -> Cstruct.t -> string = "caml_digest_cstruct"
+external cstructs : algorithm -> Cstruct.t list -> string
+  = "caml_digest_cstructs"
+external batch : algorithm -> Cstruct.t array -> string array
+  = "caml_digest_batch"
+
+let to_hex = Digest.to_hex
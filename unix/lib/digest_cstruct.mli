@@ -0,0 +1,39 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Message digests of cstructs.
+
+    The data is digested in place, so a packet or a disk block held in
+    an [Io_page] needs no copy to a string.  SHA-1 and SHA-256 use the
+    x86 SHA instructions when the CPU has them. *)
+
+type algorithm = MD5 | SHA1 | SHA256
+
+val size : algorithm -> int
+(** [size a] is the length in bytes of the digests computed by [a]:
+    16, 20 or 32. *)
+
+val cstruct : algorithm -> Cstruct.t -> string
+(** [cstruct a c] is the digest of the bytes of [c].  For [MD5] it is
+    the same as [Digest.string (Cstruct.to_string c)]. *)
+
+val cstructs : algorithm -> Cstruct.t list -> string
+(** [cstructs a cs] is the digest of the concatenation of [cs]. *)
+
+val batch : algorithm -> Cstruct.t array -> string array
+(** [batch a cs] is the array of the digests of each element of [cs],
+    computed in one call. *)
+
+val to_hex : string -> string
+(** [to_hex d] is the lowercase hexadecimal representation of [d]. *)
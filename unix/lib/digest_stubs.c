@@ -0,0 +1,467 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Message digests (MD5, SHA-1, SHA-256) over bigarray ranges and lists
+   of cstructs, so that packets and disk blocks are digested in place
+   rather than copied to a string first.  SHA-1 and SHA-256 use the x86
+   SHA extensions when CPUID reports them, and unrolled C otherwise.
+   MD5 is the runtime's own implementation. */
+
+#include <stdint.h>
+#include <string.h>
+#include <caml/mlvalues.h>
+#include <caml/memory.h>
+#include <caml/alloc.h>
+#include <caml/bigarray.h>
+#include <caml/md5.h>
+
+#if defined(__x86_64__) && defined(__GNUC__) && __GNUC__ >= 5
+#define HAVE_SHA_NI
+#include <immintrin.h>
+#endif
+
+/* Must match the order of the constructors of Digest_cstruct.algorithm */
+enum { DIGEST_MD5, DIGEST_SHA1, DIGEST_SHA256 };
+
+static const int digest_size[] = { 16, 20, 32 };
+
+struct sha_ctx {
+  uint32_t h[8];
+  uint64_t len;                 /* bytes hashed so far */
+  unsigned char buf[64];
+};
+
+union digest_ctx {
+  struct MD5Context md5;
+  struct sha_ctx sha;
+};
+
+/* Process [n] 64-byte blocks starting at [p]. */
+typedef void (*sha_blocks_fn)(uint32_t *h, const unsigned char *p, size_t n);
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static inline uint32_t
+load_be32(const unsigned char *p)
+{
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+    | ((uint32_t) p[2] << 8) | p[3];
+}
+
+/* SHA-1, with the message schedule kept in a 16-word circular buffer
+   and the rounds unrolled five at a time so that the variables rotate
+   without moves. */
+
+#define SHA1_F1(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+#define SHA1_F2(b, c, d) ((b) ^ (c) ^ (d))
+#define SHA1_F3(b, c, d) (((b) & (c)) | ((d) & ((b) | (c))))
+
+#define SHA1_LOAD(i) (w[i] = load_be32(p + 4 * (i)))
+#define SHA1_SCHED(i) \
+  (w[(i) & 15] = ROL(w[((i) + 13) & 15] ^ w[((i) + 8) & 15] \
+                     ^ w[((i) + 2) & 15] ^ w[(i) & 15], 1))
+#define SHA1_STEP(a, b, c, d, e, f, k, x) \
+  do { (e) += ROL(a, 5) + f(b, c, d) + (k) + (x); (b) = ROL(b, 30); } while (0)
+#define SHA1_STEP5(f, k, W, i) \
+  do { \
+    SHA1_STEP(a, b, c, d, e, f, k, W(i)); \
+    SHA1_STEP(e, a, b, c, d, f, k, W((i) + 1)); \
+    SHA1_STEP(d, e, a, b, c, f, k, W((i) + 2)); \
+    SHA1_STEP(c, d, e, a, b, f, k, W((i) + 3)); \
+    SHA1_STEP(b, c, d, e, a, f, k, W((i) + 4)); \
+  } while (0)
+
+static void
+sha1_blocks_c(uint32_t *h, const unsigned char *p, size_t n)
+{
+  uint32_t a, b, c, d, e, w[16];
+
+  for (; n > 0; n--, p += 64) {
+    a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+    SHA1_STEP5(SHA1_F1, 0x5a827999, SHA1_LOAD, 0);
+    SHA1_STEP5(SHA1_F1, 0x5a827999, SHA1_LOAD, 5);
+    SHA1_STEP5(SHA1_F1, 0x5a827999, SHA1_LOAD, 10);
+    SHA1_STEP(a, b, c, d, e, SHA1_F1, 0x5a827999, SHA1_LOAD(15));
+    SHA1_STEP(e, a, b, c, d, SHA1_F1, 0x5a827999, SHA1_SCHED(16));
+    SHA1_STEP(d, e, a, b, c, SHA1_F1, 0x5a827999, SHA1_SCHED(17));
+    SHA1_STEP(c, d, e, a, b, SHA1_F1, 0x5a827999, SHA1_SCHED(18));
+    SHA1_STEP(b, c, d, e, a, SHA1_F1, 0x5a827999, SHA1_SCHED(19));
+    SHA1_STEP5(SHA1_F2, 0x6ed9eba1, SHA1_SCHED, 20);
+    SHA1_STEP5(SHA1_F2, 0x6ed9eba1, SHA1_SCHED, 25);
+    SHA1_STEP5(SHA1_F2, 0x6ed9eba1, SHA1_SCHED, 30);
+    SHA1_STEP5(SHA1_F2, 0x6ed9eba1, SHA1_SCHED, 35);
+    SHA1_STEP5(SHA1_F3, 0x8f1bbcdc, SHA1_SCHED, 40);
+    SHA1_STEP5(SHA1_F3, 0x8f1bbcdc, SHA1_SCHED, 45);
+    SHA1_STEP5(SHA1_F3, 0x8f1bbcdc, SHA1_SCHED, 50);
+    SHA1_STEP5(SHA1_F3, 0x8f1bbcdc, SHA1_SCHED, 55);
+    SHA1_STEP5(SHA1_F2, 0xca62c1d6, SHA1_SCHED, 60);
+    SHA1_STEP5(SHA1_F2, 0xca62c1d6, SHA1_SCHED, 65);
+    SHA1_STEP5(SHA1_F2, 0xca62c1d6, SHA1_SCHED, 70);
+    SHA1_STEP5(SHA1_F2, 0xca62c1d6, SHA1_SCHED, 75);
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+  }
+}
+
+/* SHA-256, unrolled eight rounds at a time in the same way. */
+
+static const uint32_t sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_S0(x) (ROR(x, 2) ^ ROR(x, 13) ^ ROR(x, 22))
+#define SHA256_S1(x) (ROR(x, 6) ^ ROR(x, 11) ^ ROR(x, 25))
+#define SHA256_G0(x) (ROR(x, 7) ^ ROR(x, 18) ^ ((x) >> 3))
+#define SHA256_G1(x) (ROR(x, 17) ^ ROR(x, 19) ^ ((x) >> 10))
+#define SHA256_CH(e, f, g) ((g) ^ ((e) & ((f) ^ (g))))
+#define SHA256_MAJ(a, b, c) (((a) & (b)) | ((c) & ((a) | (b))))
+
+#define SHA256_LOAD(i) (w[i] = load_be32(p + 4 * (i)))
+#define SHA256_SCHED(i) \
+  (w[(i) & 15] += SHA256_G1(w[((i) - 2) & 15]) + w[((i) - 7) & 15] \
+                  + SHA256_G0(w[((i) - 15) & 15]))
+#define SHA256_STEP(a, b, c, d, e, f, g, h, i, x) \
+  do { \
+    t = (h) + SHA256_S1(e) + SHA256_CH(e, f, g) + sha256_k[i] + (x); \
+    (d) += t; \
+    (h) = t + SHA256_S0(a) + SHA256_MAJ(a, b, c); \
+  } while (0)
+#define SHA256_STEP8(W, i) \
+  do { \
+    SHA256_STEP(a, b, c, d, e, f, g, h, (i), W(i)); \
+    SHA256_STEP(h, a, b, c, d, e, f, g, (i) + 1, W((i) + 1)); \
+    SHA256_STEP(g, h, a, b, c, d, e, f, (i) + 2, W((i) + 2)); \
+    SHA256_STEP(f, g, h, a, b, c, d, e, (i) + 3, W((i) + 3)); \
+    SHA256_STEP(e, f, g, h, a, b, c, d, (i) + 4, W((i) + 4)); \
+    SHA256_STEP(d, e, f, g, h, a, b, c, (i) + 5, W((i) + 5)); \
+    SHA256_STEP(c, d, e, f, g, h, a, b, (i) + 6, W((i) + 6)); \
+    SHA256_STEP(b, c, d, e, f, g, h, a, (i) + 7, W((i) + 7)); \
+  } while (0)
+
+static void
+sha256_blocks_c(uint32_t *st, const unsigned char *p, size_t n)
+{
+  uint32_t a, b, c, d, e, f, g, h, t, w[16];
+  int i;
+
+  for (; n > 0; n--, p += 64) {
+    a = st[0]; b = st[1]; c = st[2]; d = st[3];
+    e = st[4]; f = st[5]; g = st[6]; h = st[7];
+    SHA256_STEP8(SHA256_LOAD, 0);
+    SHA256_STEP8(SHA256_LOAD, 8);
+    for (i = 16; i < 64; i += 8)
+      SHA256_STEP8(SHA256_SCHED, i);
+    st[0] += a; st[1] += b; st[2] += c; st[3] += d;
+    st[4] += e; st[5] += f; st[6] += g; st[7] += h;
+  }
+}
+
+#ifdef HAVE_SHA_NI
+
+/* The same with the SHA extensions, after the Intel white paper "Intel
+   SHA Extensions" (2013). */
+
+#define SHA_NI __attribute__((target("sha,sse4.1")))
+
+#define SHA1_NI_ROUNDS(k, f) \
+  do { \
+    e = _mm_sha1nexte_epu32(prev, w[k]); \
+    prev = abcd; \
+    abcd = _mm_sha1rnds4_epu32(abcd, e, f); \
+  } while (0)
+
+static SHA_NI void
+sha1_blocks_ni(uint32_t *h, const unsigned char *p, size_t n)
+{
+  const __m128i mask =
+    _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  __m128i abcd, e0, abcd_save, e, prev, w[20];
+  int k;
+
+  abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) h), 0x1b);
+  e0 = _mm_set_epi32(h[4], 0, 0, 0);
+  for (; n > 0; n--, p += 64) {
+    abcd_save = abcd;
+    for (k = 0; k < 4; k++)
+      w[k] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16 * k)),
+                              mask);
+    for (k = 4; k < 20; k++)
+      w[k] = _mm_sha1msg2_epu32(
+               _mm_xor_si128(_mm_sha1msg1_epu32(w[k - 4], w[k - 3]), w[k - 2]),
+               w[k - 1]);
+    e = _mm_add_epi32(e0, w[0]);
+    prev = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e, 0);
+    SHA1_NI_ROUNDS(1, 0); SHA1_NI_ROUNDS(2, 0);
+    SHA1_NI_ROUNDS(3, 0); SHA1_NI_ROUNDS(4, 0);
+    SHA1_NI_ROUNDS(5, 1); SHA1_NI_ROUNDS(6, 1); SHA1_NI_ROUNDS(7, 1);
+    SHA1_NI_ROUNDS(8, 1); SHA1_NI_ROUNDS(9, 1);
+    SHA1_NI_ROUNDS(10, 2); SHA1_NI_ROUNDS(11, 2); SHA1_NI_ROUNDS(12, 2);
+    SHA1_NI_ROUNDS(13, 2); SHA1_NI_ROUNDS(14, 2);
+    SHA1_NI_ROUNDS(15, 3); SHA1_NI_ROUNDS(16, 3); SHA1_NI_ROUNDS(17, 3);
+    SHA1_NI_ROUNDS(18, 3); SHA1_NI_ROUNDS(19, 3);
+    e0 = _mm_sha1nexte_epu32(prev, e0);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+  _mm_storeu_si128((__m128i *) h, _mm_shuffle_epi32(abcd, 0x1b));
+  h[4] = _mm_extract_epi32(e0, 3);
+}
+
+static SHA_NI void
+sha256_blocks_ni(uint32_t *st, const unsigned char *p, size_t n)
+{
+  const __m128i mask =
+    _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  __m128i state0, state1, save0, save1, tmp, msg, w[16];
+  int k;
+
+  tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &st[0]), 0xb1);
+  state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &st[4]), 0x1b);
+  state0 = _mm_alignr_epi8(tmp, state1, 8);         /* ABEF */
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0);      /* CDGH */
+  for (; n > 0; n--, p += 64) {
+    save0 = state0;
+    save1 = state1;
+    for (k = 0; k < 16; k++) {
+      if (k < 4)
+        w[k] = _mm_shuffle_epi8(
+                 _mm_loadu_si128((const __m128i *) (p + 16 * k)), mask);
+      else
+        w[k] = _mm_sha256msg2_epu32(
+                 _mm_add_epi32(_mm_sha256msg1_epu32(w[k - 4], w[k - 3]),
+                               _mm_alignr_epi8(w[k - 1], w[k - 2], 4)),
+                 w[k - 1]);
+      msg = _mm_add_epi32(w[k],
+                          _mm_loadu_si128((const __m128i *) &sha256_k[4 * k]));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+      state0 = _mm_sha256rnds2_epu32(state0, state1,
+                                     _mm_shuffle_epi32(msg, 0x0e));
+    }
+    state0 = _mm_add_epi32(state0, save0);
+    state1 = _mm_add_epi32(state1, save1);
+  }
+  tmp = _mm_shuffle_epi32(state0, 0x1b);            /* FEBA */
+  state1 = _mm_shuffle_epi32(state1, 0xb1);         /* DCHG */
+  _mm_storeu_si128((__m128i *) &st[0], _mm_blend_epi16(tmp, state1, 0xf0));
+  _mm_storeu_si128((__m128i *) &st[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+static int
+cpu_has_sha_ni(void)
+{
+  uint32_t a, b, c, d;
+
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(0), "c"(0));
+  if (a < 7) return 0;
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(1), "c"(0));
+  if (!(c & (1 << 9)) || !(c & (1 << 19))) return 0;  /* SSSE3, SSE4.1 */
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(7), "c"(0));
+  return (b >> 29) & 1;                               /* SHA */
+}
+
+#endif /* HAVE_SHA_NI */
+
+static sha_blocks_fn sha1_blocks = NULL, sha256_blocks = NULL;
+
+static void
+select_sha_blocks(void)
+{
+  sha1_blocks = sha1_blocks_c;
+  sha256_blocks = sha256_blocks_c;
+#ifdef HAVE_SHA_NI
+  if (cpu_has_sha_ni()) {
+    sha1_blocks = sha1_blocks_ni;
+    sha256_blocks = sha256_blocks_ni;
+  }
+#endif
+}
+
+static void
+sha_update(struct sha_ctx *ctx, sha_blocks_fn blocks,
+           const unsigned char *p, size_t len)
+{
+  size_t used = ctx->len & 63, n;
+
+  ctx->len += len;
+  if (used > 0) {
+    n = 64 - used < len ? 64 - used : len;
+    memcpy(ctx->buf + used, p, n);
+    p += n;
+    len -= n;
+    if (used + n < 64) return;
+    blocks(ctx->h, ctx->buf, 1);
+  }
+  if (len >= 64) {
+    blocks(ctx->h, p, len / 64);
+    p += len & ~(size_t) 63;
+    len &= 63;
+  }
+  memcpy(ctx->buf, p, len);
+}
+
+static void
+sha_final(struct sha_ctx *ctx, sha_blocks_fn blocks,
+          unsigned char *out, int nwords)
+{
+  uint64_t bits = ctx->len * 8;
+  size_t used = ctx->len & 63;
+  int i;
+
+  ctx->buf[used++] = 0x80;
+  if (used > 56) {
+    memset(ctx->buf + used, 0, 64 - used);
+    blocks(ctx->h, ctx->buf, 1);
+    used = 0;
+  }
+  memset(ctx->buf + used, 0, 56 - used);
+  for (i = 0; i < 8; i++) ctx->buf[56 + i] = bits >> (56 - 8 * i);
+  blocks(ctx->h, ctx->buf, 1);
+  for (i = 0; i < nwords; i++) {
+    out[4 * i] = ctx->h[i] >> 24;
+    out[4 * i + 1] = ctx->h[i] >> 16;
+    out[4 * i + 2] = ctx->h[i] >> 8;
+    out[4 * i + 3] = ctx->h[i];
+  }
+}
+
+static const uint32_t sha1_init[5] = {
+  0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+static const uint32_t sha256_init[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static void
+digest_init(int kind, union digest_ctx *ctx)
+{
+  if (sha1_blocks == NULL) select_sha_blocks();
+  switch (kind) {
+  case DIGEST_MD5:
+    caml_MD5Init(&ctx->md5);
+    break;
+  case DIGEST_SHA1:
+    memcpy(ctx->sha.h, sha1_init, sizeof(sha1_init));
+    ctx->sha.len = 0;
+    break;
+  default:
+    memcpy(ctx->sha.h, sha256_init, sizeof(sha256_init));
+    ctx->sha.len = 0;
+    break;
+  }
+}
+
+static void
+digest_update(int kind, union digest_ctx *ctx, unsigned char *p, size_t len)
+{
+  switch (kind) {
+  case DIGEST_MD5:
+    caml_MD5Update(&ctx->md5, p, len);
+    break;
+  case DIGEST_SHA1:
+    sha_update(&ctx->sha, sha1_blocks, p, len);
+    break;
+  default:
+    sha_update(&ctx->sha, sha256_blocks, p, len);
+    break;
+  }
+}
+
+static value
+digest_final(int kind, union digest_ctx *ctx)
+{
+  unsigned char out[32];
+  value res;
+
+  switch (kind) {
+  case DIGEST_MD5:
+    caml_MD5Final(out, &ctx->md5);
+    break;
+  case DIGEST_SHA1:
+    sha_final(&ctx->sha, sha1_blocks, out, 5);
+    break;
+  default:
+    sha_final(&ctx->sha, sha256_blocks, out, 8);
+    break;
+  }
+  res = caml_alloc_string(digest_size[kind]);
+  memcpy(String_val(res), out, digest_size[kind]);
+  return res;
+}
+
+/* Cstructs are records whose first three fields are a bigarray, an
+   offset and a length; the offsets and lengths are trusted. */
+#define Cstruct_data(c) \
+  ((unsigned char *) Caml_ba_data_val(Field(c, 0)) + Long_val(Field(c, 1)))
+#define Cstruct_len(c) Long_val(Field(c, 2))
+
+CAMLprim value
+caml_digest_cstruct(value v_kind, value v_c)
+{
+  union digest_ctx ctx;
+
+  digest_init(Int_val(v_kind), &ctx);
+  digest_update(Int_val(v_kind), &ctx, Cstruct_data(v_c), Cstruct_len(v_c));
+  return digest_final(Int_val(v_kind), &ctx);
+}
+
+CAMLprim value
+caml_digest_cstructs(value v_kind, value v_cs)
+{
+  union digest_ctx ctx;
+
+  digest_init(Int_val(v_kind), &ctx);
+  for (; v_cs != Val_emptylist; v_cs = Field(v_cs, 1))
+    digest_update(Int_val(v_kind), &ctx,
+                  Cstruct_data(Field(v_cs, 0)), Cstruct_len(Field(v_cs, 0)));
+  return digest_final(Int_val(v_kind), &ctx);
+}
+
+/* Digest of each cstruct of an array, in one call. */
+CAMLprim value
+caml_digest_batch(value v_kind, value v_cs)
+{
+  CAMLparam1(v_cs);
+  CAMLlocal2(v_res, v_d);
+  union digest_ctx ctx;
+  mlsize_t i, n = Wosize_val(v_cs);
+
+  if (n == 0) CAMLreturn(Atom(0));
+  v_res = caml_alloc(n, 0);
+  for (i = 0; i < n; i++) {
+    digest_init(Int_val(v_kind), &ctx);
+    digest_update(Int_val(v_kind), &ctx,
+                  Cstruct_data(Field(v_cs, i)), Cstruct_len(Field(v_cs, i)));
+    v_d = digest_final(Int_val(v_kind), &ctx);
+    Store_field(v_res, i, v_d);
+  }
+  CAMLreturn(v_res);
+}
@@ -0,0 +1,131 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(* The stock runtime has no ephemerons: the key is held in a weak
+   array and the data strongly, until the key is found dead. *)
+
+type ('k, 'd) t = {
+  key: 'k Weak.t;
+  mutable has_key: bool;
+  mutable data: 'd option;
+}
+
+let create () = { key = Weak.create 1; has_key = false; data = None }
+
+let check_key e =
+  if e.has_key && not (Weak.check e.key 0) then begin
+    e.has_key <- false;
+    e.data <- None
+  end;
+  e.has_key
+
+let get_key e = if check_key e then Weak.get e.key 0 else None
+
+let set_key e k = Weak.set e.key 0 (Some k); e.has_key <- true
+let unset_key e = Weak.set e.key 0 None; e.has_key <- false
+
+let get_data e = ignore (check_key e); e.data
+let set_data e d = e.data <- Some d
+let unset_data e = e.data <- None
+
+type ('k, 'd) ephemeron = ('k, 'd) t
+
+module Make (H : Hashtbl.HashedType) = struct
+  type key = H.t
+
+  type 'a t = {
+    mutable buckets: (key, 'a) ephemeron list array;
+    mutable size: int; (* ephemerons in [buckets], dead or alive *)
+  }
+
+  let create n =
+    let n = if n < 16 then 16 else n in
+    { buckets = Array.make n []; size = 0 }
+
+  let clear tbl =
+    Array.fill tbl.buckets 0 (Array.length tbl.buckets) [];
+    tbl.size <- 0
+
+  let index tbl k = (H.hash k land max_int) mod Array.length tbl.buckets
+
+  let is_live e = check_key e
+
+  let clean tbl =
+    let size = ref 0 in
+    Array.iteri (fun i b ->
+      let b = List.filter is_live b in
+      size := !size + List.length b;
+      tbl.buckets.(i) <- b
+    ) tbl.buckets;
+    tbl.size <- !size
+
+  let resize tbl =
+    let old = tbl.buckets in
+    tbl.buckets <- Array.make (2 * Array.length old) [];
+    tbl.size <- 0;
+    Array.iter (List.iter (fun e ->
+      match get_key e with
+      | None -> ()
+      | Some k ->
+        let i = index tbl k in
+        tbl.buckets.(i) <- e :: tbl.buckets.(i);
+        tbl.size <- tbl.size + 1
+    )) old
+
+  let rec find_eph k = function
+    | [] -> None
+    | e :: rest ->
+      match get_key e with
+      | Some k' when H.equal k k' -> Some e
+      | _ -> find_eph k rest
+
+  let replace tbl k d =
+    let i = index tbl k in
+    match find_eph k tbl.buckets.(i) with
+    | Some e -> set_data e d
+    | None ->
+      let e = create () in
+      set_key e k;
+      set_data e d;
+      tbl.buckets.(i) <- e :: List.filter is_live tbl.buckets.(i);
+      tbl.size <- tbl.size + 1;
+      if tbl.size > 2 * Array.length tbl.buckets then begin
+        clean tbl;
+        if tbl.size > Array.length tbl.buckets then resize tbl
+      end
+
+  let find tbl k =
+    match find_eph k tbl.buckets.(index tbl k) with
+    | None -> raise Not_found
+    | Some e ->
+      match get_data e with
+      | None -> raise Not_found
+      | Some d -> d
+
+  let mem tbl k =
+    try ignore (find tbl k); true with Not_found -> false
+
+  let remove tbl k =
+    let i = index tbl k in
+    match find_eph k tbl.buckets.(i) with
+    | None -> ()
+    | Some e ->
+      tbl.buckets.(i) <- List.filter (fun e' -> e' != e) tbl.buckets.(i);
+      tbl.size <- tbl.size - 1
+
+  let length tbl =
+    Array.fold_left (fun n b ->
+      List.fold_left (fun n e -> if is_live e then n + 1 else n) n b
+    ) 0 tbl.buckets
+end
@@ -0,0 +1,92 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Ephemerons: weak keys with data.
+
+    An ephemeron holds a key and a piece of data.  The key is weak:
+    the ephemeron does not keep it alive.  The data is kept alive only
+    as long as both the ephemeron and its key are, so the data may
+    point back to its key without leaking it, which a weak key paired
+    with a strong datum cannot do.  When the GC finds the key dead,
+    the key and the data are removed together.
+
+    On Unix the standard runtime has no ephemerons: the key is held
+    weakly and the data strongly, so a datum that points to its key
+    keeps both alive. *)
+
+type ('k, 'd) t
+(** An ephemeron with keys of type ['k] and data of type ['d]. *)
+
+val create : unit -> ('k, 'd) t
+(** [create ()] is a new ephemeron, with neither key nor data. *)
+
+val get_key : ('k, 'd) t -> 'k option
+(** [get_key e] is [Some k] if [e] holds the key [k], [None] if it has
+    no key or if the key was removed by the GC. *)
+
+val set_key : ('k, 'd) t -> 'k -> unit
+(** [set_key e k] sets the key of [e] to [k]. *)
+
+val unset_key : ('k, 'd) t -> unit
+(** [unset_key e] removes the key of [e].  An ephemeron without a key
+    keeps its data alive. *)
+
+val check_key : ('k, 'd) t -> bool
+(** [check_key e] is [true] if [e] holds a key.  Unlike {!get_key}, it
+    does not keep the key alive. *)
+
+val get_data : ('k, 'd) t -> 'd option
+(** [get_data e] is [Some d] if [e] holds the data [d]. *)
+
+val set_data : ('k, 'd) t -> 'd -> unit
+(** [set_data e d] sets the data of [e] to [d]. *)
+
+val unset_data : ('k, 'd) t -> unit
+(** [unset_data e] removes the data of [e]. *)
+
+(** Hash tables whose bindings disappear when their key is no longer
+    used elsewhere.  A binding keeps neither its key nor its data
+    alive. *)
+module Make (H : Hashtbl.HashedType) : sig
+  type key = H.t
+  type 'a t
+
+  val create : int -> 'a t
+  (** [create n] is an empty table with about [n] buckets. *)
+
+  val clear : 'a t -> unit
+  (** [clear tbl] removes every binding of [tbl]. *)
+
+  val replace : 'a t -> key -> 'a -> unit
+  (** [replace tbl k d] binds [k] to [d], replacing the previous
+      binding of [k] if there is one. *)
+
+  val find : 'a t -> key -> 'a
+  (** [find tbl k] is the data bound to [k].
+      @raise Not_found if [k] is not bound. *)
+
+  val mem : 'a t -> key -> bool
+  (** [mem tbl k] is [true] if [k] is bound in [tbl]. *)
+
+  val remove : 'a t -> key -> unit
+  (** [remove tbl k] removes the binding of [k], if any. *)
+
+  val length : 'a t -> int
+  (** [length tbl] is the number of live bindings in [tbl].  It takes
+      time proportional to the size of the table. *)
+
+  val clean : 'a t -> unit
+  (** [clean tbl] removes the bindings whose key has died.  This is
+      also done when the table grows. *)
+end
@@ -0,0 +1,48 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** The ring of recently raised exceptions.
+
+    The runtime keeps the name and the raise point of each of the last
+    32 exceptions raised, and prints them when the program dies of an
+    uncaught exception.  Unlike [Printexc.record_backtrace] it is on by
+    default.  Recording a [raise] costs a call into the runtime and
+    two stores, about 5ns on x86_64.
+
+    In native code, [raise] only calls into the runtime in code
+    compiled with [-g]: without [-g], the ring only sees the exceptions
+    raised by runtime primitives (such as [Invalid_argument] from a
+    bound check).  Raise points are located in the source only for
+    code compiled with [-g].
+
+    The ring is part of the Xen runtime.  Under Unix nothing is
+    recorded and [recent] is always empty. *)
+
+val set_active : bool -> unit
+(** Start or stop recording exceptions in the ring. *)
+
+val active : unit -> bool
+(** Whether exceptions are recorded in the ring. *)
+
+val count : unit -> int
+(** Number of exceptions recorded since startup. *)
+
+val recent : unit -> (string * Printexc.raw_backtrace) list
+(** The exceptions in the ring, most recent first, as pairs of the name
+    of the exception and its raise point, as a backtrace of at most one
+    frame.  The names of exceptions that are not defined statically
+    (e.g. unmarshalled ones) are ["_"]. *)
+
+val print : out_channel -> unit
+(** Print the exceptions in the ring, most recent first. *)
@@ -0,0 +1,81 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+type vector = (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t
+
+module type S = sig
+  type t
+  val sum : t -> float
+  val dot : t -> t -> float
+  val axpy : float -> t -> t -> unit
+  val scale : float -> t -> unit
+  val min : t -> float
+  val max : t -> float
+end
+
+module Array = struct
+  type t = float array
+
+  external sum : t -> float = "caml_float_vec_sum"
+  external dot_ : t -> t -> float = "caml_float_vec_dot"
+  external axpy_ : float -> t -> t -> unit = "caml_float_vec_axpy" "noalloc"
+  external scale : float -> t -> unit = "caml_float_vec_scale" "noalloc"
+  external min_ : t -> float = "caml_float_vec_min"
+  external max_ : t -> float = "caml_float_vec_max"
+
+  let dot x y =
+    if Array.length x <> Array.length y then invalid_arg "Float_kernels.dot";
+    dot_ x y
+
+  let axpy a x y =
+    if Array.length x <> Array.length y then invalid_arg "Float_kernels.axpy";
+    axpy_ a x y
+
+  let min x =
+    if Array.length x = 0 then invalid_arg "Float_kernels.min";
+    min_ x
+
+  let max x =
+    if Array.length x = 0 then invalid_arg "Float_kernels.max";
+    max_ x
+end
+
+module Vector = struct
+  type t = vector
+
+  external sum : t -> float = "caml_float_vec_sum"
+  external dot_ : t -> t -> float = "caml_float_vec_dot"
+  external axpy_ : float -> t -> t -> unit = "caml_float_vec_axpy" "noalloc"
+  external scale : float -> t -> unit = "caml_float_vec_scale" "noalloc"
+  external min_ : t -> float = "caml_float_vec_min"
+  external max_ : t -> float = "caml_float_vec_max"
+
+  let dim = Bigarray.Array1.dim
+
+  let dot x y =
+    if dim x <> dim y then invalid_arg "Float_kernels.dot";
+    dot_ x y
+
+  let axpy a x y =
+    if dim x <> dim y then invalid_arg "Float_kernels.axpy";
+    axpy_ a x y
+
+  let min x =
+    if dim x = 0 then invalid_arg "Float_kernels.min";
+    min_ x
+
+  let max x =
+    if dim x = 0 then invalid_arg "Float_kernels.max";
+    max_ x
+end
@@ -0,0 +1,62 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Numeric kernels over float vectors.
+
+    Reductions and in-place updates over unboxed [float array]s and
+    one-dimensional float64 bigarrays, run by the runtime with SIMD
+    instructions where the CPU has them instead of bounds-checked
+    OCaml loops.
+
+    [sum] and [dot] add in several partial sums, so the result may
+    differ in the last bits from a left-to-right fold.  [min] and [max]
+    return [nan] if any element is [nan], and treat [-0.] as smaller
+    than [0.]: [min [|0.; -0.|]] is [-0.] and [max [|-0.; 0.|]] is
+    [0.].  The SIMD and portable kernels return the same results for
+    [min], [max], [axpy] and [scale]. *)
+
+type vector = (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t
+
+module type S = sig
+  type t
+
+  val sum : t -> float
+  (** [sum x] is the sum of the elements of [x]. *)
+
+  val dot : t -> t -> float
+  (** [dot x y] is the dot product of [x] and [y].
+      @raise Invalid_argument if their lengths differ. *)
+
+  val axpy : float -> t -> t -> unit
+  (** [axpy a x y] sets [y.(i)] to [a *. x.(i) +. y.(i)] for every [i].
+      [x] and [y] must be the same vector or not overlap.
+      @raise Invalid_argument if their lengths differ. *)
+
+  val scale : float -> t -> unit
+  (** [scale a x] multiplies every element of [x] by [a]. *)
+
+  val min : t -> float
+  (** [min x] is the smallest element of [x].
+      @raise Invalid_argument if [x] is empty. *)
+
+  val max : t -> float
+  (** [max x] is the largest element of [x].
+      @raise Invalid_argument if [x] is empty. *)
+end
+
+module Array : S with type t = float array
+(** Kernels over unboxed float arrays. *)
+
+module Vector : S with type t = vector
+(** Kernels over float64 bigarrays. *)
@@ -0,0 +1,40 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+external hash_string : int -> string -> int -> int -> int64
+  = "caml_hash64_string"
+external hash_bigarray : int -> Cstruct.buffer -> int -> int -> int64
+  = "caml_hash64_bigarray"
+external hash_string_int : int -> string -> int -> int -> int
+  = "caml_hash64_string_int" "noalloc"
+external hash_bigarray_int : int -> Cstruct.buffer -> int -> int -> int
+  = "caml_hash64_bigarray_int" "noalloc"
+
+let check s off len =
+  let len = match len with None -> String.length s - off | Some l -> l in
+  if off < 0 || len < 0 || off > String.length s - len
+  then invalid_arg "Hash64.string";
+  len
+
+let string ?(seed=0) ?(off=0) ?len s =
+  hash_string seed s off (check s off len)
+
+let string_int ?(seed=0) ?(off=0) ?len s =
+  hash_string_int seed s off (check s off len)
+
+let cstruct ?(seed=0) c =
+  hash_bigarray seed c.Cstruct.buffer c.Cstruct.off c.Cstruct.len
+
+let cstruct_int ?(seed=0) c =
+  hash_bigarray_int seed c.Cstruct.buffer c.Cstruct.off c.Cstruct.len
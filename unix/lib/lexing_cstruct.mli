@@ -0,0 +1,108 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Lexing in place from I/O buffers.
+
+    A replacement for [Lexing] whose lexer buffers read their input
+    straight from cstructs (such as received [Io_page]s) instead of
+    copying it into a string first.  A lexer generated by ocamllex uses
+    it, with unchanged tables, when its header contains
+{[
+module Lexing = OS.Lexing_cstruct
+]}
+
+    A token is lexed in place as long as it lies within one cstruct.
+    When a token straddles the end of a cstruct, its beginning is
+    copied into a scratch buffer owned by the lexer buffer, followed by
+    the next cstruct a few bytes at a time until the token ends; the
+    lexer then goes back to reading that cstruct in place.  Only the
+    bytes around the boundary are copied. *)
+
+type position = Lexing.position = {
+  pos_fname : string;
+  pos_lnum : int;
+  pos_bol : int;
+  pos_cnum : int;
+}
+
+val dummy_pos : position
+
+type lexbuf = {
+  refill_buff : lexbuf -> unit;
+  mutable lex_buffer : Cstruct.buffer;
+  mutable lex_buffer_len : int;
+  mutable lex_abs_pos : int;
+  mutable lex_start_pos : int;
+  mutable lex_curr_pos : int;
+  mutable lex_last_pos : int;
+  mutable lex_last_action : int;
+  mutable lex_eof_reached : bool;
+  mutable lex_mem : int array;
+  mutable lex_start_p : position;
+  mutable lex_curr_p : position;
+}
+(** As [Lexing.lexbuf], but [lex_buffer] is a bigarray and the
+    positions are offsets in it. *)
+
+val from_cstruct : Cstruct.t -> lexbuf
+(** [from_cstruct c] reads the contents of [c], then reaches the end of
+    input. *)
+
+val from_cstructs : Cstruct.t list -> lexbuf
+(** [from_cstructs cs] reads the contents of [cs] in turn, as one
+    stream. *)
+
+val from_function : (unit -> Cstruct.t option) -> lexbuf
+(** [from_function f] calls [f] whenever it needs more input; [f]
+    returns [None] at the end of input.  Once returned, a cstruct must
+    not be modified until the lexer has moved past it. *)
+
+val lexeme : lexbuf -> string
+val lexeme_char : lexbuf -> int -> char
+val lexeme_start : lexbuf -> int
+val lexeme_end : lexbuf -> int
+val lexeme_start_p : lexbuf -> position
+val lexeme_end_p : lexbuf -> position
+val new_line : lexbuf -> unit
+val flush_input : lexbuf -> unit
+(** As in [Lexing]. *)
+
+val lexeme_cstruct : lexbuf -> Cstruct.t
+(** [lexeme_cstruct lb] is a view of the last matched string, without a
+    copy.  It is valid until the lexer is applied to [lb] again. *)
+
+(**/**)
+
+(* The following definitions are used by the generated scanners only. *)
+
+type lex_tables = Lexing.lex_tables = {
+  lex_base : string;
+  lex_backtrk : string;
+  lex_default : string;
+  lex_trans : string;
+  lex_check : string;
+  lex_base_code : string;
+  lex_backtrk_code : string;
+  lex_default_code : string;
+  lex_trans_code : string;
+  lex_check_code : string;
+  lex_code : string;
+}
+
+val engine : lex_tables -> int -> lexbuf -> int
+val new_engine : lex_tables -> int -> lexbuf -> int
+val sub_lexeme : lexbuf -> int -> int -> string
+val sub_lexeme_opt : lexbuf -> int -> int -> string option
+val sub_lexeme_char : lexbuf -> int -> char
+val sub_lexeme_char_opt : lexbuf -> int -> char option
@@ -0,0 +1,52 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(* The stock runtime cannot marshal to bigarrays: go through a string. *)
+
+let to_cstruct ?(flags=[]) v c =
+  let s = Marshal.to_string v flags in
+  let n = String.length s in
+  if n > Cstruct.len c then failwith "Marshal.to_buffer: buffer overflow";
+  Cstruct.blit_from_string s 0 c 0 n;
+  n
+
+let to_cstructs ?(flags=[]) v cs =
+  (match cs with
+   | c :: _ when Cstruct.len c >= Marshal.header_size -> ()
+   | _ -> invalid_arg "Marshal.to_cstructs: first buffer too short");
+  let s = Marshal.to_string v flags in
+  let n = String.length s in
+  let rec scatter ofs = function
+    | _ when ofs = n -> ()
+    | [] -> failwith "Marshal.to_cstructs: buffer overflow"
+    | c :: cs ->
+      let k = min (Cstruct.len c) (n - ofs) in
+      Cstruct.blit_from_string s ofs c 0 k;
+      scatter (ofs + k) cs in
+  scatter 0 cs;
+  n
+
+let total_size c =
+  if Cstruct.len c < Marshal.header_size
+  then invalid_arg "Marshal_cstruct.total_size";
+  Marshal.header_size
+  + (Int32.to_int (Cstruct.BE.get_uint32 c 4) land 0xffffffff)
+
+let of_cstruct c =
+  if Cstruct.len c < Marshal.header_size
+  then invalid_arg "Marshal_cstruct.of_cstruct";
+  Marshal.from_string (Cstruct.to_string c) 0
+
+let of_cstructs cs =
+  Marshal.from_string (String.concat "" (List.map Cstruct.to_string cs)) 0
@@ -0,0 +1,50 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Marshalling straight to and from I/O buffers.
+
+    These functions use the format of the [Marshal] module, but write
+    the marshalled data into a cstruct (such as an [Io_page] for a
+    shared ring or a block device) and read it back from one.
+    Output can also be scattered over a list of cstructs, and input
+    gathered from one.  On Unix the data goes through a string.
+
+    Only the first [total_size] bytes of the input are read; the
+    cstructs may be longer. *)
+
+val to_cstruct : ?flags:Marshal.extern_flags list -> 'a -> Cstruct.t -> int
+(** [to_cstruct ?flags v c] marshals [v] into [c] and returns the number
+    of bytes written.
+    @raise Failure if [c] is too short. *)
+
+val to_cstructs :
+  ?flags:Marshal.extern_flags list -> 'a -> Cstruct.t list -> int
+(** [to_cstructs ?flags v cs] marshals [v] across the cstructs [cs],
+    filling each one before moving on to the next, and returns the
+    total number of bytes written.
+    @raise Invalid_argument if the first cstruct is shorter than
+    [Marshal.header_size].
+    @raise Failure if the cstructs are too short altogether. *)
+
+val total_size : Cstruct.t -> int
+(** [total_size c] is the size in bytes of the marshalled value that
+    starts at the beginning of [c], header included.  [c] must hold at
+    least [Marshal.header_size] bytes. *)
+
+val of_cstruct : Cstruct.t -> 'a
+(** [of_cstruct c] unmarshals the value at the beginning of [c].  As
+    with [Marshal.from_string], the type is not checked. *)
+
+val of_cstructs : Cstruct.t list -> 'a
+(** [of_cstructs cs] unmarshals a value marshalled across [cs]. *)
@@ -0,0 +1,127 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(* The stock runtime has no sampling hook.  Instead, a CPU timer ticks
+   every millisecond, and its signal is handled at the next allocation
+   point (in native code).  The words allocated since the previous tick
+   are sampled as in the Xen runtime, and the samples are given to the
+   call stack of that allocation.  Sampled blocks are not followed. *)
+
+external frames : Printexc.raw_backtrace -> int -> string
+  = "caml_callstack_frames"
+
+type site = {
+  mutable samples : int;
+  mutable minor : int;
+}
+
+let period = 0.001
+let max_frames = 32
+
+let sites : (string, site) Hashtbl.t = Hashtbl.create 256
+let rate = ref 0.
+let rng = Random.State.make [| 0x4D505246 |]
+let countdown = ref 0.
+let last_minor = ref 0.
+let last_direct = ref 0.
+let busy = ref false
+let saved = ref None
+
+(* Distance to the next sample, in words. *)
+let draw_gap () =
+  -. log (1. -. Random.State.float rng 1.) /. !rate
+
+(* Number of samples in [words] allocated words. *)
+let take words =
+  countdown := !countdown -. words;
+  let n = ref 0 in
+  while !countdown <= 0. do
+    countdown := !countdown +. draw_gap ();
+    incr n
+  done;
+  !n
+
+let counters () =
+  let minor, promoted, major = Gc.counters () in
+  minor, major -. promoted
+
+(* The innermost frame of the call stack is this handler. *)
+let tick _ =
+  if not !busy then begin
+    busy := true;
+    let bt = Printexc.get_callstack (max_frames + 1) in
+    let minor, direct = counters () in
+    let n_minor = take (minor -. !last_minor) in
+    let n_major = take (direct -. !last_direct) in
+    last_minor := minor;
+    last_direct := direct;
+    if n_minor + n_major > 0 then begin
+      let key = frames bt 1 in
+      let s =
+        try Hashtbl.find sites key
+        with Not_found ->
+          let s = { samples = 0; minor = 0 } in
+          Hashtbl.add sites key s;
+          s in
+      s.samples <- s.samples + n_minor + n_major;
+      s.minor <- s.minor + n_minor
+    end;
+    busy := false
+  end
+
+let start ~sampling_rate =
+  if not (sampling_rate > 0. && sampling_rate <= 1.) then
+    invalid_arg "Memprof.start";
+  rate := sampling_rate;
+  countdown := draw_gap ();
+  if !saved = None then begin
+    let minor, direct = counters () in
+    last_minor := minor;
+    last_direct := direct;
+    let handler = Sys.signal Sys.sigvtalrm (Sys.Signal_handle tick) in
+    let timer = Unix.setitimer Unix.ITIMER_VIRTUAL
+        { Unix.it_interval = period; it_value = period } in
+    saved := Some (handler, timer)
+  end
+
+let stop () =
+  match !saved with
+  | None -> ()
+  | Some (handler, timer) ->
+    ignore (Unix.setitimer Unix.ITIMER_VIRTUAL timer);
+    Sys.set_signal Sys.sigvtalrm handler;
+    saved := None
+
+let reset () = Hashtbl.reset sites
+
+let dump () =
+  let b = Buffer.create 4096 in
+  let add_le n x =
+    for i = 0 to n - 1 do
+      Buffer.add_char b
+        (Char.chr (Int64.to_int
+                     (Int64.logand (Int64.shift_right_logical x (8 * i)) 0xFFL)))
+    done in
+  Buffer.add_string b "MPRF";
+  add_le 4 1L;
+  add_le 8 (Int64.bits_of_float !rate);
+  add_le 4 (Int64.of_int (Sys.word_size / 8));
+  add_le 8 (Int64.of_int (Hashtbl.length sites));
+  Hashtbl.iter (fun key s ->
+      add_le 4 (Int64.of_int (String.length key / 8));
+      Buffer.add_string b key;
+      List.iter (fun n -> add_le 8 (Int64.of_int n))
+        [s.samples; s.minor; 0; 0; 0; 0])
+    sites;
+  Buffer.contents b
@@ -0,0 +1,69 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Sampling allocation profiler.
+
+    While the profiler runs, allocated words are sampled at random
+    with probability [sampling_rate], in the minor and the major heap,
+    and the call stack of each sampled allocation is recorded.  Samples
+    are aggregated by call stack.  Sampled blocks are followed until
+    they are collected, which tells how many of them survive the minor
+    heap and how long they live in the major heap.
+
+    The overhead is proportional to the number of samples, plus a test
+    per block promoted or swept while sampled blocks are alive, so it
+    is controlled by the rate.  A sample costs about 100ns with a call
+    stack of 16 frames (x86_64, 3GHz), so at [1e-4] (one sample every
+    80 KiB on 64-bit) it stays around 1% of the time spent allocating.
+
+    On Unix the stock OCaml runtime has no sampling hook.  A CPU timer
+    ticks every millisecond instead, and the words allocated since the
+    previous tick are sampled at the rate and given to the call stack
+    of the allocation where the tick is handled.  This is a coarser
+    estimate, and sampled blocks are not followed: only the first two
+    counters of {!dump} are filled.  The profiler takes [SIGVTALRM]
+    and [ITIMER_VIRTUAL] while it runs, and gives them back on {!stop}. *)
+
+val start : sampling_rate:float -> unit
+(** [start ~sampling_rate] starts sampling, or changes the rate.
+    Samples taken before are kept.
+    @raise Invalid_argument unless [0 < sampling_rate <= 1]. *)
+
+val stop : unit -> unit
+(** [stop ()] stops sampling.  Blocks already sampled are still
+    followed. *)
+
+val dump : unit -> string
+(** [dump ()] is the profile in a compact binary format, with all
+    integers little-endian:
+    - the magic ["MPRF"], a 32-bit version ([1]), the sampling rate as
+      a 64-bit IEEE float, the word size in bytes (32-bit) and the
+      number of call sites (64-bit);
+    - for each call site, the number of frames (32-bit) and the return
+      address of each frame (64-bit), innermost first, followed by six
+      64-bit counters: samples, samples taken in the minor heap,
+      sampled blocks promoted to the major heap, sampled blocks
+      collected, total number of major cycles survived by the collected
+      blocks, and sampled blocks still alive.
+
+    Samples are in words: a block of [n] words allocated at rate [r]
+    is sampled [n * r] times on average.  Blocks that are not followed
+    to their death (the heap was compacted, or too many were alive)
+    are neither collected nor alive.  Return addresses can be
+    symbolised against the unikernel image with [addr2line].  On Unix
+    they are addresses in the native executable, or in the bytecode
+    of a bytecode program. *)
+
+val reset : unit -> unit
+(** [reset ()] discards all the samples. *)
@@ -0,0 +1,82 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+let version = 1
+
+let fields = [|
+  "updated"; "minor_words"; "promoted_words"; "major_words";
+  "minor_collections"; "major_collections"; "compactions";
+  "heap_bytes"; "top_heap_bytes"; "heap_chunks";
+  "external_bytes"; "external_peak"; "region_pages"; "region_mapped";
+  "events"; "blocks"; "run_ns"; "sweep_ns"; "blocked_ns"; "timers";
+|]
+
+let magic = 0x54454D4Dl
+let header = 16
+
+let decode c =
+  let seq () = Cstruct.LE.get_uint32 c 8 in
+  let name i =
+    if i < Array.length fields then fields.(i) else Printf.sprintf "field%d" i in
+  let rec attempt n =
+    let s = seq () in
+    if Int32.logand s 1l <> 0l then
+      if n = 0 then None else attempt (n - 1)
+    else begin
+      let count = Int32.to_int (Cstruct.LE.get_uint32 c 12) in
+      let count = max 0 (min count ((Cstruct.len c - header) / 8)) in
+      let values =
+        Array.init count (fun i -> Cstruct.LE.get_uint64 c (header + 8 * i)) in
+      if seq () <> s then
+        if n = 0 then None else attempt (n - 1)
+      else
+        Some (Array.to_list (Array.mapi (fun i v -> name i, v) values))
+    end in
+  if Cstruct.len c < header
+  || Cstruct.LE.get_uint32 c 0 <> magic
+  || Int32.to_int (Cstruct.LE.get_uint32 c 4) <> version then None
+  else attempt 1000
+
+(* There is no runtime page on Unix: fill one from the GC statistics. *)
+
+let buf = Cstruct.create 4096
+
+let page () = buf
+
+let update () =
+  let s = Gc.quick_stat () in
+  let set i v = Cstruct.LE.set_uint64 buf (header + 8 * i) v in
+  let seq = Cstruct.LE.get_uint32 buf 8 in
+  Cstruct.LE.set_uint32 buf 0 magic;
+  Cstruct.LE.set_uint32 buf 4 (Int32.of_int version);
+  Cstruct.LE.set_uint32 buf 8 (Int32.add seq 1l);
+  Cstruct.LE.set_uint32 buf 12 (Int32.of_int (Array.length fields));
+  set 1 (Int64.of_float s.Gc.minor_words);
+  set 2 (Int64.of_float s.Gc.promoted_words);
+  set 3 (Int64.of_float s.Gc.major_words);
+  set 4 (Int64.of_int s.Gc.minor_collections);
+  set 5 (Int64.of_int s.Gc.major_collections);
+  set 6 (Int64.of_int s.Gc.compactions);
+  set 7 (Int64.of_int (s.Gc.heap_words * (Sys.word_size / 8)));
+  set 8 (Int64.of_int (s.Gc.top_heap_words * (Sys.word_size / 8)));
+  set 9 (Int64.of_int s.Gc.heap_chunks);
+  Cstruct.LE.set_uint32 buf 8 (Int32.add seq 2l)
+
+let read () =
+  update ();
+  match decode buf with
+  | Some l -> l
+  | None -> []
+
+let export ?domid () = Lwt.return ()
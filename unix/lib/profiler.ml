@@ -0,0 +1,86 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(* The stock runtime has no timer hook of its own: [ITIMER_PROF] sends
+   [SIGPROF], whose handler runs at the next allocation point (in
+   native code) and records the call stack above it. *)
+
+external frames : Printexc.raw_backtrace -> int -> string
+  = "caml_callstack_frames"
+
+let max_frames = 32
+
+let stacks : (string, int ref) Hashtbl.t = Hashtbl.create 256
+let dropped_samples = ref 0
+let busy = ref false
+let saved = ref None
+
+(* The innermost frame of the call stack is this handler. *)
+let tick _ =
+  if !busy then incr dropped_samples
+  else begin
+    busy := true;
+    let key = frames (Printexc.get_callstack (max_frames + 1)) 1 in
+    (try incr (Hashtbl.find stacks key)
+     with Not_found -> Hashtbl.add stacks key (ref 1));
+    busy := false
+  end
+
+let start ?(hz=997) () =
+  if hz < 1 || hz > 10000 then invalid_arg "Profiler.start";
+  if !saved <> None then failwith "Profiler.start: already running";
+  let period = 1. /. float hz in
+  let handler = Sys.signal Sys.sigprof (Sys.Signal_handle tick) in
+  let timer = Unix.setitimer Unix.ITIMER_PROF
+      { Unix.it_interval = period; it_value = period } in
+  saved := Some (handler, timer)
+
+let stop () =
+  match !saved with
+  | None -> ()
+  | Some (handler, timer) ->
+    ignore (Unix.setitimer Unix.ITIMER_PROF timer);
+    Sys.set_signal Sys.sigprof handler;
+    saved := None
+
+(* The frames from the outermost to the innermost, in hexadecimal,
+   separated by semicolons, then the count. *)
+let folded_line b key count =
+  let n = String.length key / 8 in
+  for i = n - 1 downto 0 do
+    let pc = ref 0L in
+    for j = 7 downto 0 do
+      pc := Int64.logor (Int64.shift_left !pc 8)
+          (Int64.of_int (Char.code key.[8 * i + j]))
+    done;
+    Buffer.add_string b (Printf.sprintf "0x%Lx" !pc);
+    Buffer.add_char b (if i > 0 then ';' else ' ')
+  done;
+  Buffer.add_string b (string_of_int count);
+  Buffer.add_char b '\n'
+
+let dump () =
+  let b = Buffer.create 4096 in
+  Hashtbl.iter (fun key count -> folded_line b key !count) stacks;
+  Buffer.contents b
+
+let print () =
+  print_string (dump ());
+  flush stdout
+
+let dropped () = !dropped_samples
+
+let reset () =
+  Hashtbl.reset stacks;
+  dropped_samples := 0
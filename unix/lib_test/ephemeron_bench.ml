@@ -0,0 +1,213 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(* Benchmark of a table keyed by objects, as a per-flow cache would be:
+   [OS.Ephemeron.Make] against a table that keeps its keys in weak arrays
+   and its data in strong arrays beside them.
+
+   A window of [live] flows slides over [total] flows: each step creates
+   a flow, binds it to some data, looks up a few live flows, and drops
+   the oldest one.  The run reports the time per step, then the bindings
+   and the heap left after a full major GC, when only the window should
+   remain.  The data do not point to their keys, since on Unix the
+   ephemerons fall back to strong data and such a binding would never
+   be removed.
+
+   [ephemeron_bench.native [live [total]]]; run by [make unix-bench].
+   Linked into a Xen unikernel instead, it measures the ephemerons of
+   the runtime. *)
+
+type flow = { id: int; mutable packets: int }
+
+module Flow = struct
+  type t = flow
+  let equal a b = a.id = b.id
+  let hash f = Hashtbl.hash f.id
+end
+
+(* Weak keys in per-bucket weak arrays, data in parallel arrays.  A
+   datum stays alive until its slot is reused or the bucket is cleaned
+   after its key has died. *)
+module Weak_table (H : Hashtbl.HashedType) = struct
+  type key = H.t
+
+  type 'a bucket = {
+    mutable keys: key Weak.t;
+    mutable data: 'a option array;
+  }
+
+  type 'a t = {
+    mutable buckets: 'a bucket array;
+    mutable size: int; (* used slots, dead keys included *)
+  }
+
+  let empty_bucket () = { keys = Weak.create 0; data = [||] }
+
+  let create n =
+    let n = if n < 16 then 16 else n in
+    { buckets = Array.init n (fun _ -> empty_bucket ()); size = 0 }
+
+  let index buckets k = (H.hash k land max_int) mod Array.length buckets
+
+  (* Free the slots whose key has died; return the number left. *)
+  let clean_bucket b =
+    let used = ref 0 in
+    for i = 0 to Weak.length b.keys - 1 do
+      if Weak.check b.keys i then incr used
+      else b.data.(i) <- None
+    done;
+    !used
+
+  let clean tbl =
+    tbl.size <- Array.fold_left (fun n b -> n + clean_bucket b) 0 tbl.buckets
+
+  (* Store [k] and [d] in a free slot of [b], growing it if needed. *)
+  let add_to_bucket b k d =
+    let n = Weak.length b.keys in
+    let rec free i =
+      if i >= n then -1
+      else if Weak.check b.keys i then free (i + 1)
+      else i in
+    let i = free 0 in
+    let i =
+      if i >= 0 then i
+      else begin
+        let n' = if n = 0 then 2 else 2 * n in
+        let keys = Weak.create n' and data = Array.make n' None in
+        Weak.blit b.keys 0 keys 0 n;
+        Array.blit b.data 0 data 0 n;
+        b.keys <- keys;
+        b.data <- data;
+        n
+      end in
+    Weak.set b.keys i (Some k);
+    b.data.(i) <- Some d
+
+  let resize tbl =
+    let old = tbl.buckets in
+    let buckets =
+      Array.init (2 * Array.length old) (fun _ -> empty_bucket ()) in
+    tbl.size <- 0;
+    Array.iter (fun b ->
+      for i = 0 to Weak.length b.keys - 1 do
+        match Weak.get b.keys i, b.data.(i) with
+        | Some k, Some d ->
+          add_to_bucket buckets.(index buckets k) k d;
+          tbl.size <- tbl.size + 1
+        | _ -> ()
+      done
+    ) old;
+    tbl.buckets <- buckets
+
+  let rec find_slot b k i =
+    if i >= Weak.length b.keys then -1
+    else match Weak.get b.keys i with
+      | Some k' when H.equal k k' -> i
+      | _ -> find_slot b k (i + 1)
+
+  let replace tbl k d =
+    let b = tbl.buckets.(index tbl.buckets k) in
+    let i = find_slot b k 0 in
+    if i >= 0 then b.data.(i) <- Some d
+    else begin
+      add_to_bucket b k d;
+      tbl.size <- tbl.size + 1;
+      if tbl.size > 2 * Array.length tbl.buckets then begin
+        clean tbl;
+        if tbl.size > Array.length tbl.buckets then resize tbl
+      end
+    end
+
+  let find tbl k =
+    let b = tbl.buckets.(index tbl.buckets k) in
+    let i = find_slot b k 0 in
+    if i < 0 then raise Not_found;
+    match b.data.(i) with
+    | Some d -> d
+    | None -> raise Not_found
+
+  let remove tbl k =
+    let b = tbl.buckets.(index tbl.buckets k) in
+    let i = find_slot b k 0 in
+    if i >= 0 then begin
+      Weak.set b.keys i None;
+      b.data.(i) <- None;
+      tbl.size <- tbl.size - 1
+    end
+
+  let length tbl =
+    Array.fold_left (fun n b ->
+      let m = ref n in
+      for i = 0 to Weak.length b.keys - 1 do
+        if Weak.check b.keys i then incr m
+      done;
+      !m
+    ) 0 tbl.buckets
+end
+
+module type TABLE = sig
+  type 'a t
+  val create : int -> 'a t
+  val replace : 'a t -> flow -> 'a -> unit
+  val find : 'a t -> flow -> 'a
+  val length : 'a t -> int
+end
+
+let lookups = 4
+
+module Run (T : TABLE) = struct
+  let run name live total =
+    Gc.compact ();
+    let tbl = T.create 16 in
+    let window = Array.make live None in
+    let found = ref 0 in
+    let t0 = Unix.gettimeofday () in
+    for id = 0 to total - 1 do
+      let f = { id; packets = 0 } in
+      T.replace tbl f (Array.make 8 id);
+      (* The oldest flow is dropped without being removed. *)
+      window.(id mod live) <- Some f;
+      for j = 1 to lookups do
+        match window.((id + j * 7919) mod live) with
+        | None -> ()
+        | Some f ->
+          f.packets <- f.packets + 1;
+          (try if (T.find tbl f).(0) = f.id then incr found
+           with Not_found -> ())
+      done
+    done;
+    let t1 = Unix.gettimeofday () in
+    Gc.full_major ();
+    let st = Gc.stat () in
+    (* Reading the window afterwards keeps its flows alive until then. *)
+    let open_flows =
+      Array.fold_left (fun n f -> if f = None then n else n + 1) 0 window in
+    Printf.printf "%-10s %8.1f ns/step  found %d/%d  bindings %d/%d  \
+                   live heap %d words  major GCs %d\n%!"
+      name ((t1 -. t0) /. float total *. 1e9) !found (total * lookups)
+      (T.length tbl) open_flows st.Gc.live_words st.Gc.major_collections
+end
+
+module E = Run (OS.Ephemeron.Make (Flow))
+module W = Run (Weak_table (Flow))
+
+let () =
+  let arg i default =
+    if Array.length Sys.argv > i then int_of_string Sys.argv.(i)
+    else default in
+  let live = arg 1 10_000 in
+  let total = arg 2 1_000_000 in
+  Printf.printf "%d live flows, %d flows in all\n" live total;
+  E.run "ephemeron" live total;
+  W.run "weak-array" live total
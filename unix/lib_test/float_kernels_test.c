@@ -0,0 +1,344 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Differential tests and benchmarks of the kernels of float_stubs.c.
+
+   The stubs are included whole, so that their static kernels can be
+   called one variant at a time; STUBS names the copy to test (the Unix
+   and Xen copies are the same file).  Every SIMD variant that the CPU
+   supports is checked against the portable one:
+   - [min], [max], [axpy] and [scale] must return the same bits;
+   - [sum] and [dot] must be exact on integer data, and within the
+     rounding bound of a sum of [n] terms otherwise.
+   Lengths 0 to 70 and a few long ones are tried at every alignment
+   modulo 4 doubles, with NaN, infinities and signed zeros mixed in.
+
+   [float_kernels_test bench] prints the time per element of each
+   kernel instead. */
+
+#ifndef STUBS
+#define STUBS "../lib/float_stubs.c"
+#endif
+#include STUBS
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Only the primitives need the runtime, and they are not called. */
+value
+caml_copy_double(double d)
+{
+  (void) d;
+  abort();
+}
+
+struct variant {
+  const char *name;
+  struct float_kernels k;
+};
+
+static struct variant variants[3];
+static int num_variants = 0;
+
+static void
+add_variant(const char *name, struct float_kernels k)
+{
+  variants[num_variants].name = name;
+  variants[num_variants].k = k;
+  num_variants++;
+}
+
+static void
+init_variants(void)
+{
+  struct float_kernels c = { sum_c, dot_c, axpy_c, scale_c, extremum_c };
+
+  add_variant("c", c);
+#ifdef HAVE_SSE2
+  {
+    struct float_kernels k = { sum_sse2, dot_sse2, axpy_sse2, scale_sse2,
+                               extremum_sse2 };
+    add_variant("sse2", k);
+  }
+#endif
+#ifdef HAVE_AVX2
+  if (cpu_has_avx2()) {
+    struct float_kernels k = { sum_avx2, dot_avx2, axpy_avx2, scale_avx2,
+                               extremum_avx2 };
+    add_variant("avx2", k);
+  }
+#endif
+}
+
+static uint64_t
+bits(double d)
+{
+  uint64_t i;
+
+  memcpy(&i, &d, sizeof i);
+  return i;
+}
+
+static int failures = 0;
+
+static void
+fail(const char *what, const char *name, size_t n, size_t off,
+     double got, double want)
+{
+  if (failures++ < 20)
+    fprintf(stderr, "%s/%s n=%lu off=%lu: got %.17g (%016llx), "
+            "want %.17g (%016llx)\n", what, name, (unsigned long) n,
+            (unsigned long) off, got, (unsigned long long) bits(got),
+            want, (unsigned long long) bits(want));
+}
+
+static void
+same_bits(const char *what, const char *name, size_t n, size_t off,
+          double got, double want)
+{
+  if (bits(got) != bits(want)) fail(what, name, n, off, got, want);
+}
+
+/* [got] is within the error bound of a sum of [n] terms whose absolute
+   values add up to [abs]. */
+static void
+close_to(const char *what, const char *name, size_t n, size_t off,
+         double got, long double want, long double abs)
+{
+  long double bound = (n + 1) * DBL_EPSILON * abs;
+  int ok;
+
+  if (want != want) ok = got != got;
+  else if (isinf(want)) ok = got == want;
+  else ok = fabsl(got - want) <= bound;
+  if (!ok) fail(what, name, n, off, got, (double) want);
+}
+
+static uint64_t seed = 0x2545F4914F6CDD1DULL;
+
+static uint64_t
+next_random(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+/* Mostly finite values of varied magnitude; [specials] out of 64 are
+   NaN, infinities or zeros of either sign. */
+static double
+random_double(int integers, int specials)
+{
+  uint64_t r = next_random();
+
+  if ((int) (r & 63) < specials) {
+    switch ((r >> 6) & 7) {
+    case 0: return nan_value();
+    case 1: return INFINITY;
+    case 2: return -INFINITY;
+    case 3: case 4: return -0.0;
+    default: return 0.0;
+    }
+  }
+  if (integers) return (double) ((int64_t) (r >> 8) % 2001 - 1000);
+  return ldexp((double) (int64_t) (r >> 11) / (double) (1ULL << 52),
+               (int) ((r >> 6) % 41) - 20);
+}
+
+#define MAX_N 4099
+
+static double xs[MAX_N + 4], ys[MAX_N + 4], y0s[MAX_N + 4], y1s[MAX_N + 4];
+
+static void
+check(size_t n, size_t off, int integers, int specials)
+{
+  double *x = xs + off, *y = ys + off;
+  long double sum = 0, sum_abs = 0, dot = 0, dot_abs = 0;
+  double a = random_double(0, 0), min, max, got;
+  size_t i;
+  int v;
+
+  for (i = 0; i < n; i++) {
+    x[i] = random_double(integers, specials);
+    y[i] = random_double(integers, specials);
+    sum += x[i];
+    sum_abs += fabsl((long double) x[i]);
+    dot += (long double) x[i] * y[i];
+    dot_abs += fabsl((long double) x[i] * y[i]);
+  }
+  if (n > 0) {
+    min = extremum_c(x, n, 0);
+    max = extremum_c(x, n, 1);
+  }
+  memcpy(y0s, y, n * sizeof(double));
+  axpy_c(a, x, y0s, n);
+  for (v = 0; v < num_variants; v++) {
+    const char *name = variants[v].name;
+    const struct float_kernels *k = &variants[v].k;
+
+    got = k->sum(x, n);
+    if (integers && specials == 0) same_bits("sum", name, n, off, got, sum);
+    else close_to("sum", name, n, off, got, sum, sum_abs);
+    got = k->dot(x, y, n);
+    if (integers && specials == 0) same_bits("dot", name, n, off, got, dot);
+    else close_to("dot", name, n, off, got, dot, dot_abs);
+    if (n > 0) {
+      same_bits("min", name, n, off, k->extremum(x, n, 0), min);
+      same_bits("max", name, n, off, k->extremum(x, n, 1), max);
+    }
+    memcpy(y1s, y, n * sizeof(double));
+    k->axpy(a, x, y1s, n);
+    for (i = 0; i < n; i++)
+      same_bits("axpy", name, n, off, y1s[i], y0s[i]);
+    memcpy(y1s, x, n * sizeof(double));
+    k->scale(a, y1s, n);
+    for (i = 0; i < n; i++)
+      same_bits("scale", name, n, off, y1s[i], a * x[i]);
+  }
+}
+
+/* Every vector of up to 8 elements drawn from [-0., 0., -1., 1.], to
+   exercise the order of signed zeros in every lane. */
+static void
+check_zeros(void)
+{
+  static const double vals[4] = { -0.0, 0.0, -1.0, 1.0 };
+  double x[8];
+  size_t n, i;
+  unsigned c, cs;
+  int v;
+
+  for (n = 1; n <= 8; n++) {
+    for (cs = 1, i = 0; i < n; i++) cs *= 4;
+    for (c = 0; c < cs; c++) {
+      for (i = 0; i < n; i++) x[i] = vals[(c >> (2 * i)) & 3];
+      for (v = 1; v < num_variants; v++) {
+        same_bits("min/zeros", variants[v].name, n, 0,
+                  variants[v].k.extremum(x, n, 0), extremum_c(x, n, 0));
+        same_bits("max/zeros", variants[v].name, n, 0,
+                  variants[v].k.extremum(x, n, 1), extremum_c(x, n, 1));
+      }
+    }
+  }
+  x[0] = 0.0; x[1] = -0.0;
+  same_bits("min/zeros", "c", 2, 0, extremum_c(x, 2, 0), -0.0);
+  same_bits("max/zeros", "c", 2, 0, extremum_c(x, 2, 1), 0.0);
+}
+
+static int
+test(void)
+{
+  static const size_t long_ns[] = { 255, 256, 1000, 4096, MAX_N };
+  size_t n, off, j;
+  int v;
+
+  printf("variants:");
+  for (v = 0; v < num_variants; v++) printf(" %s", variants[v].name);
+  printf("\n");
+  for (off = 0; off < 4; off++) {
+    for (n = 0; n <= 70; n++) {
+      check(n, off, 1, 0);
+      check(n, off, 0, 0);
+      check(n, off, 0, 4);
+      check(n, off, 1, 16);
+    }
+    for (j = 0; j < sizeof long_ns / sizeof long_ns[0]; j++) {
+      check(long_ns[j], off, 1, 0);
+      check(long_ns[j], off, 0, 0);
+      check(long_ns[j], off, 0, 1);
+    }
+  }
+  check_zeros();
+  if (failures > 0) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static volatile double sink;
+
+static void
+bench_size(size_t n, double *x, double *y)
+{
+  static const char *kernels[] = { "sum", "dot", "axpy", "scale", "min" };
+  size_t reps = 200000000 / n + 1, r, j;
+  double t, base = 0.0;
+  int v;
+
+  for (j = 0; j < sizeof kernels / sizeof kernels[0]; j++) {
+    printf("%-6s n=%-8lu", kernels[j], (unsigned long) n);
+    for (v = 0; v < num_variants; v++) {
+      const struct float_kernels *k = &variants[v].k;
+
+      t = now();
+      for (r = 0; r < reps; r++) {
+        switch (j) {
+        case 0: sink = k->sum(x, n); break;
+        case 1: sink = k->dot(x, y, n); break;
+        case 2: k->axpy(1e-9, x, y, n); break;
+        case 3: k->scale(1.0, y, n); break;
+        default: sink = k->extremum(x, n, 0); break;
+        }
+      }
+      t = (now() - t) / ((double) reps * n) * 1e9;
+      if (v == 0) base = t;
+      printf("  %s %.3f ns/elt (x%.1f)", variants[v].name, t, base / t);
+    }
+    printf("\n");
+  }
+}
+
+static int
+bench(void)
+{
+  static const size_t ns[] = { 16, 1000, 100000, 4000000 };
+  double *x, *y;
+  size_t i, j;
+
+  x = malloc(ns[3] * sizeof(double));
+  y = malloc(ns[3] * sizeof(double));
+  if (x == NULL || y == NULL) return 1;
+  for (i = 0; i < ns[3]; i++) {
+    x[i] = random_double(0, 0);
+    y[i] = random_double(0, 0);
+  }
+  for (j = 0; j < sizeof ns / sizeof ns[0]; j++) bench_size(ns[j], x, y);
+  free(x);
+  free(y);
+  return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  init_variants();
+  if (argc > 1 && strcmp(argv[1], "bench") == 0) return bench();
+  return test();
+}
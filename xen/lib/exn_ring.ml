@@ -0,0 +1,26 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+external set_active : bool -> unit = "caml_exn_ring_set_active"
+external active : unit -> bool = "caml_exn_ring_status"
+external count : unit -> int = "caml_exn_ring_count"
+external entries : unit -> (string * Printexc.raw_backtrace) array
+  = "caml_exn_ring_entries"
+
+let recent () = Array.to_list (entries ())
+
+let print oc =
+  List.iter (fun (name, frames) ->
+    Printf.fprintf oc "%s\n%s" name (Printexc.raw_backtrace_to_string frames)
+  ) (recent ())
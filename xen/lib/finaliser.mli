@@ -0,0 +1,48 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Pacing of the finalisation functions registered with [Gc.finalise].
+
+    The finalisation functions of the values found dead by a major
+    cycle are normally all called at once, at the end of the next
+    minor collection.  With a batch limit, at most that many are
+    called each time; the others are called in later batches, at the
+    following minor collections or when the domain is idle (see
+    {!Main.run}).  [Gc.major], [Gc.full_major] and [Gc.compact] still
+    call all of them. *)
+
+val batch : unit -> int
+(** [batch ()] is the maximum number of finalisation functions called
+    in one batch; [0] (the default) means no limit. *)
+
+val set_batch : int -> unit
+(** [set_batch n] sets the batch limit.
+    @raise Invalid_argument if [n] is negative. *)
+
+val run_pending : unit -> bool
+(** [run_pending ()] calls a batch of the finalisation functions that
+    are waiting, and returns [false] if there were none. *)
+
+type stats = {
+  registered: int; (** Values with a finalisation function, not yet dead. *)
+  pending: int;    (** Finalisation functions waiting to be called. *)
+  calls: int;      (** Finalisation functions called so far. *)
+  deferred: int;   (** Batches that hit the limit. *)
+  time: float;     (** Time spent in batches, in seconds. *)
+  max_time: float; (** Longest batch, in seconds. *)
+}
+
+val stats : unit -> stats
+(** [stats ()] is the state of the finalisation queue and the run-time
+    counters. *)
@@ -0,0 +1,34 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(* Keep in sync with runtime/ocaml/gc_events.h *)
+type kind =
+  | Minor
+  | Major_slice
+  | Compaction
+  | Heap_growth
+  | Evacuation
+
+type event = {
+  time: float;
+  kind: kind;
+  duration: float;
+  words: int;
+}
+
+external histogram : kind -> int array = "caml_gc_events_histogram"
+external max_pause : kind -> float = "caml_gc_events_max"
+external set_log_size : int -> unit = "caml_gc_events_set_log_size"
+external snapshot : unit -> event array = "caml_gc_events_snapshot"
+external reset : unit -> unit = "caml_gc_events_reset"
@@ -0,0 +1,63 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Timing of the garbage collector pauses.
+
+    Every minor collection, major slice, compaction and heap growth is
+    timed with the monotonic clock of the domain, and counted in a
+    histogram with one bucket per power of two nanoseconds.  The
+    events can also be recorded in a fixed-size log, to correlate
+    latency spikes with GC activity.  A heap growth may happen during
+    a minor collection, and a compaction or an evacuation slice at the
+    end of a major slice, so their durations are also counted in the
+    enclosing event. *)
+
+type kind =
+  | Minor        (** Minor collection. *)
+  | Major_slice  (** Slice of marking, sweeping or evacuation of the major heap. *)
+  | Compaction   (** Compaction of the major heap. *)
+  | Heap_growth  (** Addition of a chunk to the major heap. *)
+  | Evacuation   (** Evacuation slice, see {!Heap.evacuation}. *)
+
+type event = {
+  time: float;     (** End of the event on the monotonic clock, in seconds. *)
+  kind: kind;
+  duration: float; (** In seconds. *)
+  words: int;
+  (** Words processed: size of the minor heap used for [Minor], work
+      done for [Major_slice], heap size for [Compaction], size of the
+      new chunk for [Heap_growth], and words moved for [Evacuation]. *)
+}
+
+val histogram : kind -> int array
+(** [histogram k] is the distribution of the durations of the events
+    of kind [k]: element [i] is the number of events that took
+    between [2{^i}] and [2{^i+1}] nanoseconds (bucket [0] also holds
+    the events shorter than 1 ns).  Trailing empty buckets are
+    omitted. *)
+
+val max_pause : kind -> float
+(** [max_pause k] is the longest duration of an event of kind [k], in
+    seconds. *)
+
+val set_log_size : int -> unit
+(** [set_log_size n] records the last [n] events in the log, and
+    empties it.  [0] (the default) disables the log.
+    @raise Invalid_argument if [n] is negative. *)
+
+val snapshot : unit -> event array
+(** [snapshot ()] is the contents of the log, oldest event first. *)
+
+val reset : unit -> unit
+(** [reset ()] empties the histograms and the log. *)
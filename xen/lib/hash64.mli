@@ -0,0 +1,38 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Fast seedable 64-bit hashing of strings and buffers.
+
+    The hash reads the whole input several words at a time.  It is meant
+    for flow tables and for detecting duplicate payloads; it is not a
+    cryptographic hash, and it is unrelated to [Hashtbl.hash], which is
+    unchanged.  The same input and seed give the same hash on every
+    platform.  The [_int] variants return the hash truncated to an
+    [int] and do not allocate. *)
+
+val string : ?seed:int -> ?off:int -> ?len:int -> string -> int64
+(** [string ?seed ?off ?len s] hashes the [len] bytes of [s] starting at
+    [off].  [seed] defaults to [0], [off] to [0] and [len] to the rest
+    of the string.
+    @raise Invalid_argument if [off] and [len] do not designate a valid
+    substring of [s]. *)
+
+val cstruct : ?seed:int -> Cstruct.t -> int64
+(** [cstruct ?seed c] hashes the bytes of [c] in place. *)
+
+val string_int : ?seed:int -> ?off:int -> ?len:int -> string -> int
+(** [string_int] is {!string} truncated to an [int]. *)
+
+val cstruct_int : ?seed:int -> Cstruct.t -> int
+(** [cstruct_int] is {!cstruct} truncated to an [int]. *)
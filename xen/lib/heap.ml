@@ -0,0 +1,50 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+type evacuation = {
+  threshold: int;
+  pause: int;
+}
+
+external get_evacuation : unit -> evacuation = "caml_gc_get_evacuation"
+external set_evacuation : evacuation -> unit = "caml_gc_set_evacuation"
+external evacuated_chunks : unit -> int = "caml_gc_evacuated_chunks"
+
+type external_memory = {
+  budget: int;
+  size: int;
+  peak: int;
+}
+
+external external_memory : unit -> external_memory = "caml_gc_external_memory"
+external set_external_budget : int -> unit = "caml_gc_set_external_budget"
+
+type global_roots = {
+  plain: int;
+  young: int;
+  old: int;
+}
+
+external global_roots : unit -> global_roots = "caml_gc_global_roots"
+
+type large_objects = {
+  threshold: int;
+  chunks: int;
+  bytes: int;
+  allocated: int;
+  freed: int;
+}
+
+external large_objects : unit -> large_objects = "caml_gc_large_objects"
+external set_large_threshold : int -> unit = "caml_gc_set_large_threshold"
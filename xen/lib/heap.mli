@@ -0,0 +1,114 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Major heap controls specific to the Xen runtime.
+
+    At boot, the initial sizes of the heaps are fractions of the memory
+    of the domain, in thousandths: [h] for the major heap (default
+    [125]), [i] for its increment ([31]), [s] for the minor heap ([4],
+    at most 32 MiB) and [x] for the external memory budget ([250]).
+    They can be changed with a [MIRAGE_HEAP=h=250,s=8] word on the
+    command line of the domain; [OCAMLRUNPARAM] can also be given
+    there, and overrides the resulting sizes. *)
+
+(** Evacuation of sparse heap chunks.  At the end of each major
+    cycle, the heap chunks with little live data are selected.  The
+    next sweep takes them out of service: nothing new is allocated in
+    them, and those found empty are given back to the domain at once.
+    The cycle after that moves their live blocks to the other chunks,
+    updates the pointers to them, and gives the chunks back.  The
+    blocks are moved by the slices of the major GC, after marking, and
+    each slice stops when its [pause] is spent, so that unlike
+    [Gc.compact] the evacuation never stops the program for long; its
+    slices are timed as [Gc_events.Evacuation].  [Gc.compact] and
+    automatic compaction, according to [Gc.max_overhead], are
+    unchanged. *)
+type evacuation = {
+  threshold: int;
+  (** A chunk is evacuated when its live data is less than [threshold]
+      percent of its size.  [0] (the default) disables the
+      evacuation. *)
+  pause: int;
+  (** Time budget of an evacuation slice, in microseconds.  A slice
+      always moves at least one block, and the pointers are updated
+      after the budget is spent, so a slice can take longer.  Default:
+      [1000]. *)
+}
+
+val get_evacuation : unit -> evacuation
+(** [get_evacuation ()] is the current configuration of the
+    evacuation. *)
+
+val set_evacuation : evacuation -> unit
+(** [set_evacuation e] changes the configuration of the evacuation.
+    [threshold] is clamped to [0..100] and [pause] is at least [1]. *)
+
+val evacuated_chunks : unit -> int
+(** [evacuated_chunks ()] is the number of heap chunks given back by
+    the evacuation since the program was started. *)
+
+(** Memory held outside the heap by Io_page buffers and other
+    bigarrays.  The GC does a full major cycle each time the unused
+    part of [budget] is allocated, so it collects more often as the
+    memory in use approaches the budget.  The default budget is a
+    quarter of the memory of the domain. *)
+type external_memory = {
+  budget: int;  (** In bytes. *)
+  size: int;    (** Bytes currently held. *)
+  peak: int;    (** Largest value of [size] so far. *)
+}
+
+val external_memory : unit -> external_memory
+(** [external_memory ()] is the current accounting of external
+    memory. *)
+
+val set_external_budget : int -> unit
+(** [set_external_budget n] sets the budget to [n] bytes (at least one
+    page). *)
+
+(** Global roots registered by C code.  [young] roots are scanned by
+    the next minor collection, which moves them to [old]; [old] roots
+    are only scanned by the major GC.  [plain] roots, registered with
+    [caml_register_global_root], are scanned by every collection. *)
+type global_roots = {
+  plain: int;
+  young: int;
+  old: int;
+}
+
+val global_roots : unit -> global_roots
+(** [global_roots ()] is the number of global roots of each kind. *)
+
+(** The large-object space.  Strings, float arrays and other arrays or
+    records of at least [threshold] bytes allocated in the major heap
+    get a chunk of their own, in whole pages, which is given back as
+    soon as the block is found dead by the sweeper.  They do not
+    fragment the free list of small blocks and are never moved by
+    compaction.  The default threshold is 128 KiB. *)
+type large_objects = {
+  threshold: int;  (** In bytes; [0] if the space is disabled. *)
+  chunks: int;     (** Large blocks currently allocated. *)
+  bytes: int;      (** Memory they use, in bytes. *)
+  allocated: int;  (** Large blocks allocated since startup. *)
+  freed: int;      (** Large blocks freed since startup. *)
+}
+
+val large_objects : unit -> large_objects
+(** [large_objects ()] is the current state of the large-object
+    space. *)
+
+val set_large_threshold : int -> unit
+(** [set_large_threshold n] makes blocks of at least [n] bytes (at
+    least one page) large.  [set_large_threshold 0] disables the
+    large-object space for new blocks. *)
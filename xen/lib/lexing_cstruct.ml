@@ -0,0 +1,244 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+type position = Lexing.position = {
+  pos_fname : string;
+  pos_lnum : int;
+  pos_bol : int;
+  pos_cnum : int;
+}
+
+let dummy_pos = Lexing.dummy_pos
+
+type lexbuf = {
+  refill_buff : lexbuf -> unit;
+  mutable lex_buffer : Cstruct.buffer;
+  mutable lex_buffer_len : int;
+  mutable lex_abs_pos : int;
+  mutable lex_start_pos : int;
+  mutable lex_curr_pos : int;
+  mutable lex_last_pos : int;
+  mutable lex_last_action : int;
+  mutable lex_eof_reached : bool;
+  mutable lex_mem : int array;
+  mutable lex_start_p : position;
+  mutable lex_curr_p : position;
+}
+
+type lex_tables = Lexing.lex_tables = {
+  lex_base : string;
+  lex_backtrk : string;
+  lex_default : string;
+  lex_trans : string;
+  lex_check : string;
+  lex_base_code : string;
+  lex_backtrk_code : string;
+  lex_default_code : string;
+  lex_trans_code : string;
+  lex_check_code : string;
+  lex_code : string;
+}
+
+external c_engine : lex_tables -> int -> lexbuf -> int
+  = "caml_lex_engine_bigarray"
+external c_new_engine : lex_tables -> int -> lexbuf -> int
+  = "caml_new_lex_engine_bigarray"
+
+let engine tbl state lb =
+  let result = c_engine tbl state lb in
+  if result >= 0 then begin
+    lb.lex_start_p <- lb.lex_curr_p;
+    lb.lex_curr_p <-
+      { lb.lex_curr_p with pos_cnum = lb.lex_abs_pos + lb.lex_curr_pos }
+  end;
+  result
+
+let new_engine tbl state lb =
+  let result = c_new_engine tbl state lb in
+  if result >= 0 then begin
+    lb.lex_start_p <- lb.lex_curr_p;
+    lb.lex_curr_p <-
+      { lb.lex_curr_p with pos_cnum = lb.lex_abs_pos + lb.lex_curr_pos }
+  end;
+  result
+
+let zero_pos = { pos_fname = ""; pos_lnum = 1; pos_bol = 0; pos_cnum = 0 }
+
+let empty = Bigarray.Array1.create Bigarray.char Bigarray.c_layout 0
+
+(* Move the positions of [lb] by [d] bytes in the buffer, keeping the
+   same positions in the input. *)
+let shift lb d =
+  lb.lex_abs_pos <- lb.lex_abs_pos - d;
+  lb.lex_start_pos <- lb.lex_start_pos + d;
+  lb.lex_curr_pos <- lb.lex_curr_pos + d;
+  lb.lex_last_pos <- lb.lex_last_pos + d;
+  let mem = lb.lex_mem in
+  for i = 0 to Array.length mem - 1 do
+    if mem.(i) >= 0 then mem.(i) <- mem.(i) + d
+  done
+
+let blit src srcoff dst dstoff len =
+  Bigarray.Array1.blit
+    (Bigarray.Array1.sub src srcoff len) (Bigarray.Array1.sub dst dstoff len)
+
+(* State of the refills of a lexer buffer over a sequence of cstructs.
+   A token that straddles two cstructs is lexed from [scratch], which
+   holds the beginning of the token followed by the beginning of [src],
+   the next cstruct.  The first byte of [src] is at [src_at] in
+   [scratch], or [src_at] is -1 when the lexer buffer is in place. *)
+type source = {
+  next : unit -> Cstruct.t option;
+  mutable scratch : Cstruct.buffer;
+  mutable src : Cstruct.t;
+  mutable src_at : int;
+}
+
+(* Make [scratch] hold the current token, up to the end of the lexer
+   buffer, followed by [n] bytes of [c] from [off]. *)
+let stage st lb c off n =
+  let keep = lb.lex_buffer_len - lb.lex_start_pos in
+  let size = keep + n in
+  if Bigarray.Array1.dim st.scratch < size then begin
+    let dst = Bigarray.Array1.create Bigarray.char Bigarray.c_layout
+        (max size (2 * Bigarray.Array1.dim st.scratch)) in
+    blit lb.lex_buffer lb.lex_start_pos dst 0 keep;
+    st.scratch <- dst
+  end else
+    blit lb.lex_buffer lb.lex_start_pos st.scratch 0 keep;
+  blit c.Cstruct.buffer off st.scratch keep n;
+  shift lb (- lb.lex_start_pos);
+  lb.lex_buffer <- st.scratch;
+  lb.lex_buffer_len <- size
+
+(* Bytes of the next cstruct copied at a time behind a straddling
+   token: enough for the end of most tokens. *)
+let step = 16
+
+let rec refill st lb =
+  if st.src_at < 0 then begin
+    let rec get () =
+      match st.next () with
+      | Some c when Cstruct.len c = 0 -> get ()
+      | r -> r in
+    match get () with
+    | None -> lb.lex_eof_reached <- true
+    | Some c ->
+      let keep = lb.lex_buffer_len - lb.lex_start_pos in
+      if keep = 0 then begin
+        (* The next token starts in [c]: lex it in place. *)
+        shift lb (c.Cstruct.off - lb.lex_start_pos);
+        lb.lex_buffer <- c.Cstruct.buffer;
+        lb.lex_buffer_len <- c.Cstruct.off + c.Cstruct.len
+      end else begin
+        (* The current token runs on into [c]. *)
+        stage st lb c c.Cstruct.off (min c.Cstruct.len (max step keep));
+        st.src <- c;
+        st.src_at <- keep
+      end
+  end else begin
+    let c = st.src in
+    let copied = lb.lex_buffer_len - st.src_at in
+    if lb.lex_start_pos >= st.src_at then begin
+      (* The straddling token is done, and the current one started in
+         [c]: go back to lexing [c] in place. *)
+      shift lb (c.Cstruct.off - st.src_at);
+      lb.lex_buffer <- c.Cstruct.buffer;
+      lb.lex_buffer_len <- c.Cstruct.off + c.Cstruct.len;
+      st.src_at <- -1
+    end else if copied < c.Cstruct.len then begin
+      (* The straddling token goes on: copy more of [c]. *)
+      st.src_at <- st.src_at - lb.lex_start_pos;
+      stage st lb c (c.Cstruct.off + copied)
+        (min (c.Cstruct.len - copied) (max step copied))
+    end else begin
+      (* It goes on past the end of [c]. *)
+      st.src_at <- -1;
+      refill st lb
+    end
+  end
+
+let from_function next =
+  let st = { next; scratch = empty; src = Cstruct.create 0; src_at = -1 } in
+  { refill_buff = refill st;
+    lex_buffer = empty;
+    lex_buffer_len = 0;
+    lex_abs_pos = 0;
+    lex_start_pos = 0;
+    lex_curr_pos = 0;
+    lex_last_pos = 0;
+    lex_last_action = 0;
+    lex_mem = [||];
+    lex_eof_reached = false;
+    lex_start_p = zero_pos;
+    lex_curr_p = zero_pos;
+  }
+
+let from_cstructs cs =
+  let rest = ref cs in
+  from_function (fun () ->
+    match !rest with
+    | [] -> None
+    | c :: tl -> rest := tl; Some c)
+
+let from_cstruct c =
+  let off = c.Cstruct.off in
+  { refill_buff = (fun lb -> lb.lex_eof_reached <- true);
+    lex_buffer = c.Cstruct.buffer;
+    lex_buffer_len = off + c.Cstruct.len;
+    lex_abs_pos = - off;
+    lex_start_pos = off;
+    lex_curr_pos = off;
+    lex_last_pos = off;
+    lex_last_action = 0;
+    lex_mem = [||];
+    lex_eof_reached = true;
+    lex_start_p = zero_pos;
+    lex_curr_p = zero_pos;
+  }
+
+let sub_lexeme lb i1 i2 =
+  Cstruct.to_string (Cstruct.of_bigarray ~off:i1 ~len:(i2 - i1) lb.lex_buffer)
+
+let sub_lexeme_opt lb i1 i2 =
+  if i1 >= 0 then Some (sub_lexeme lb i1 i2) else None
+
+let sub_lexeme_char lb i = Bigarray.Array1.get lb.lex_buffer i
+
+let sub_lexeme_char_opt lb i =
+  if i >= 0 then Some (sub_lexeme_char lb i) else None
+
+let lexeme lb = sub_lexeme lb lb.lex_start_pos lb.lex_curr_pos
+
+let lexeme_cstruct lb =
+  Cstruct.of_bigarray ~off:lb.lex_start_pos
+    ~len:(lb.lex_curr_pos - lb.lex_start_pos) lb.lex_buffer
+
+let lexeme_char lb i = Bigarray.Array1.get lb.lex_buffer (lb.lex_start_pos + i)
+
+let lexeme_start lb = lb.lex_start_p.pos_cnum
+let lexeme_end lb = lb.lex_curr_p.pos_cnum
+let lexeme_start_p lb = lb.lex_start_p
+let lexeme_end_p lb = lb.lex_curr_p
+
+let new_line lb =
+  let lcp = lb.lex_curr_p in
+  lb.lex_curr_p <- { lcp with pos_lnum = lcp.pos_lnum + 1;
+                              pos_bol = lcp.pos_cnum }
+
+let flush_input lb =
+  lb.lex_curr_pos <- 0;
+  lb.lex_abs_pos <- 0;
+  lb.lex_curr_p <- { lb.lex_curr_p with pos_cnum = 0 };
+  lb.lex_buffer_len <- 0
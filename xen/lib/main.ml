@@ -24,6 +24,7 @@
 open Lwt
 
 external block_domain : float -> unit = "caml_block_domain"
+external set_timers : int -> unit = "caml_metrics_set_timers" "noalloc"
 
 let evtchn = Eventchn.init ()
 
@@ -63,12 +64,17 @@ let run t =
              * and continue without blocking. *)
             Activations.run evtchn;
             false
-          end else begin
+          end else if Finaliser.run_pending () then
+            (* Use the idle time for finalisers left over by the GC,
+             * then look for work again: they may have woken threads. *)
+            false
+          else begin
             let timeout =
               match Time.select_next Clock.time with
               |None -> 86400.0 (* one day = 24 * 60 * 60 s *)
               |Some tm -> tm
             in
+            set_timers (Time.sleepers ());
             block_domain timeout;
             false
           end
@@ -0,0 +1,46 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+external to_bigarray :
+  Cstruct.buffer -> int -> int -> 'a -> Marshal.extern_flags list -> int
+  = "caml_output_value_to_bigarray"
+external to_cstructs_ :
+  Cstruct.t list -> 'a -> Marshal.extern_flags list -> int
+  = "caml_output_value_to_cstructs"
+external of_bigarray : Cstruct.buffer -> int -> int -> 'a
+  = "caml_input_value_from_bigarray"
+external of_cstructs_ : Cstruct.t list -> 'a
+  = "caml_input_value_from_cstructs"
+
+let to_cstruct ?(flags=[]) v c =
+  if Cstruct.len c < Marshal.header_size
+  then failwith "Marshal.to_buffer: buffer overflow";
+  to_bigarray c.Cstruct.buffer c.Cstruct.off c.Cstruct.len v flags
+
+let to_cstructs ?(flags=[]) v cs =
+  to_cstructs_ cs v flags
+
+let total_size c =
+  if Cstruct.len c < Marshal.header_size
+  then invalid_arg "Marshal_cstruct.total_size";
+  Marshal.header_size
+  + (Int32.to_int (Cstruct.BE.get_uint32 c 4) land 0xffffffff)
+
+let of_cstruct c =
+  if Cstruct.len c < Marshal.header_size
+  then invalid_arg "Marshal_cstruct.of_cstruct";
+  of_bigarray c.Cstruct.buffer c.Cstruct.off c.Cstruct.len
+
+let of_cstructs cs =
+  of_cstructs_ cs
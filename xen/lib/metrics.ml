@@ -0,0 +1,84 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+open Lwt
+
+let version = 1
+
+let fields = [|
+  "updated"; "minor_words"; "promoted_words"; "major_words";
+  "minor_collections"; "major_collections"; "compactions";
+  "heap_bytes"; "top_heap_bytes"; "heap_chunks";
+  "external_bytes"; "external_peak"; "region_pages"; "region_mapped";
+  "events"; "blocks"; "run_ns"; "sweep_ns"; "blocked_ns"; "timers";
+|]
+
+let magic = 0x54454D4Dl
+let header = 16
+
+let decode c =
+  let seq () = Cstruct.LE.get_uint32 c 8 in
+  let name i =
+    if i < Array.length fields then fields.(i) else Printf.sprintf "field%d" i in
+  let rec attempt n =
+    let s = seq () in
+    if Int32.logand s 1l <> 0l then
+      if n = 0 then None else attempt (n - 1)
+    else begin
+      let count = Int32.to_int (Cstruct.LE.get_uint32 c 12) in
+      let count = max 0 (min count ((Cstruct.len c - header) / 8)) in
+      let values =
+        Array.init count (fun i -> Cstruct.LE.get_uint64 c (header + 8 * i)) in
+      if seq () <> s then
+        if n = 0 then None else attempt (n - 1)
+      else
+        Some (Array.to_list (Array.mapi (fun i v -> name i, v) values))
+    end in
+  if Cstruct.len c < header
+  || Cstruct.LE.get_uint32 c 0 <> magic
+  || Int32.to_int (Cstruct.LE.get_uint32 c 4) <> version then None
+  else attempt 1000
+
+external io_page : unit -> Io_page.t = "caml_metrics_page"
+external update : unit -> unit = "caml_metrics_update" "noalloc"
+
+let page () = Io_page.to_cstruct (io_page ())
+
+let read () =
+  update ();
+  match decode (page ()) with
+  | Some l -> l
+  | None -> []
+
+let exported = ref false
+
+let export ?(domid=0) () =
+  if !exported then return ()
+  else begin
+    exported := true;
+    lwt gnt = Gnt.Gntshr.get () in
+    Gnt.Gntshr.grant_access ~domid ~writable:false gnt (io_page ());
+    lwt xs = Xs.make () in
+    Xs.(immediate xs (fun h ->
+      write h "data/metrics/page-ref" (string_of_int gnt) >>
+      write h "data/metrics/version" (string_of_int version)))
+  end
+
+let () =
+  Main.at_enter (fun () ->
+    try_lwt
+      export ()
+    with exn ->
+      Printf.printf "Metrics.export: %s\n%!" (Printexc.to_string exn);
+      return ())
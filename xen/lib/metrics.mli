@@ -0,0 +1,76 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Runtime metrics shared with dom0.
+
+    The runtime keeps a page of counters about the GC, memory, event
+    channels and the main loop, and refreshes it each time the domain
+    blocks, which costs a few dozen stores per iteration of the main
+    loop.  When the main loop starts, the page is granted read-only to
+    dom0 and its grant reference is written to the [data/metrics/]
+    directory of the domain in XenStore, as [page-ref], next to the
+    [version] of the layout.  A monitor in dom0 maps the page and
+    reads it whenever it likes, without any help from the guest.
+
+    The page starts with a 32-bit magic (["MMET"]), a 32-bit version,
+    a 32-bit sequence number and a 32-bit number of fields, followed
+    by that many 64-bit fields, all little-endian.  The sequence
+    number is odd while the page is being updated; {!decode} implements
+    the corresponding retry loop.  New fields are only ever added at
+    the end.
+
+    On Unix the page is filled from [Gc.quick_stat] by {!update}, and
+    {!export} does nothing. *)
+
+val version : int
+(** The version of the layout of the page. *)
+
+val fields : string array
+(** The names of the fields of the page, in order:
+    - [updated]: time of the last update, in nanoseconds since the
+      domain started;
+    - [minor_words], [promoted_words], [major_words],
+      [minor_collections], [major_collections], [compactions]: as in
+      [Gc.stat];
+    - [heap_bytes], [top_heap_bytes], [heap_chunks]: the major heap;
+    - [external_bytes], [external_peak]: memory held by Io_page
+      buffers and other bigarrays (see [Heap.external_memory] on Xen);
+    - [region_pages], [region_mapped]: pages reserved for the major
+      heap, and backed by memory;
+    - [events]: event channel notifications delivered;
+    - [blocks]: iterations of the main loop that blocked the domain;
+    - [run_ns], [sweep_ns], [blocked_ns]: time spent running, sweeping
+      the heap while idle, and blocked, in nanoseconds;
+    - [timers]: threads in the sleep queue of {!Time}. *)
+
+val page : unit -> Cstruct.t
+(** [page ()] is the metrics page of this domain. *)
+
+val update : unit -> unit
+(** [update ()] refreshes the page now. *)
+
+val decode : Cstruct.t -> (string * int64) list option
+(** [decode c] is a consistent copy of the fields of the metrics page
+    [c], named after {!fields} ([field<n>] for fields added by a later
+    version), or [None] if [c] is not a metrics page or is being
+    updated continuously.  It can read a page mapped from another
+    domain. *)
+
+val read : unit -> (string * int64) list
+(** [read ()] is [decode (page ())] after an {!update}. *)
+
+val export : ?domid:int -> unit -> unit Lwt.t
+(** [export ?domid ()] grants the page read-only to [domid] (default:
+    [0]) and advertises it in XenStore.  It is called when the main
+    loop starts; calling it again does nothing. *)
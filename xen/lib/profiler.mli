@@ -0,0 +1,67 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Sampling CPU profiler.
+
+    While the profiler runs, the domain is interrupted [hz] times per
+    second by its periodic timer, and the interrupted code address is
+    recorded with the OCaml call stack above it.  Samples go to a
+    fixed ring from the interrupt handler, and are aggregated by call
+    stack whenever the domain blocks and when the profile is read.
+    Samples taken while the domain is blocked are counted as idle.
+
+    The call stack of a sample taken in the middle of an OCaml
+    function is found from the first return address on the stack, so
+    its innermost caller may be missing or wrong; the rest of the
+    stack is exact.
+
+    On Unix the timer is [ITIMER_PROF], and samples are taken when
+    [SIGPROF] is handled, which in native code is at the next
+    allocation: code that does not allocate is charged to the next
+    allocation point, which is also the innermost frame of the sample.
+    Time spent blocked is not sampled, so there is no idle line.  The
+    profiler takes [SIGPROF] and [ITIMER_PROF] while it runs, and gives
+    them back on {!stop}. *)
+
+val start : ?hz:int -> unit -> unit
+(** [start ?hz ()] starts sampling [hz] times per second (default
+    [997], prime to avoid beating with periodic work).  Samples taken
+    before are kept.
+    @raise Invalid_argument unless [1 <= hz <= 10000].
+    @raise Failure if the profiler is already running, or the timer
+    of the domain cannot be reprogrammed. *)
+
+val stop : unit -> unit
+(** [stop ()] stops sampling and restores the period that the timer
+    had before {!start}. *)
+
+val dump : unit -> string
+(** [dump ()] is the profile in the folded format of flame graph
+    tools: one line per distinct call stack, with the code addresses
+    in hexadecimal from the outermost frame to the interrupted one,
+    separated by [';'], then a space and the number of samples.  Idle
+    samples are counted on a line [[idle] n].  Addresses can be
+    symbolised against the unikernel image (on Unix, the native
+    executable) with [addr2line]. *)
+
+val print : unit -> unit
+(** [print ()] writes {!dump} to the console, one line at a time. *)
+
+val dropped : unit -> int
+(** [dropped ()] is the number of samples lost because the ring was
+    full (the domain ran for a long time without blocking) or the
+    aggregation table could not grow. *)
+
+val reset : unit -> unit
+(** [reset ()] discards all the samples. *)
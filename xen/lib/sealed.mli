@@ -0,0 +1,57 @@
+(*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *)
+
+(** Sealed values: immutable data kept out of the major heap.
+
+    [seal v] copies the value graph of [v] to memory that the runtime
+    treats like the static data of compiled modules: the major GC
+    neither marks nor sweeps it, so large data loaded at boot (routing
+    tables, databases, static web content) no longer costs work in
+    each major cycle.  Sealed values behave as ordinary values for
+    pattern matching, comparison, hashing and marshalling.  Sharing
+    and cycles are preserved.  The memory is never freed.
+
+    A sealed value must not be mutated to point to the heap, since
+    nothing in the heap is kept alive by it.  Storing such a pointer
+    into a sealed block with a record or array assignment leaves the
+    block unchanged and raises [Invalid_argument], not at the
+    assignment itself but at the next allocation that calls into the
+    runtime.  The check is partial: the memory is not write-protected,
+    so storing integers and other sealed or constant values, changing
+    the characters of a sealed string or the contents of a sealed
+    float array, and writes from C code that bypass [caml_modify] all
+    go through unchecked.
+
+    On Unix the stock OCaml runtime cannot be instrumented: {!seal}
+    returns its argument unchanged. *)
+
+val seal : 'a -> 'a
+(** [seal v] is a sealed copy of [v], or [v] itself if it is an
+    immediate value or is already outside the heap.  The original
+    stays in the heap until it is no longer reachable.
+    @raise Invalid_argument if [v] contains functional values,
+    objects, unforced lazy values, abstract values or custom blocks
+    that need finalisation (such as bigarrays). *)
+
+val is_sealed : 'a -> bool
+(** [is_sealed v] is [true] if [v] is a block in a sealed copy. *)
+
+type stats = {
+  values: int;  (** Number of calls to {!seal} that copied something. *)
+  blocks: int;  (** Number of blocks copied. *)
+  bytes: int;   (** Memory used by the copies, in bytes. *)
+}
+
+val stats : unit -> stats
+(** [stats ()] describes the sealed copies made so far. *)
@@ -43,8 +43,15 @@ module SleepQueue =
                      let compare { time = t1 } { time = t2 } = compare t1 t2
                    end)
 
-(* Threads waiting for a timeout to expire: *)
+(* Threads waiting for a timeout to expire, and their number: *)
 let sleep_queue = ref SleepQueue.empty
+let sleep_queue_size = ref 0
+
+let sleepers () = !sleep_queue_size
+
+let remove_min () =
+  sleep_queue := SleepQueue.remove_min !sleep_queue;
+  decr sleep_queue_size
 
 (* Sleepers added since the last iteration of the main loop:
 
@@ -85,10 +92,10 @@ let in_the_past now t =
 let rec restart_threads now =
   match SleepQueue.lookup_min !sleep_queue with
     | Some{ canceled = true } ->
-        sleep_queue := SleepQueue.remove_min !sleep_queue;
+        remove_min ();
         restart_threads now
     | Some{ time = time; thread = thread } when in_the_past now time ->
-        sleep_queue := SleepQueue.remove_min !sleep_queue;
+        remove_min ();
         Lwt.wakeup thread ();
         restart_threads now
     | _ ->
@@ -106,7 +113,7 @@ let min_timeout a b = match a, b with
 let rec get_next_timeout () =
   match SleepQueue.lookup_min !sleep_queue with
     | Some{ canceled = true } ->
-        sleep_queue := SleepQueue.remove_min !sleep_queue;
+        remove_min ();
         get_next_timeout ()
     | Some{ time = time } ->
         Some time
@@ -118,7 +125,8 @@ let select_next _now =
      sleep queue: *)
   sleep_queue :=
     List.fold_left
-      (fun q e -> SleepQueue.add e q) !sleep_queue !new_sleeps;
+      (fun q e -> incr sleep_queue_size; SleepQueue.add e q)
+      !sleep_queue !new_sleeps;
   new_sleeps := [];
   get_next_timeout ()
 
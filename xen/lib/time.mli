@@ -27,6 +27,10 @@ val select_next : (unit -> float) -> float option
     when one sleeping thread will wake up, or [None] if there is no
     sleeping threads. *)
 
+val sleepers : unit -> int
+(** [sleepers ()] is the number of threads in the sleep queue,
+    including cancelled ones that have not been removed yet. *)
+
 val sleep : float -> unit Lwt.t
 (** [sleep d] is a threads which remain suspended for [d] seconds and
     then terminates. *)
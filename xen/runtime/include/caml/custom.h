@@ -50,6 +50,9 @@ CAMLextern value caml_alloc_custom(struct custom_operations * ops,
                                    uintnat size, /*size in bytes*/
                                    mlsize_t mem, /*resources consumed*/
                                    mlsize_t max  /*max resources*/);
+CAMLextern value caml_alloc_custom_external(struct custom_operations * ops,
+                                            uintnat size, /*size in bytes*/
+                                            uintnat nbytes /*outside heap*/);
 
 CAMLextern void caml_register_custom_operations(struct custom_operations * ops);
 
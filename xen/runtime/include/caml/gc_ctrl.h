@@ -27,7 +27,8 @@ extern intnat
      caml_stat_heap_size,
      caml_stat_top_heap_size,
      caml_stat_compactions,
-     caml_stat_heap_chunks;
+     caml_stat_heap_chunks,
+     caml_stat_evacuated_chunks;
 
 void caml_init_gc (uintnat, uintnat, uintnat,
                    uintnat, uintnat);
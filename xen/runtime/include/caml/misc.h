@@ -88,6 +88,13 @@ extern void caml_ext_table_init(struct ext_table * tbl, int init_capa);
 extern int caml_ext_table_add(struct ext_table * tbl, void * data);
 extern void caml_ext_table_free(struct ext_table * tbl, int free_entries);
 
+/* Byte comparison, a word at a time.  [caml_bytes_mismatch] is the
+   index of the first byte that differs, or [len] if none does;
+   [caml_bytes_compare] orders like [memcmp]. */
+
+CAMLextern uintnat caml_bytes_mismatch (const void *, const void *, uintnat);
+CAMLextern int caml_bytes_compare (const void *, const void *, uintnat);
+
 /* GC flags and messages */
 
 extern uintnat caml_verb_gc;
@@ -84,6 +84,7 @@ extern int caml_frame_descriptors_mask;
 extern void caml_init_frame_descriptors(void);
 extern void caml_register_frametable(intnat *);
 extern void caml_register_dyn_global(void *);
+extern frame_descr * caml_next_frame_descriptor(uintnat * pc, char ** sp);
 
 extern uintnat caml_stack_usage (void);
 extern uintnat (*caml_stack_usage_hook)(void);
@@ -21,4 +21,16 @@
 extern value caml_weak_list_head;
 extern value caml_weak_none;
 
+/* Ephemerons are linked in [caml_ephe_list_head] through field 0, like
+   weak arrays.  The data is kept alive by the major GC only while the
+   ephemeron and its key are; the minor GC treats both fields as strong
+   pointers. */
+extern value caml_ephe_list_head;
+
+#define Ephe_data 1
+#define Ephe_key 2
+#define Ephe_size 3
+
+int caml_ephe_is_white (value v);
+
 #endif /* CAML_WEAK_H */
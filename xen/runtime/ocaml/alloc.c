@@ -21,6 +21,7 @@
 #include "custom.h"
 #include "major_gc.h"
 #include "memory.h"
+#include "memprof.h"
 #include "mlvalues.h"
 #include "stacks.h"
 
@@ -41,6 +42,7 @@ CAMLexport value caml_alloc (mlsize_t wosize, tag_t tag)
     if (tag < No_scan_tag){
       for (i = 0; i < wosize; i++) Field (result, i) = 0;
     }
+    Memprof_sample_small (result);
   }else{
     result = caml_alloc_shr (wosize, tag);
     if (tag < No_scan_tag) memset (Bp_val (result), 0, Bsize_wsize (wosize));
@@ -57,6 +59,7 @@ CAMLexport value caml_alloc_small (mlsize_t wosize, tag_t tag)
   Assert (wosize <= Max_young_wosize);
   Assert (tag < 256);
   Alloc_small (result, wosize, tag);
+  Memprof_sample_small (result);
   return result;
 }
 
@@ -73,6 +76,7 @@ CAMLexport value caml_alloc_string (mlsize_t len)
 
   if (wosize <= Max_young_wosize) {
     Alloc_small (result, wosize, String_tag);
+    Memprof_sample_small (result);
   }else{
     result = caml_alloc_shr (wosize, String_tag);
     result = caml_check_urgent_gc (result);
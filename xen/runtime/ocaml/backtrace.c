@@ -24,7 +24,9 @@
 #include "mlvalues.h"
 #include "stack.h"
 
-int caml_backtrace_active = 0;
+int caml_backtrace_active = 1;
+int caml_backtrace_requested = 0;
+int caml_exn_ring_active = 1;
 int caml_backtrace_pos = 0;
 code_t * caml_backtrace_buffer = NULL;
 value caml_backtrace_last_exn = Val_unit;
@@ -36,8 +38,9 @@ CAMLprim value caml_record_backtrace(value vflag)
 {
   int flag = Int_val(vflag);
 
-  if (flag != caml_backtrace_active) {
-    caml_backtrace_active = flag;
+  if (flag != caml_backtrace_requested) {
+    caml_backtrace_requested = flag;
+    caml_backtrace_active = caml_backtrace_requested || caml_exn_ring_active;
     caml_backtrace_pos = 0;
     if (flag) {
       caml_register_global_root(&caml_backtrace_last_exn);
@@ -52,7 +55,7 @@ CAMLprim value caml_record_backtrace(value vflag)
 
 CAMLprim value caml_backtrace_status(value vunit)
 {
-  return Val_bool(caml_backtrace_active);
+  return Val_bool(caml_backtrace_requested);
 }
 
 /* returns the next frame descriptor (or NULL if none is available),
@@ -105,8 +108,64 @@ frame_descr * caml_next_frame_descriptor(uintnat * pc, char ** sp)
    implementation -- before the more flexible
    [caml_get_current_callstack] was implemented. */
 
+/* The exception ring.  It keeps the name and the raise point of the
+   last [EXN_RING_SIZE] exceptions raised, so that a crash report has
+   some context even when full backtraces are off.  Recording stores
+   two words: the return address of the raise and the name of the
+   exception.  The name is a string constant in the static data of
+   nearly all programs; it is only read if it still is when the ring
+   is read or printed.  The frame of the raise is looked up then too.
+
+   In native code, OCaml [raise]s only call [caml_stash_backtrace] when
+   compiled with [-g]: without it, the ring only sees the exceptions
+   raised from C (by runtime primitives such as array bound checks). */
+
+#define EXN_RING_SIZE 32                /* a power of 2 */
+
+struct exn_ring_entry {
+  uintnat pc;                           /* return address of the raise */
+  value name;
+};
+
+static struct exn_ring_entry exn_ring[EXN_RING_SIZE];
+static uintnat exn_ring_count = 0;
+
+static void exn_ring_record(value exn, uintnat pc)
+{
+  struct exn_ring_entry * e =
+    &exn_ring[exn_ring_count++ & (EXN_RING_SIZE - 1)];
+
+  e->pc = pc;
+  e->name = Field(Field(exn, 0), 0);    /* as in caml_format_exception */
+}
+
+/* The name of an entry, or NULL if it is not a constant string. */
+static char * exn_ring_name(struct exn_ring_entry * e)
+{
+  if (Is_block(e->name) && (Classify_addr(e->name) & In_static_data)
+      && Tag_val(e->name) == String_tag)
+    return String_val(e->name);
+  return NULL;
+}
+
+/* The frame descriptor of the raise of an entry, or NULL. */
+static frame_descr * exn_ring_frame(struct exn_ring_entry * e)
+{
+  frame_descr * d;
+  uintnat h;
+
+  if (caml_frame_descriptors == NULL) caml_init_frame_descriptors();
+  for (h = Hash_retaddr(e->pc); (d = caml_frame_descriptors[h]) != NULL;
+       h = (h + 1) & caml_frame_descriptors_mask) {
+    if (d->retaddr == e->pc) return d;
+  }
+  return NULL;
+}
+
 void caml_stash_backtrace(value exn, uintnat pc, char * sp, char * trapsp)
 {
+  if (caml_exn_ring_active) exn_ring_record(exn, pc);
+  if (! caml_backtrace_requested) return;
   if (exn != caml_backtrace_last_exn) {
     caml_backtrace_pos = 0;
     caml_backtrace_last_exn = exn;
@@ -293,6 +352,82 @@ void caml_print_exception_backtrace(void)
   }
 }
 
+/* Print the exception ring, most recent exception first */
+
+void caml_print_exn_ring(void)
+{
+  uintnat count = exn_ring_count, i, n;
+  struct exn_ring_entry * e;
+  struct loc_info li;
+  frame_descr * d;
+  char * name;
+
+  n = count < EXN_RING_SIZE ? count : EXN_RING_SIZE;
+  if (n == 0) return;
+  fprintf(stderr, "Last %lu exceptions raised, most recent first:\n",
+          (unsigned long) n);
+  for (i = 0; i < n; i++) {
+    e = &exn_ring[(count - 1 - i) & (EXN_RING_SIZE - 1)];
+    name = exn_ring_name(e);
+    fprintf(stderr, "%s\n", name != NULL ? name : "_");
+    d = exn_ring_frame(e);
+    if (d != NULL) {
+      extract_location_info(d, &li);
+      print_location(&li, 0);
+    }
+  }
+}
+
+/* Start or stop the exception ring */
+
+CAMLprim value caml_exn_ring_set_active(value vflag)
+{
+  caml_exn_ring_active = Int_val(vflag);
+  caml_backtrace_active = caml_backtrace_requested || caml_exn_ring_active;
+  return Val_unit;
+}
+
+CAMLprim value caml_exn_ring_status(value vunit)
+{
+  return Val_bool(caml_exn_ring_active);
+}
+
+/* Number of exceptions recorded in the ring since startup */
+
+CAMLprim value caml_exn_ring_count(value vunit)
+{
+  return Val_long(exn_ring_count);
+}
+
+/* Return the entries of the ring, most recent first, as an array of
+   pairs of the exception name and its frames as a raw backtrace. */
+
+CAMLprim value caml_exn_ring_entries(value vunit)
+{
+  CAMLparam0();
+  CAMLlocal4(res, entry, name, frames);
+  uintnat count = exn_ring_count, i, n;
+  struct exn_ring_entry * e;
+  frame_descr * d;
+  char * s;
+
+  n = count < EXN_RING_SIZE ? count : EXN_RING_SIZE;
+  res = caml_alloc(n, 0);
+  for (i = 0; i < n; i++) {
+    e = &exn_ring[(count - 1 - i) & (EXN_RING_SIZE - 1)];
+    s = exn_ring_name(e);
+    name = caml_copy_string(s != NULL ? s : "_");
+    d = exn_ring_frame(e);
+    frames = caml_alloc(d != NULL, Abstract_tag);
+    if (d != NULL) Field(frames, 0) = (value) d;
+    entry = caml_alloc_small(2, 0);
+    Field(entry, 0) = name;
+    Field(entry, 1) = frames;
+    caml_modify(&Field(res, i), entry);
+  }
+  CAMLreturn(res);
+}
+
 /* Convert the raw backtrace to a data structure usable from OCaml */
 
 CAMLprim value caml_convert_raw_backtrace(value backtrace) {
@@ -16,7 +16,12 @@
 
 #include "mlvalues.h"
 
+/* [caml_backtrace_active] is set when raising must call the stasher:
+   when [Printexc.record_backtrace] asked for full backtraces
+   ([caml_backtrace_requested]) or when the exception ring is on. */
 CAMLextern int caml_backtrace_active;
+CAMLextern int caml_backtrace_requested;
+CAMLextern int caml_exn_ring_active;
 CAMLextern int caml_backtrace_pos;
 CAMLextern code_t * caml_backtrace_buffer;
 CAMLextern value caml_backtrace_last_exn;
@@ -27,5 +32,6 @@ CAMLprim value caml_record_backtrace(value vflag);
 extern void caml_stash_backtrace(value exn, code_t pc, value * sp);
 #endif
 CAMLextern void caml_print_exception_backtrace(void);
+CAMLextern void caml_print_exn_ring(void);
 
 #endif /* CAML_BACKTRACE_H */
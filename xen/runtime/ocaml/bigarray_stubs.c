@@ -125,14 +125,13 @@ caml_ba_multov(uintnat a, uintnat b, int * overflow)
 /* 1 Gb -- after allocating that much, it's probably worth speeding
    up the major GC */
 
-/* [caml_ba_alloc] will allocate a new bigarray object in the heap.
-   If [data] is NULL, the memory for the contents is also allocated
-   (with [malloc]) by [caml_ba_alloc].
-   [data] cannot point into the OCaml heap.
-   [dim] may point into an object in the OCaml heap.
-*/
-CAMLexport value
-caml_ba_alloc(int flags, int num_dims, void * data, intnat * dim)
+/* Allocate a bigarray object.  If [view] is false and the data is
+   managed, it is counted as external memory (see memory.c) until the
+   finaliser frees it.  Views on the data of another bigarray (slices,
+   sub-arrays, reshapes) share its proxy and are not counted again. */
+static value
+caml_ba_alloc_gen(int flags, int num_dims, void * data, intnat * dim,
+                  int view)
 {
   uintnat num_elts, asize, size;
   int overflow, i;
@@ -143,23 +142,25 @@ caml_ba_alloc(int flags, int num_dims, void * data, intnat * dim)
   Assert(num_dims >= 1 && num_dims <= CAML_BA_MAX_NUM_DIMS);
   Assert((flags & CAML_BA_KIND_MASK) <= CAML_BA_COMPLEX64);
   for (i = 0; i < num_dims; i++) dimcopy[i] = dim[i];
-  size = 0;
+  overflow = 0;
+  num_elts = 1;
+  for (i = 0; i < num_dims; i++) {
+    num_elts = caml_ba_multov(num_elts, dimcopy[i], &overflow);
+  }
+  size = caml_ba_multov(num_elts,
+                        caml_ba_element_size[flags & CAML_BA_KIND_MASK],
+                        &overflow);
   if (data == NULL) {
-    overflow = 0;
-    num_elts = 1;
-    for (i = 0; i < num_dims; i++) {
-      num_elts = caml_ba_multov(num_elts, dimcopy[i], &overflow);
-    }
-    size = caml_ba_multov(num_elts,
-                          caml_ba_element_size[flags & CAML_BA_KIND_MASK],
-                          &overflow);
     if (overflow) caml_raise_out_of_memory();
     data = malloc(size);
     if (data == NULL && size != 0) caml_raise_out_of_memory();
     flags |= CAML_BA_MANAGED;
   }
   asize = SIZEOF_BA_ARRAY + num_dims * sizeof(intnat);
-  res = caml_alloc_custom(&caml_ba_ops, asize, size, CAML_BA_MAX_MEMORY);
+  if (!view && (flags & CAML_BA_MANAGED_MASK) == CAML_BA_MANAGED)
+    res = caml_alloc_custom_external(&caml_ba_ops, asize, size);
+  else
+    res = caml_alloc_custom(&caml_ba_ops, asize, 0, CAML_BA_MAX_MEMORY);
   b = Caml_ba_array_val(res);
   b->data = data;
   b->num_dims = num_dims;
@@ -169,6 +170,20 @@ caml_ba_alloc(int flags, int num_dims, void * data, intnat * dim)
   return res;
 }
 
+/* [caml_ba_alloc] will allocate a new bigarray object in the heap.
+   If [data] is NULL, the memory for the contents is also allocated
+   (with [malloc]) by [caml_ba_alloc].
+   [data] cannot point into the OCaml heap.
+   [dim] may point into an object in the OCaml heap.
+   If [flags] contains [CAML_BA_MANAGED], the data is counted as
+   external memory, so that the GC runs often enough to free it.
+*/
+CAMLexport value
+caml_ba_alloc(int flags, int num_dims, void * data, intnat * dim)
+{
+  return caml_ba_alloc_gen(flags, num_dims, data, dim, 0);
+}
+
 /* Same as caml_ba_alloc, but dimensions are passed as a list of
    arguments */
 
@@ -659,6 +674,37 @@ CAMLprim value caml_ba_layout(value vb)
   return Val_int(Caml_ba_array_val(vb)->flags & CAML_BA_LAYOUT_MASK);
 }
 
+/* Proxies.  Slicing the I/O pages of a packet creates and frees one
+   proxy per page, so freed proxies are kept on a free list, linked
+   through their [data] field, and reused instead of going back to
+   [malloc]. */
+
+#define Max_free_proxies 256
+
+static struct caml_ba_proxy * caml_ba_free_proxies = NULL;
+static int caml_ba_num_free_proxies = 0;
+
+static struct caml_ba_proxy * caml_ba_alloc_proxy(void)
+{
+  struct caml_ba_proxy * proxy = caml_ba_free_proxies;
+
+  if (proxy == NULL) return caml_stat_alloc(sizeof(struct caml_ba_proxy));
+  caml_ba_free_proxies = proxy->data;
+  caml_ba_num_free_proxies--;
+  return proxy;
+}
+
+static void caml_ba_free_proxy(struct caml_ba_proxy * proxy)
+{
+  if (caml_ba_num_free_proxies >= Max_free_proxies) {
+    caml_stat_free(proxy);
+    return;
+  }
+  proxy->data = caml_ba_free_proxies;
+  caml_ba_free_proxies = proxy;
+  caml_ba_num_free_proxies++;
+}
+
 /* Finalization of a big array */
 
 static void caml_ba_finalize(value v)
@@ -671,10 +717,12 @@ static void caml_ba_finalize(value v)
   case CAML_BA_MANAGED:
     if (b->proxy == NULL) {
       free(b->data);
+      caml_free_external_memory(caml_ba_byte_size(b));
     } else {
       if (-- b->proxy->refcount == 0) {
         free(b->proxy->data);
-        caml_stat_free(b->proxy);
+        caml_free_external_memory(b->proxy->size);
+        caml_ba_free_proxy(b->proxy);
       }
     }
     break;
@@ -684,7 +732,7 @@ static void caml_ba_finalize(value v)
     } else {
       if (-- b->proxy->refcount == 0) {
         caml_ba_unmap_file(b->proxy->data, b->proxy->size);
-        caml_stat_free(b->proxy);
+        caml_ba_free_proxy(b->proxy);
       }
     }
     break;
@@ -699,6 +747,7 @@ static int caml_ba_compare(value v1, value v2)
   struct caml_ba_array * b2 = Caml_ba_array_val(v2);
   uintnat n, num_elts;
   intnat flags1, flags2;
+  char * data1 = b1->data, * data2 = b2->data;
   int i;
 
   /* Compare kind & layout in case the arguments are of different types */
@@ -715,9 +764,28 @@ static int caml_ba_compare(value v1, value v2)
   }
   /* Same dimensions: compare contents lexicographically */
   num_elts = caml_ba_num_elts(b1);
+  /* Skip the common prefix a word at a time.  For bytes this is the
+     whole comparison; for other integers the first element that differs
+     is compared as below.  Floats are compared element-wise since equal
+     floats need not have the same bytes (0.0 and -0.0, NaNs). */
+  switch (b1->flags & CAML_BA_KIND_MASK) {
+  case CAML_BA_FLOAT32: case CAML_BA_FLOAT64:
+  case CAML_BA_COMPLEX32: case CAML_BA_COMPLEX64:
+    break;
+  case CAML_BA_UINT8:
+    return caml_bytes_compare(data1, data2, num_elts);
+  default: {
+    uintnat size = caml_ba_element_size[b1->flags & CAML_BA_KIND_MASK];
+    n = caml_bytes_mismatch(data1, data2, num_elts * size) / size;
+    if (n == num_elts) return 0;
+    data1 += n * size;
+    data2 += n * size;
+    num_elts -= n;
+  }
+  }
 
 #define DO_INTEGER_COMPARISON(type) \
-  { type * p1 = b1->data; type * p2 = b2->data; \
+  { type * p1 = (type *) data1; type * p2 = (type *) data2; \
     for (n = 0; n < num_elts; n++) { \
       type e1 = *p1++; type e2 = *p2++; \
       if (e1 < e2) return -1; \
@@ -726,7 +794,7 @@ static int caml_ba_compare(value v1, value v2)
     return 0; \
   }
 #define DO_FLOAT_COMPARISON(type) \
-  { type * p1 = b1->data; type * p2 = b2->data; \
+  { type * p1 = (type *) data1; type * p2 = (type *) data2; \
     for (n = 0; n < num_elts; n++) { \
       type e1 = *p1++; type e2 = *p2++; \
       if (e1 < e2) return -1; \
@@ -763,7 +831,7 @@ static int caml_ba_compare(value v1, value v2)
 #ifdef ARCH_INT64_TYPE
     DO_INTEGER_COMPARISON(int64);
 #else
-    { int64 * p1 = b1->data; int64 * p2 = b2->data;
+    { int64 * p1 = (int64 *) data1; int64 * p2 = (int64 *) data2;
       for (n = 0; n < num_elts; n++) {
         int64 e1 = *p1++; int64 e2 = *p2++;
         if ((int32)e1.h > (int32)e2.h) return 1;
@@ -987,6 +1055,7 @@ uintnat caml_ba_deserialize(void * dst)
   b->data = malloc(elt_size * num_elts);
   if (b->data == NULL)
     caml_deserialize_error("input_value: out of memory for bigarray");
+  caml_alloc_external_memory(elt_size * num_elts);
   /* Read data */
   switch (b->flags & CAML_BA_KIND_MASK) {
   case CAML_BA_SINT8:
@@ -1028,11 +1097,10 @@ static void caml_ba_update_proxy(struct caml_ba_array * b1,
     ++ b1->proxy->refcount;
   } else {
     /* Otherwise, create proxy and attach it to both b1 and b2 */
-    proxy = caml_stat_alloc(sizeof(struct caml_ba_proxy));
+    proxy = caml_ba_alloc_proxy();
     proxy->refcount = 2;      /* original array + sub array */
     proxy->data = b1->data;
-    proxy->size =
-      b1->flags & CAML_BA_MAPPED_FILE ? caml_ba_byte_size(b1) : 0;
+    proxy->size = caml_ba_byte_size(b1);
     b1->proxy = proxy;
     b2->proxy = proxy;
   }
@@ -1074,7 +1142,8 @@ CAMLprim value caml_ba_slice(value vb, value vind)
     (char *) b->data +
     offset * caml_ba_element_size[b->flags & CAML_BA_KIND_MASK];
   /* Allocate an OCaml bigarray to hold the result */
-  res = caml_ba_alloc(b->flags, b->num_dims - num_inds, sub_data, sub_dims);
+  res = caml_ba_alloc_gen(b->flags, b->num_dims - num_inds, sub_data,
+                          sub_dims, 1);
   /* Create or update proxy in case of managed bigarray */
   caml_ba_update_proxy(b, Caml_ba_array_val(res));
   /* Return result */
@@ -1096,6 +1165,17 @@ CAMLprim value caml_ba_sub(value vb, value vofs, value vlen)
   intnat mul;
   char * sub_data;
 
+  if (b->num_dims == 1) {
+    /* Fast path for vectors, which is how I/O buffers are sliced */
+    if ((b->flags & CAML_BA_LAYOUT_MASK) == CAML_BA_FORTRAN_LAYOUT) ofs--;
+    if (ofs < 0 || len < 0 || ofs + len > b->dim[0])
+      caml_invalid_argument("Bigarray.sub: bad sub-array");
+    sub_data = (char *) b->data
+               + ofs * caml_ba_element_size[b->flags & CAML_BA_KIND_MASK];
+    res = caml_ba_alloc_gen(b->flags, 1, sub_data, &len, 1);
+    caml_ba_update_proxy(b, Caml_ba_array_val(res));
+    CAMLreturn (res);
+  }
   /* Compute offset and check bounds */
   if ((b->flags & CAML_BA_LAYOUT_MASK) == CAML_BA_C_LAYOUT) {
     /* We reduce the first dimension */
@@ -1115,7 +1195,7 @@ CAMLprim value caml_ba_sub(value vb, value vofs, value vlen)
     (char *) b->data +
     ofs * mul * caml_ba_element_size[b->flags & CAML_BA_KIND_MASK];
   /* Allocate an OCaml bigarray to hold the result */
-  res = caml_ba_alloc(b->flags, b->num_dims, sub_data, b->dim);
+  res = caml_ba_alloc_gen(b->flags, b->num_dims, sub_data, b->dim, 1);
   /* Doctor the changed dimension */
   Caml_ba_array_val(res)->dim[changed_dim] = len;
   /* Create or update proxy in case of managed bigarray */
@@ -1135,6 +1215,14 @@ CAMLprim value caml_ba_blit(value vsrc, value vdst)
   int i;
   intnat num_bytes;
 
+  if (src->num_dims == 1 && dst->num_dims == 1) {
+    /* Fast path for vectors */
+    if (src->dim[0] != dst->dim[0]) goto blit_error;
+    num_bytes =
+      src->dim[0] * caml_ba_element_size[src->flags & CAML_BA_KIND_MASK];
+    memmove (dst->data, src->data, num_bytes);
+    return Val_unit;
+  }
   /* Check same numbers of dimensions and same dimensions */
   if (src->num_dims != dst->num_dims) goto blit_error;
   for (i = 0; i < src->num_dims; i++)
@@ -1175,39 +1263,42 @@ CAMLprim value caml_ba_fill(value vb, value vinit)
   }
   case CAML_BA_SINT8:
   case CAML_BA_UINT8: {
-    int init = Int_val(vinit);
-    char * p;
-    for (p = b->data; num_elts > 0; p++, num_elts--) *p = init;
+    memset(b->data, Int_val(vinit), num_elts);
     break;
   }
   case CAML_BA_SINT16:
   case CAML_BA_UINT16: {
     int init = Int_val(vinit);
     int16 * p;
+    if ((int16) init == 0) { memset(b->data, 0, num_elts * 2); break; }
     for (p = b->data; num_elts > 0; p++, num_elts--) *p = init;
     break;
   }
   case CAML_BA_INT32: {
     int32 init = Int32_val(vinit);
     int32 * p;
+    if (init == 0) { memset(b->data, 0, num_elts * 4); break; }
     for (p = b->data; num_elts > 0; p++, num_elts--) *p = init;
     break;
   }
   case CAML_BA_INT64: {
     int64 init = Int64_val(vinit);
     int64 * p;
+    if (init == 0) { memset(b->data, 0, num_elts * 8); break; }
     for (p = b->data; num_elts > 0; p++, num_elts--) *p = init;
     break;
   }
   case CAML_BA_NATIVE_INT: {
     intnat init = Nativeint_val(vinit);
     intnat * p;
+    if (init == 0) { memset(b->data, 0, num_elts * sizeof(intnat)); break; }
     for (p = b->data; num_elts > 0; p++, num_elts--) *p = init;
     break;
   }
   case CAML_BA_CAML_INT: {
     intnat init = Long_val(vinit);
     intnat * p;
+    if (init == 0) { memset(b->data, 0, num_elts * sizeof(intnat)); break; }
     for (p = b->data; num_elts > 0; p++, num_elts--) *p = init;
     break;
   }
@@ -1256,7 +1347,7 @@ CAMLprim value caml_ba_reshape(value vb, value vdim)
   if (num_elts != caml_ba_num_elts(b))
     caml_invalid_argument("Bigarray.reshape: size mismatch");
   /* Create bigarray with same data and new dimensions */
-  res = caml_ba_alloc(b->flags, num_dims, b->data, dim);
+  res = caml_ba_alloc_gen(b->flags, num_dims, b->data, dim, 1);
   /* Create or update proxy in case of managed bigarray */
   caml_ba_update_proxy(b, Caml_ba_array_val(res));
   /* Return result */
@@ -11,15 +11,20 @@
 /*                                                                     */
 /***********************************************************************/
 
+#include <stdlib.h>
 #include <string.h>
 
+#include "compact.h"
 #include "config.h"
+#include "custom.h"
 #include "finalise.h"
 #include "freelist.h"
 #include "gc.h"
 #include "gc_ctrl.h"
+#include "gc_events.h"
 #include "major_gc.h"
 #include "memory.h"
+#include "memprof.h"
 #include "mlvalues.h"
 #include "roots.h"
 #include "weak.h"
@@ -110,6 +115,86 @@ static void invert_root (value v, value *p)
   invert_pointer_at ((word *) p);
 }
 
+/* Invert the fields of the weak arrays (or ephemerons) linked from
+   [*head], then the links themselves. */
+static void invert_weak_list (value *head)
+{
+  value *pp = head;
+  value p;
+  word q;
+  size_t sz, i;
+
+  while (1){
+    p = *pp;
+    if (p == (value) NULL) break;
+    q = Hd_val (p);
+    while (Ecolor (q) == 0) q = * (word *) q;
+    sz = Wosize_ehd (q);
+    for (i = 1; i < sz; i++){
+      if (Field (p,i) != caml_weak_none){
+        invert_pointer_at ((word *) &(Field (p,i)));
+      }
+    }
+    invert_pointer_at ((word *) pp);
+    pp = &Field (p, 0);
+  }
+}
+
+/* Large chunks (see [memory.c]) are not compacted: they are taken out
+   of the heap while the other chunks are compacted, so that pointers to
+   their blocks are left alone, and the fields of their blocks are
+   treated as roots. */
+static char *large_chunks;
+
+static void detach_large_chunks (void)
+{
+  char **cp = &caml_heap_start, **last = &large_chunks, *ch;
+
+  while ((ch = *cp) != NULL){
+    if (Chunk_large (ch)){
+      *cp = Chunk_next (ch);
+      caml_page_table_remove (In_heap, ch, ch + Chunk_size (ch));
+      *last = ch;
+      last = &Chunk_next (ch);
+    }else{
+      cp = &Chunk_next (ch);
+    }
+  }
+  *last = NULL;
+}
+
+static void attach_large_chunks (void)
+{
+  char **cp = &caml_heap_start, *ch;
+
+  while (large_chunks != NULL){
+    ch = large_chunks;
+    large_chunks = Chunk_next (ch);
+    if (caml_page_table_add (In_heap, ch, ch + Chunk_size (ch)) != 0){
+      caml_fatal_error ("Fatal error: cannot restore a large chunk.\n");
+    }
+    while (*cp != NULL && *cp < ch) cp = &Chunk_next (*cp);
+    Chunk_next (ch) = *cp;
+    *cp = ch;
+  }
+}
+
+static void invert_large_roots (void)
+{
+  char *ch;
+  value v;
+  mlsize_t i;
+
+  for (ch = large_chunks; ch != NULL; ch = Chunk_next (ch)){
+    v = Val_hp (ch);
+    if (Tag_val (v) < No_scan_tag){
+      for (i = 0; i < Wosize_val (v); i++){
+        invert_pointer_at ((word *) &Field (v, i));
+      }
+    }
+  }
+}
+
 static char *compact_fl;
 
 static void init_compact_allocate (void)
@@ -152,6 +237,13 @@ static void do_compaction (void)
   caml_heap_check ();
 #endif
 
+  detach_large_chunks ();
+  if (caml_heap_start == NULL){
+    /* Nothing but large blocks: nothing to compact. */
+    attach_large_chunks ();
+    return;
+  }
+
   /* First pass: encode all noninfix headers. */
   {
     ch = caml_heap_start;
@@ -186,6 +278,7 @@ static void do_compaction (void)
        the headers (see above). */
     caml_do_roots (invert_root);
     caml_final_do_weak_roots (invert_root);
+    invert_large_roots ();
 
     ch = caml_heap_start;
     while (ch != NULL){
@@ -218,28 +311,9 @@ static void do_compaction (void)
       }
       ch = Chunk_next (ch);
     }
-    /* Invert weak pointers. */
-    {
-      value *pp = &caml_weak_list_head;
-      value p;
-      word q;
-      size_t sz, i;
-
-      while (1){
-        p = *pp;
-        if (p == (value) NULL) break;
-        q = Hd_val (p);
-        while (Ecolor (q) == 0) q = * (word *) q;
-        sz = Wosize_ehd (q);
-        for (i = 1; i < sz; i++){
-          if (Field (p,i) != caml_weak_none){
-            invert_pointer_at ((word *) &(Field (p,i)));
-          }
-        }
-        invert_pointer_at ((word *) pp);
-        pp = &Field (p, 0);
-      }
-    }
+    /* Invert weak pointers and ephemerons. */
+    invert_weak_list (&caml_weak_list_head);
+    invert_weak_list (&caml_ephe_list_head);
   }
 
 
@@ -380,6 +454,7 @@ static void do_compaction (void)
     ch = caml_heap_start;
     caml_fl_reset ();
     while (ch != NULL){
+      Chunk_evac (ch) = Evac_none;
       if (Chunk_size (ch) > Chunk_alloc (ch)){
         caml_make_free_blocks ((value *) (ch + Chunk_alloc (ch)),
                                Wsize_bsize (Chunk_size(ch)-Chunk_alloc(ch)), 1,
@@ -388,16 +463,18 @@ static void do_compaction (void)
       ch = Chunk_next (ch);
     }
   }
+  attach_large_chunks ();
   ++ caml_stat_compactions;
   caml_gc_message (0x10, "done.\n", 0);
 }
 
 uintnat caml_percent_max;  /* used in gc_ctrl.c and memory.c */
 
-void caml_compact_heap (void)
+static void compact_heap (void)
 {
   uintnat target_words, target_size, live;
 
+  caml_memprof_forget_major ();
   do_compaction ();
   /* Compaction may fail to shrink the heap to a reasonable size
      because it deals in complete chunks: if a very large chunk
@@ -424,11 +501,12 @@ void caml_compact_heap (void)
 
      We recompact if target_size < heap_size / 2
   */
-  live = Wsize_bsize (caml_stat_heap_size) - caml_fl_cur_size;
+  live = Wsize_bsize (caml_stat_heap_size - caml_large_bytes)
+         - caml_fl_cur_size;
   target_words = live + caml_percent_free * (live / 100 + 1)
                  + Wsize_bsize (Page_size);
   target_size = caml_round_heap_chunk_size (Bsize_wsize (target_words));
-  if (target_size < caml_stat_heap_size / 2){
+  if (target_size < (caml_stat_heap_size - caml_large_bytes) / 2){
     char *chunk;
 
     caml_gc_message (0x10, "Recompacting heap (target=%luk)\n",
@@ -452,10 +530,442 @@ void caml_compact_heap (void)
       caml_stat_top_heap_size = caml_stat_heap_size;
     }
     do_compaction ();
-    Assert (caml_stat_heap_chunks == 1);
-    Assert (Chunk_next (caml_heap_start) == NULL);
-    Assert (caml_stat_heap_size == Chunk_size (chunk));
+    Assert (caml_stat_heap_chunks == 1 + caml_large_chunks);
+    Assert (caml_stat_heap_size == Chunk_size (chunk) + caml_large_bytes);
+  }
+}
+
+void caml_compact_heap (void)
+{
+  uint64_t start = caml_gc_clock ();
+
+  compact_heap ();
+  caml_gc_event (Gc_ev_compaction, start, Wsize_bsize (caml_stat_heap_size));
+}
+
+/* Incremental evacuation of sparse chunks.
+
+   At the end of each major cycle, the chunks whose live data is less
+   than [caml_percent_evacuate] percent of their size are selected by
+   [caml_evac_select].  The next sweep retires them: their free blocks
+   are taken out of the free list, so that nothing new is allocated in
+   them, and a retired chunk found empty is given back at once (see
+   [sweep_enter_chunk] in major_gc.c).
+
+   The cycle after that evacuates the retired chunks.  From its start
+   ([caml_evac_begin]), every pointer into them that is stored in the
+   major heap is recorded in a buffer of slots per chunk: the marking
+   records the fields of the live blocks, the write barrier and the
+   minor GC record the later stores (see [Evac_record]).  When marking
+   is done, the major GC enters [Phase_evacuate].  Each of its slices
+   ([caml_evac_slice]) moves live blocks out of the chunks, in address
+   order, until [caml_evacuation_pause] microseconds have passed.  A
+   moved block is left gray, with the address of its copy in its first
+   field.  Before the slice returns, the recorded slots, the roots and
+   the fields of the copies that point to moved blocks are updated, so
+   that the mutator never sees a moved block, and the chunks whose live
+   blocks have all been moved are given back.  The sweep starts when no
+   chunk is left.
+
+   Every slice is done with an empty minor heap, so no young block
+   points into the chunks.  The fields of the abstract blocks are not
+   scanned when they are copied, except for the weak arrays and
+   ephemerons found in the chunks by [Subphase_weak2]
+   ([caml_evac_weak]).
+
+   A chunk is put back in service instead, and rests for [Evac_rest]
+   cycles, if its buffers cannot grow, if a copy cannot be allocated,
+   or if it holds a live block of size 0, which has no room for the
+   address of its copy.
+*/
+uintnat caml_percent_evacuate = 0;    /* 0 disables the evacuation */
+uintnat caml_evacuation_pause = 1000; /* microseconds per slice */
+char *caml_evac_start = NULL, *caml_evac_end = NULL;
+
+#define Evac_rest 4
+#define Evac_buffer_init 256
+#define Evac_check_words 1024  /* words moved between two clock reads */
+
+struct evac_chunk {
+  char *chunk, *end;
+  char *scan;           /* the blocks below [scan] have been moved */
+  int cancel;           /* put the chunk back in service */
+  uintnat *slots;       /* bit 0 set: the slot is in a chunk of the table */
+  uintnat num_slots, max_slots;
+  value *weak;          /* weak arrays and ephemerons of the chunk */
+  uintnat num_weak, max_weak, next_weak;
+};
+
+static struct evac_chunk *evac_chunks = NULL;  /* sorted by address */
+static uintnat evac_num = 0;
+static uintnat evac_cur = 0;       /* the first chunk not done yet */
+
+void caml_evac_select (void)
+{
+  char *ch, *best;
+  uintnat chunk_words, taken = 0, budget;
+
+                                          Assert (caml_gc_phase == Phase_idle);
+  if (caml_percent_evacuate == 0) return;
+  /* The free blocks of the selected chunks leave the free list, and the
+     copies of their live blocks are allocated from it: take at most
+     half of the free words. */
+  for (ch = caml_heap_start; ch != NULL; ch = Chunk_next (ch)){
+    if (Chunk_evac (ch) > Evac_none) taken += Wsize_bsize (Chunk_size (ch));
+  }
+  budget = caml_fl_cur_size / 2;
+  if (budget <= taken) return;
+  budget -= taken;
+
+  while (1){
+    /* Take the sparsest chunk that fits in the budget.  The first chunk
+       is never freed (see [caml_shrink_heap]), so it is not selected. */
+    best = NULL;
+    for (ch = Chunk_next (caml_heap_start); ch != NULL; ch = Chunk_next (ch)){
+      chunk_words = Wsize_bsize (Chunk_size (ch));
+      if (Chunk_evac (ch) != Evac_none || Chunk_large (ch)) continue;
+      if (Chunk_live (ch) >= chunk_words / 100 * caml_percent_evacuate){
+        continue;
+      }
+      if (chunk_words > budget) continue;
+      if (best == NULL || (double) Chunk_live (ch) / chunk_words
+                          < (double) Chunk_live (best)
+                            / Wsize_bsize (Chunk_size (best))){
+        best = ch;
+      }
+    }
+    if (best == NULL) break;
+    caml_gc_message (0x04, "Selecting heap chunk for evacuation "
+                     "(%luk live bytes)\n",
+                     Bsize_wsize (Chunk_live (best)) / 1024);
+    Chunk_evac (best) = Evac_pending;
+    budget -= Wsize_bsize (Chunk_size (best));
+  }
+}
+
+/* The chunk of the table that contains [p]. */
+static struct evac_chunk *find_evac_chunk (char *p)
+{
+  uintnat lo = 0, hi = evac_num, mid;
+
+  while (hi - lo > 1){
+    mid = (lo + hi) / 2;
+    if (evac_chunks[mid].chunk <= p) lo = mid; else hi = mid;
+  }
+  Assert (p >= evac_chunks[lo].chunk && p < evac_chunks[lo].end);
+  return &evac_chunks[lo];
+}
+
+/* Make room for one more entry of [size] bytes in [buf], which has room
+   for [*max]; return NULL if that would take more than [limit] entries
+   or if there is no memory. */
+static void *grow_buffer (void *buf, uintnat *max, uintnat limit, size_t size)
+{
+  uintnat n = *max == 0 ? Evac_buffer_init : 2 * *max;
+  void *new;
+
+  if (n > limit) return NULL;
+  new = realloc (buf, n * size);
+  if (new != NULL) *max = n;
+  return new;
+}
+
+/* At most one slot for 8 words of the chunk. */
+#define Max_evac_slots(c) (Wsize_bsize ((c)->end - (c)->chunk) / 8)
+
+/* The slot [fp] points to [v], which is in a chunk being evacuated.
+   Called by [Evac_record]. */
+void caml_evac_record (value *fp, value v)
+{
+  struct evac_chunk *c;
+  uintnat e, *slots;
+
+  if (!Is_in_heap (fp)) return;     /* roots are updated anyway */
+  c = find_evac_chunk ((char *) v);
+  if (c->cancel) return;
+  e = (uintnat) fp | (Is_evacuating (fp) ? 1 : 0);
+  if (c->num_slots > 0 && c->slots[c->num_slots - 1] == e) return;
+  if (c->num_slots == c->max_slots){
+    slots = grow_buffer (c->slots, &c->max_slots, Max_evac_slots (c),
+                         sizeof (uintnat));
+    if (slots == NULL){
+      caml_gc_message (0x04, "Evacuation slot buffer overflow\n", 0);
+      c->cancel = 1;
+      return;
+    }
+    c->slots = slots;
+  }
+  c->slots[c->num_slots++] = e;
+}
+
+/* [v] is a live weak array or ephemeron in a chunk being evacuated. */
+void caml_evac_weak (value v)
+{
+  struct evac_chunk *c = find_evac_chunk ((char *) v);
+  value *weak;
+
+  if (c->cancel) return;
+  if (c->num_weak == c->max_weak){
+    weak = grow_buffer (c->weak, &c->max_weak, Max_evac_slots (c),
+                        sizeof (value));
+    if (weak == NULL){
+      c->cancel = 1;
+      return;
+    }
+    c->weak = weak;
+  }
+  c->weak[c->num_weak++] = v;
+}
+
+/* Put the chunk [c] back in service.  Below [c->scan], the blocks that
+   were moved and the dead blocks, whose finalisers have run, become
+   white and abstract, i.e. free for the sweep; the free blocks become
+   white too, so that the sweep gives them back to the free list. */
+static void restore_chunk (struct evac_chunk *c)
+{
+  char *hp;
+  header_t hd;
+
+  caml_gc_message (0x04, "Heap chunk put back in service\n", 0);
+  for (hp = c->chunk; hp < c->end; hp += Bhsize_hd (hd)){
+    hd = Hd_hp (hp);
+    if (hp < c->scan ? Color_hd (hd) != Caml_black
+                     : Color_hd (hd) == Caml_blue){
+      Hd_hp (hp) = Make_header (Wosize_hd (hd), Abstract_tag, Caml_white);
+    }
+  }
+  caml_page_table_remove (In_evacuation, c->chunk, c->end);
+  Chunk_evac (c->chunk) = - Evac_rest;
+}
+
+static int compare_chunks (const void *a, const void *b)
+{
+  char *x = ((const struct evac_chunk *) a)->chunk;
+  char *y = ((const struct evac_chunk *) b)->chunk;
+
+  return x < y ? -1 : x > y;
+}
+
+static int compare_values (const void *a, const void *b)
+{
+  value x = *(const value *) a, y = *(const value *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Called at the start of a major cycle: the retired chunks are to be
+   evacuated during this cycle. */
+void caml_evac_begin (void)
+{
+  struct evac_chunk c;
+  uintnat n = 0;
+  char *ch;
+
+  Assert (evac_num == 0);
+  for (ch = caml_heap_start; ch != NULL; ch = Chunk_next (ch)){
+    if (Chunk_evac (ch) == Evac_retired) ++ n;
+  }
+  if (n == 0) return;
+  evac_chunks = (struct evac_chunk *) malloc (n * sizeof (c));
+  for (ch = caml_heap_start; ch != NULL; ch = Chunk_next (ch)){
+    if (Chunk_evac (ch) != Evac_retired) continue;
+    memset (&c, 0, sizeof (c));
+    c.chunk = c.scan = ch;
+    c.end = ch + Chunk_size (ch);
+    if (evac_chunks == NULL || ch == caml_heap_start
+        || caml_page_table_add (In_evacuation, c.chunk, c.end) != 0){
+      restore_chunk (&c);
+    }else{
+      evac_chunks[evac_num++] = c;
+    }
+  }
+  if (evac_num == 0){
+    free (evac_chunks);
+    evac_chunks = NULL;
+    return;
+  }
+  qsort (evac_chunks, evac_num, sizeof (c), compare_chunks);
+  evac_cur = 0;
+  caml_evac_start = evac_chunks[0].chunk;
+  caml_evac_end = evac_chunks[evac_num - 1].end;
+  caml_gc_message (0x04, "Evacuating %lu heap chunks\n", evac_num);
+}
+
+/* The new address of [v] if its block has been moved, else 0. */
+static value forwarded (value v)
+{
+  value b = v;
+
+  if (Tag_val (v) == Infix_tag) b -= Infix_offset_val (v);
+  return Is_gray_val (b) ? Field (b, 0) + (v - b) : 0;
+}
+
+static void fix_root (value v, value *p)
+{
+  value nv;
+
+  if (Is_block (v) && Is_evacuating (v)){
+    nv = forwarded (v);
+    if (nv != 0) *p = nv;
+  }
+}
+
+/* [*fp] is a field of a copy: update it if it points to a moved block,
+   or record it if it points to a block that is still to be moved. */
+static void fix_copied_field (value *fp)
+{
+  value v = *fp, nv;
+
+  if (Is_block (v) && Is_evacuating (v)){
+    nv = forwarded (v);
+    if (nv != 0) *fp = nv; else caml_evac_record (fp, v);
+  }
+}
+
+/* Update the slots of [c] that point to moved blocks, and keep those
+   that point to blocks still to be moved. */
+static void fix_slots (struct evac_chunk *c)
+{
+  uintnat i, n = 0, e;
+  value *fp, v, nv;
+
+  for (i = 0; i < c->num_slots; i++){
+    e = c->slots[i];
+    fp = (value *) (e & ~ (uintnat) 1);
+    /* A slot of a moved or dead block: the copy was scanned instead. */
+    if ((e & 1) && (char *) fp < find_evac_chunk ((char *) fp)->scan){
+      continue;
+    }
+    v = *fp;
+    /* Drop the slots that were overwritten since. */
+    if (!Is_block (v) || (char *) v < c->chunk || (char *) v >= c->end){
+      continue;
+    }
+    nv = forwarded (v);
+    if (nv != 0){
+      *fp = nv;
+    }else{
+      c->slots[n++] = e;
+    }
+  }
+  c->num_slots = n;
+}
+
+/* Move the live blocks of [c] from [c->scan] on, until [deadline] (0 for
+   no limit), and add the words moved to [*words].  Return 0 if the
+   chunk is done, 1 if the time is up, and -1 if a block cannot be
+   moved. */
+static int move_blocks (struct evac_chunk *c, uint64_t deadline,
+                        uintnat *words)
+{
+  char *hp;
+  header_t hd;
+  value v, nv;
+  mlsize_t sz, i;
+  uintnat unchecked = 0;
+  int weak;
+
+  if (c->scan == c->chunk && c->num_weak > 1){
+    qsort (c->weak, c->num_weak, sizeof (value), compare_values);
+  }
+  while (c->scan < c->end){
+    if (deadline != 0 && unchecked >= Evac_check_words){
+      if (caml_gc_clock () >= deadline) return 1;
+      unchecked = 0;
+    }
+    hp = c->scan;
+    hd = Hd_hp (hp);
+    v = Val_hp (hp);
+    sz = Wosize_hd (hd);
+    unchecked += Whsize_hd (hd);
+    if (Color_hd (hd) == Caml_black){
+      if (sz == 0) return -1;
+      nv = caml_alloc_shr_for_evacuation (sz, Tag_hd (hd));
+      if (nv == 0) return -1;
+      memcpy (Op_val (nv), Op_val (v), Bsize_wsize (sz));
+      while (c->next_weak < c->num_weak && c->weak[c->next_weak] < v){
+        ++ c->next_weak;
+      }
+      weak = c->next_weak < c->num_weak && c->weak[c->next_weak] == v;
+      if (Tag_hd (hd) < No_scan_tag || weak){
+        for (i = 0; i < sz; i++) fix_copied_field (&Field (nv, i));
+      }
+      if (caml_memprof_major_tracked) caml_memprof_move_major (v, nv);
+      Hd_hp (hp) = Grayhd_hd (hd);
+      Field (v, 0) = nv;
+      *words += Whsize_hd (hd);
+    }else if (Color_hd (hd) == Caml_white && sz > 0){
+      /* Dead: finalise it now, since the chunk will not be swept. */
+      if (Tag_hd (hd) == Custom_tag){
+        void (*final_fun)(value) = Custom_ops_val (v)->finalize;
+        if (final_fun != NULL) final_fun (v);
+      }
+      if (caml_memprof_major_tracked) caml_memprof_free_major (v);
+    }
+    c->scan = hp + Bhsize_hd (hd);
+  }
+  return 0;
+}
+
+/* Evacuate for at most [pause] microseconds, or to the end if [pause]
+   is 0.  Return 0 when the evacuation is over.  The minor heap must be
+   empty. */
+int caml_evac_slice (uintnat pause)
+{
+  uint64_t start = caml_gc_clock ();
+  uint64_t deadline = pause == 0 ? 0 : start + (uint64_t) pause * 1000;
+  uintnat first = evac_cur, last, words = 0, i;
+  struct evac_chunk *c;
+  int partial = 0;
+
+                                      Assert (caml_gc_phase == Phase_evacuate);
+  while (evac_cur < evac_num){
+    c = &evac_chunks[evac_cur];
+    if (c->chunk == caml_heap_start) c->cancel = 1;
+    if (!c->cancel){
+      switch (move_blocks (c, deadline, &words)){
+      case 1: partial = 1; break;
+      case -1: c->cancel = 1; break;
+      }
+      if (partial) break;
+    }
+    ++ evac_cur;
+    if (deadline != 0 && caml_gc_clock () >= deadline) break;
+  }
+
+  /* Update the pointers to the blocks moved by this slice. */
+  last = partial ? evac_cur + 1 : evac_cur;
+  if (words > 0){
+    for (i = first; i < last; i++) fix_slots (&evac_chunks[i]);
+    caml_do_roots (fix_root);
+    caml_final_do_weak_roots (fix_root);
+    fix_root (caml_weak_list_head, &caml_weak_list_head);
+    fix_root (caml_ephe_list_head, &caml_ephe_list_head);
+  }
+
+  for (i = first; i < evac_cur; i++){
+    c = &evac_chunks[i];
+    if (c->cancel){
+      restore_chunk (c);
+    }else{
+      caml_page_table_remove (In_evacuation, c->chunk, c->end);
+      caml_shrink_heap (c->chunk);
+      ++ caml_stat_evacuated_chunks;
+    }
+    free (c->slots);
+    free (c->weak);
+    c->slots = NULL;
+    c->weak = NULL;
+    c->num_slots = c->max_slots = c->num_weak = c->max_weak = 0;
   }
+  caml_gc_event (Gc_ev_evacuation, start, words);
+  if (evac_cur < evac_num) return 1;
+
+  free (evac_chunks);
+  evac_chunks = NULL;
+  evac_num = evac_cur = 0;
+  caml_evac_start = caml_evac_end = NULL;
+  return 0;
 }
 
 void caml_compact_heap_maybe (void)
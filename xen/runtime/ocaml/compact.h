@@ -17,9 +17,17 @@
 
 #include "config.h"
 #include "misc.h"
+#include "mlvalues.h"
 
 extern void caml_compact_heap (void);
 extern void caml_compact_heap_maybe (void);
+extern void caml_evac_select (void);
+extern void caml_evac_begin (void);
+extern void caml_evac_weak (value);
+extern int caml_evac_slice (uintnat);
+
+extern uintnat caml_percent_evacuate;
+extern uintnat caml_evacuation_pause;
 
 
 #endif /* CAML_COMPACT_H */
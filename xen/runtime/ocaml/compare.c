@@ -89,6 +89,34 @@ static struct compare_item * compare_resize_stack(struct compare_item * sp)
       < 0 and > UNORDERED v1 is less than v2
       UNORDERED           v1 and v2 cannot be compared */
 
+static intnat compare_strings(value v1, value v2)
+{
+  mlsize_t len1, len2;
+  int res;
+
+  len1 = caml_string_length(v1);
+  len2 = caml_string_length(v2);
+  res = caml_bytes_compare(String_val(v1), String_val(v2),
+                           len1 <= len2 ? len1 : len2);
+  if (res != 0) return res;
+  return len1 - len2;
+}
+
+static intnat compare_doubles(double d1, double d2, int total)
+{
+  if (d1 < d2) return LESS;
+  if (d1 > d2) return GREATER;
+  if (d1 != d2) {
+    if (! total) return UNORDERED;
+    /* One or both of d1 and d2 is NaN.  Order according to the
+       convention NaN = NaN and NaN < f for all other floats f. */
+    if (d1 == d1) return GREATER; /* d1 is not NaN, d2 is NaN */
+    if (d2 == d2) return LESS;    /* d2 is not NaN, d1 is NaN */
+    /* d1 and d2 are both NaN, thus equal */
+  }
+  return EQUAL;
+}
+
 static intnat compare_val(value v1, value v2, int total)
 {
   struct compare_item * sp;
@@ -158,30 +186,15 @@ static intnat compare_val(value v1, value v2, int total)
     if (t1 != t2) return (intnat)t1 - (intnat)t2;
     switch(t1) {
     case String_tag: {
-      mlsize_t len1, len2;
-      int res;
+      intnat res;
       if (v1 == v2) break;
-      len1 = caml_string_length(v1);
-      len2 = caml_string_length(v2);
-      res = memcmp(String_val(v1), String_val(v2), len1 <= len2 ? len1 : len2);
-      if (res < 0) return LESS;
-      if (res > 0) return GREATER;
-      if (len1 != len2) return len1 - len2;
+      res = compare_strings(v1, v2);
+      if (res != 0) return res;
       break;
     }
     case Double_tag: {
-      double d1 = Double_val(v1);
-      double d2 = Double_val(v2);
-      if (d1 < d2) return LESS;
-      if (d1 > d2) return GREATER;
-      if (d1 != d2) {
-        if (! total) return UNORDERED;
-        /* One or both of d1 and d2 is NaN.  Order according to the
-           convention NaN = NaN and NaN < f for all other floats f. */
-        if (d1 == d1) return GREATER; /* d1 is not NaN, d2 is NaN */
-        if (d2 == d2) return LESS;    /* d2 is not NaN, d1 is NaN */
-        /* d1 and d2 are both NaN, thus equal: continue comparison */
-      }
+      intnat res = compare_doubles(Double_val(v1), Double_val(v2), total);
+      if (res != EQUAL) return res;
       break;
     }
     case Double_array_tag: {
@@ -264,9 +277,29 @@ static intnat compare_val(value v1, value v2, int total)
   }
 }
 
+/* Two integers, two strings or two floats are compared directly,
+   without setting up the stack of [compare_val]; everything else
+   goes through it. */
+
+static intnat compare_top(value v1, value v2, int total)
+{
+  tag_t t;
+
+  if (Is_long(v1) && Is_long(v2)) return Long_val(v1) - Long_val(v2);
+  if (Is_block(v1) && Is_block(v2)
+      && Is_in_value_area(v1) && Is_in_value_area(v2)) {
+    t = Tag_val(v1);
+    if (t == String_tag && Tag_val(v2) == String_tag)
+      return v1 == v2 ? EQUAL : compare_strings(v1, v2);
+    if (t == Double_tag && Tag_val(v2) == Double_tag)
+      return compare_doubles(Double_val(v1), Double_val(v2), total);
+  }
+  return compare_val(v1, v2, total);
+}
+
 CAMLprim value caml_compare(value v1, value v2)
 {
-  intnat res = compare_val(v1, v2, 1);
+  intnat res = compare_top(v1, v2, 1);
   /* Free stack if needed */
   if (compare_stack != compare_stack_init) compare_free_stack();
   if (res < 0)
@@ -279,42 +312,42 @@ CAMLprim value caml_compare(value v1, value v2)
 
 CAMLprim value caml_equal(value v1, value v2)
 {
-  intnat res = compare_val(v1, v2, 0);
+  intnat res = compare_top(v1, v2, 0);
   if (compare_stack != compare_stack_init) compare_free_stack();
   return Val_int(res == 0);
 }
 
 CAMLprim value caml_notequal(value v1, value v2)
 {
-  intnat res = compare_val(v1, v2, 0);
+  intnat res = compare_top(v1, v2, 0);
   if (compare_stack != compare_stack_init) compare_free_stack();
   return Val_int(res != 0);
 }
 
 CAMLprim value caml_lessthan(value v1, value v2)
 {
-  intnat res = compare_val(v1, v2, 0);
+  intnat res = compare_top(v1, v2, 0);
   if (compare_stack != compare_stack_init) compare_free_stack();
   return Val_int(res < 0 && res != UNORDERED);
 }
 
 CAMLprim value caml_lessequal(value v1, value v2)
 {
-  intnat res = compare_val(v1, v2, 0);
+  intnat res = compare_top(v1, v2, 0);
   if (compare_stack != compare_stack_init) compare_free_stack();
   return Val_int(res <= 0 && res != UNORDERED);
 }
 
 CAMLprim value caml_greaterthan(value v1, value v2)
 {
-  intnat res = compare_val(v1, v2, 0);
+  intnat res = compare_top(v1, v2, 0);
   if (compare_stack != compare_stack_init) compare_free_stack();
   return Val_int(res > 0);
 }
 
 CAMLprim value caml_greaterequal(value v1, value v2)
 {
-  intnat res = compare_val(v1, v2, 0);
+  intnat res = compare_top(v1, v2, 0);
   if (compare_stack != compare_stack_init) compare_free_stack();
   return Val_int(res >= 0);
 }
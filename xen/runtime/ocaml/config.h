@@ -163,5 +163,13 @@ typedef struct { uint32 l, h; } uint64, int64;
  */
 #define Max_percent_free_def 500
 
+/* Default budget for the memory held outside the heap by custom blocks
+   (see [caml_alloc_external_memory]): 64 Mb. */
+#define External_budget_def (64 * 1024 * 1024)
+
+/* Default size from which a block of the major heap is allocated in
+   its own chunk (see [caml_alloc_shr]): 128 kb. */
+#define Large_object_def (128 * 1024)
+
 
 #endif /* CAML_CONFIG_H */
@@ -40,6 +40,20 @@ CAMLexport value caml_alloc_custom(struct custom_operations * ops,
   return result;
 }
 
+/* Allocate a custom block that holds [nbytes] of external memory,
+   which its finaliser must give back with [caml_free_external_memory].
+   The memory is accounted once the block exists, so that it is not
+   counted if the allocation raises. */
+CAMLexport value caml_alloc_custom_external(struct custom_operations * ops,
+                                            uintnat size,
+                                            uintnat nbytes)
+{
+  value result = caml_alloc_custom(ops, size, 0, 1);
+
+  caml_alloc_external_memory(nbytes);
+  return caml_check_urgent_gc(result);
+}
+
 struct custom_operations_list {
   struct custom_operations * ops;
   struct custom_operations_list * next;
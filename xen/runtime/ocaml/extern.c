@@ -17,6 +17,7 @@
 
 #include <string.h>
 #include "alloc.h"
+#include "bigarray.h"
 #include "custom.h"
 #include "fail.h"
 #include "gc.h"
@@ -192,8 +193,95 @@ struct output_block {
 
 static struct output_block * extern_output_first, * extern_output_block;
 
+/* Scatter output into a list of user-provided buffers.  In this mode
+   [extern_userprovided_output] is the first buffer, which must hold the
+   header, and [extern_ptr], [extern_limit] point into the current one.
+   A write that straddles two buffers goes to a staging area instead,
+   which the next write (or the end of the output) copies out. */
+
+struct extern_segment {
+  char * data;
+  intnat len;
+};
+
+static struct extern_segment * extern_segments = NULL;
+static intnat extern_num_segments, extern_cur_segment;
+static char * extern_stage = NULL;  /* staging area in use, or NULL */
+static char * extern_stage_dest;     /* where its contents go */
+static char extern_stage_init[64];
+
+static void free_scatter_output(void)
+{
+  if (extern_stage != NULL && extern_stage != extern_stage_init)
+    free(extern_stage);
+  extern_stage = NULL;
+  caml_stat_free(extern_segments);
+  extern_segments = NULL;
+}
+
+/* Drop the segments left behind by a [caml_output_value_to_cstructs]
+   whose custom serializer raised without going through
+   [extern_failwith], before they are mistaken for the current output. */
+static void reset_scatter_output(void)
+{
+  if (extern_segments != NULL) free_scatter_output();
+}
+
+/* Move to the next buffer with room in it, if any. */
+static void scatter_next_segment(void)
+{
+  while (extern_ptr == extern_limit
+         && extern_cur_segment + 1 < extern_num_segments) {
+    extern_cur_segment++;
+    extern_ptr = extern_segments[extern_cur_segment].data;
+    extern_limit = extern_ptr + extern_segments[extern_cur_segment].len;
+  }
+}
+
+static intnat scatter_space_left(void)
+{
+  intnat n, i;
+
+  n = extern_limit - extern_ptr;
+  for (i = extern_cur_segment + 1; i < extern_num_segments; i++)
+    n += extern_segments[i].len;
+  return n;
+}
+
+/* Copy [len] bytes to the buffers at the current position.  There must
+   be enough room. */
+static void scatter_copy(char * data, intnat len)
+{
+  intnat n;
+
+  while (len > 0) {
+    scatter_next_segment();
+    n = extern_limit - extern_ptr;
+    if (n > len) n = len;
+    memmove(extern_ptr, data, n);
+    extern_ptr += n;
+    data += n;
+    len -= n;
+  }
+}
+
+static void scatter_flush_stage(void)
+{
+  char * stage = extern_stage;
+  intnat len = extern_ptr - extern_stage;
+
+  if (stage == NULL) return;
+  extern_stage = NULL;
+  extern_ptr = extern_stage_dest;
+  extern_limit = extern_segments[extern_cur_segment].data
+                 + extern_segments[extern_cur_segment].len;
+  scatter_copy(stage, len);
+  if (stage != extern_stage_init) free(stage);
+}
+
 static void init_extern_output(void)
 {
+  reset_scatter_output();
   extern_userprovided_output = NULL;
   extern_output_first = malloc(sizeof(struct output_block));
   if (extern_output_first == NULL) caml_raise_out_of_memory();
@@ -205,7 +293,9 @@ static void init_extern_output(void)
 
 static void close_extern_output(void)
 {
-  if (extern_userprovided_output == NULL){
+  if (extern_segments != NULL){
+    scatter_flush_stage();
+  }else if (extern_userprovided_output == NULL){
     extern_output_block->end = extern_ptr;
   }
 }
@@ -214,6 +304,7 @@ static void free_extern_output(void)
 {
   struct output_block * blk, * nextblk;
 
+  if (extern_segments != NULL) free_scatter_output();
   if (extern_userprovided_output != NULL) return;
   for (blk = extern_output_first; blk != NULL; blk = nextblk) {
     nextblk = blk->next;
@@ -223,11 +314,33 @@ static void free_extern_output(void)
   extern_free_stack();
 }
 
+static void grow_scatter_output(intnat required)
+{
+  scatter_flush_stage();
+  scatter_next_segment();
+  if (extern_ptr + required <= extern_limit) return;
+  if (scatter_space_left() < required)
+    extern_failwith("Marshal.to_cstructs: buffer overflow");
+  if (required <= sizeof(extern_stage_init))
+    extern_stage = extern_stage_init;
+  else {
+    extern_stage = malloc(required);
+    if (extern_stage == NULL) extern_out_of_memory();
+  }
+  extern_stage_dest = extern_ptr;
+  extern_ptr = extern_stage;
+  extern_limit = extern_stage + required;
+}
+
 static void grow_extern_output(intnat required)
 {
   struct output_block * blk;
   intnat extra;
 
+  if (extern_segments != NULL) {
+    grow_scatter_output(required);
+    return;
+  }
   if (extern_userprovided_output != NULL) {
     extern_failwith("Marshal.to_buffer: buffer overflow");
   }
@@ -248,9 +361,13 @@ static void grow_extern_output(intnat required)
 static intnat extern_output_length(void)
 {
   struct output_block * blk;
-  intnat len;
+  intnat len, i;
 
-  if (extern_userprovided_output != NULL) {
+  if (extern_segments != NULL) {
+    for (len = 0, i = 0; i < extern_cur_segment; i++)
+      len += extern_segments[i].len;
+    return len + (extern_ptr - extern_segments[extern_cur_segment].data);
+  } else if (extern_userprovided_output != NULL) {
     return extern_ptr - extern_userprovided_output;
   } else {
     for (len = 0, blk = extern_output_first; blk != NULL; blk = blk->next)
@@ -298,7 +415,17 @@ static void extern_stack_overflow(void)
 
 static void writeblock(char *data, intnat len)
 {
-  if (extern_ptr + len > extern_limit) grow_extern_output(len);
+  if (extern_ptr + len > extern_limit) {
+    if (extern_segments != NULL) {
+      /* Split the block between the buffers rather than staging it. */
+      scatter_flush_stage();
+      if (scatter_space_left() < len)
+        extern_failwith("Marshal.to_cstructs: buffer overflow");
+      scatter_copy(data, len);
+      return;
+    }
+    grow_extern_output(len);
+  }
   memmove(extern_ptr, data, len);
   extern_ptr += len;
 }
@@ -591,7 +718,10 @@ static intnat extern_value(value v, value flags)
     caml_failwith("output_value: object too big");
   }
 #endif
-  if (extern_userprovided_output != NULL)
+  if (extern_segments != NULL) {
+    extern_ptr = extern_userprovided_output + 4;
+    extern_limit = extern_userprovided_output + extern_segments[0].len;
+  } else if (extern_userprovided_output != NULL)
     extern_ptr = extern_userprovided_output + 4;
   else {
     extern_ptr = extern_output_first->data + 4;
@@ -663,6 +793,7 @@ CAMLprim value caml_output_value_to_buffer(value buf, value ofs, value len,
                                            value v, value flags)
 {
   intnat len_res;
+  reset_scatter_output();
   extern_userprovided_output = &Byte(buf, Long_val(ofs));
   extern_ptr = extern_userprovided_output;
   extern_limit = extern_userprovided_output + Long_val(len);
@@ -696,6 +827,7 @@ CAMLexport intnat caml_output_value_to_block(value v, value flags,
                                              char * buf, intnat len)
 {
   intnat len_res;
+  reset_scatter_output();
   extern_userprovided_output = buf;
   extern_ptr = extern_userprovided_output;
   extern_limit = extern_userprovided_output + len;
@@ -703,6 +835,52 @@ CAMLexport intnat caml_output_value_to_block(value v, value flags,
   return len_res;
 }
 
+/* Output to bigarrays and to lists of cstructs (records whose first
+   three fields are a bigarray, an offset and a length).  The offsets
+   and lengths are checked by the OCaml side. */
+
+CAMLprim value caml_output_value_to_bigarray(value ba, value ofs, value len,
+                                             value v, value flags)
+{
+  intnat len_res;
+  reset_scatter_output();
+  extern_userprovided_output = (char *) Caml_ba_data_val(ba) + Long_val(ofs);
+  extern_ptr = extern_userprovided_output;
+  extern_limit = extern_userprovided_output + Long_val(len);
+  len_res = extern_value(v, flags);
+  return Val_long(len_res);
+}
+
+CAMLprim value caml_output_value_to_cstructs(value bufs, value v, value flags)
+{
+  intnat n, len_res;
+  value l, c;
+
+  for (n = 0, l = bufs; l != Val_emptylist; l = Field(l, 1)) n++;
+  if (n == 0) caml_invalid_argument("Marshal.to_cstructs: no buffer");
+  reset_scatter_output();
+  extern_segments = caml_stat_alloc(n * sizeof(struct extern_segment));
+  for (n = 0, l = bufs; l != Val_emptylist; l = Field(l, 1), n++) {
+    c = Field(l, 0);
+    extern_segments[n].data =
+      (char *) Caml_ba_data_val(Field(c, 0)) + Long_val(Field(c, 1));
+    extern_segments[n].len = Long_val(Field(c, 2));
+  }
+  if (extern_segments[0].len < 5*4) {
+    free_scatter_output();
+    caml_invalid_argument("Marshal.to_cstructs: first buffer too short");
+  }
+  extern_num_segments = n;
+  extern_cur_segment = 0;
+  extern_stage = NULL;
+  extern_userprovided_output = extern_segments[0].data;
+  extern_ptr = extern_userprovided_output;
+  extern_limit = extern_userprovided_output + extern_segments[0].len;
+  len_res = extern_value(v, flags);
+  free_scatter_output();
+  return Val_long(len_res);
+}
+
 /* Functions for writing user-defined marshallers */
 
 CAMLexport void caml_serialize_int_1(int i)
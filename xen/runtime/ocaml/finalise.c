@@ -13,8 +13,11 @@
 
 /* Handling of finalised values. */
 
+#include "alloc.h"
 #include "callback.h"
 #include "fail.h"
+#include "gc_events.h"
+#include "memory.h"
 #include "mlvalues.h"
 #include "roots.h"
 #include "signals.h"
@@ -41,6 +44,18 @@ struct to_do {
 static struct to_do *to_do_hd = NULL;
 static struct to_do *to_do_tl = NULL;
 
+/* Maximum number of finalisation functions called by one call to
+   [caml_final_do_calls]; 0 means no limit.  The others are left for
+   the next call (at the next minor collection, or when the program is
+   idle), so that a major cycle that frees many finalised values does
+   not cause one long pause. */
+uintnat caml_final_batch = 0;
+
+static uintnat pending = 0;          /* size of the finalising set */
+static uintnat stat_calls = 0;       /* finalisation functions called */
+static uintnat stat_deferred = 0;    /* batches cut short by the limit */
+static uint64_t stat_time = 0, stat_max_time = 0;    /* nanoseconds */
+
 static void alloc_to_do (int size)
 {
   struct to_do *result = malloc (sizeof (struct to_do)
@@ -105,6 +120,7 @@ void caml_final_update (void)
     }
     young = old = j;
     to_do_tl->size = k;
+    pending += k;
     for (i = 0; i < k; i++){
       CAMLassert (Is_white_val (to_do_tl->item[i].val));
       caml_darken (to_do_tl->item[i].val, NULL);
@@ -114,18 +130,30 @@ void caml_final_update (void)
 
 static int running_finalisation_function = 0;
 
-/* Call the finalisation functions for the finalising set.
+static void record_time (uint64_t start)
+{
+  uint64_t t = caml_gc_clock () - start;
+
+  stat_time += t;
+  if (t > stat_max_time) stat_max_time = t;
+}
+
+/* Call at most [max] finalisation functions of the finalising set
+   (all of them if [max] is 0).
    Note that this function must be reentrant.
 */
-void caml_final_do_calls (void)
+static void do_calls (uintnat max)
 {
   struct final f;
   value res;
+  uintnat n = 0;
+  uint64_t start;
 
   if (running_finalisation_function) return;
 
   if (to_do_hd != NULL){
     caml_gc_message (0x80, "Calling finalisation functions.\n", 0);
+    start = caml_gc_clock ();
     while (1){
       while (to_do_hd != NULL && to_do_hd->size == 0){
         struct to_do *next_hd = to_do_hd->next;
@@ -134,18 +162,44 @@ void caml_final_do_calls (void)
         if (to_do_hd == NULL) to_do_tl = NULL;
       }
       if (to_do_hd == NULL) break;
+      if (max != 0 && n >= max){
+        ++ stat_deferred;
+        caml_gc_message (0x80, "Deferring %lu finalisation functions.\n",
+                         pending);
+        break;
+      }
       Assert (to_do_hd->size > 0);
       -- to_do_hd->size;
+      -- pending;
+      ++ n;
+      ++ stat_calls;
       f = to_do_hd->item[to_do_hd->size];
       running_finalisation_function = 1;
       res = caml_callback_exn (f.fun, f.val + f.offset);
       running_finalisation_function = 0;
-      if (Is_exception_result (res)) caml_raise (Extract_exception (res));
+      if (Is_exception_result (res)){
+        record_time (start);
+        caml_raise (Extract_exception (res));
+      }
     }
+    record_time (start);
     caml_gc_message (0x80, "Done calling finalisation functions.\n", 0);
   }
 }
 
+/* Call the finalisation functions for the finalising set, at most
+   [caml_final_batch] of them. */
+void caml_final_do_calls (void)
+{
+  do_calls (caml_final_batch);
+}
+
+/* Call all of them, when the program explicitly asks for a GC. */
+void caml_final_do_all_calls (void)
+{
+  do_calls (0);
+}
+
 /* Call a scanning_action [f] on [x]. */
 #define Call_action(f,x) (*(f)) ((x), &(x))
 
@@ -247,3 +301,43 @@ CAMLprim value caml_final_release (value unit)
   running_finalisation_function = 0;
   return Val_unit;
 }
+
+CAMLprim value caml_final_get_batch (value unit)
+{
+  return Val_long (caml_final_batch);
+}
+
+CAMLprim value caml_final_set_batch (value v)
+{
+  intnat n = Long_val (v);
+
+  if (n < 0) caml_invalid_argument ("Finaliser.set_batch");
+  caml_final_batch = n;
+  return Val_unit;
+}
+
+/* Run a batch of the finalisation functions left over by
+   [caml_final_do_calls].  Return false if there were none. */
+CAMLprim value caml_final_run_pending (value unit)
+{
+  if (pending == 0 || running_finalisation_function) return Val_false;
+  caml_final_do_calls ();
+  return Val_true;
+}
+
+CAMLprim value caml_final_stats (value unit)
+{
+  CAMLparam0 ();
+  CAMLlocal3 (res, time, max_time);
+
+  time = caml_copy_double ((double) stat_time / 1e9);
+  max_time = caml_copy_double ((double) stat_max_time / 1e9);
+  res = caml_alloc_tuple (6);
+  Store_field (res, 0, Val_long (young));
+  Store_field (res, 1, Val_long (pending));
+  Store_field (res, 2, Val_long (stat_calls));
+  Store_field (res, 3, Val_long (stat_deferred));
+  Store_field (res, 4, time);
+  Store_field (res, 5, max_time);
+  CAMLreturn (res);
+}
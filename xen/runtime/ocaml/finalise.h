@@ -18,6 +18,7 @@
 
 void caml_final_update (void);
 void caml_final_do_calls (void);
+void caml_final_do_all_calls (void);
 void caml_final_do_strong_roots (scanning_action f);
 void caml_final_do_weak_roots (scanning_action f);
 void caml_final_do_young_roots (scanning_action f);
@@ -61,12 +61,278 @@ static char *beyond = NULL;
 
 #define Next(b) (((block *) (b))->next_bp)
 
-#define Policy_next_fit 0
-#define Policy_first_fit 1
 uintnat caml_allocation_policy = Policy_next_fit;
 #define policy caml_allocation_policy
 
+static char *last_fragment;
+
+/* Best-fit policy.
+   Free blocks of 2 to [BF_NUM_SMALL] words are kept in one doubly-linked
+   list per size, and larger ones in a splay tree ordered by size, then by
+   address.  Allocation takes the smallest free block that fits and splits
+   it, keeping the low-address part (the remnant) in the free list.
+   These structures are not sorted by address, so [caml_fl_merge] is only
+   used by the sweeper to remember the last free block it has seen: each
+   dead block is merged with the free blocks around it in memory, which
+   are first removed from their list or from the tree.
+   Free blocks of 1 word cannot hold the links.  Like fragments, they are
+   left white and out of the free list; the sweeper reclaims them at the
+   next cycle.
+*/
+
+#define BF_NUM_SMALL 16
+
+#define Bf_next(v) Field ((v), 0)    /* small lists */
+#define Bf_prev(v) Field ((v), 1)
+#define Bf_left(v) Field ((v), 0)    /* large tree */
+#define Bf_right(v) Field ((v), 1)
+#define Bf_next_in_mem(v) ((value) &Field ((v), Whsize_val (v)))
+
+static value bf_small_fl [BF_NUM_SMALL + 1];
+static uintnat bf_small_map = 0;      /* bit [i] is set iff list [i] is
+                                         not empty */
+static value bf_large_tree = (value) NULL;
+
+static int bf_compare (mlsize_t wosz, value addr, value node)
+{
+  mlsize_t nsz = Wosize_val (node);
+
+  if (wosz != nsz) return wosz < nsz ? -1 : 1;
+  if (addr != node) return addr < node ? -1 : 1;
+  return 0;
+}
+
+/* Top-down splay of [t] around the key [(wosz, addr)].  If the key is not
+   in the tree, the new root is its predecessor or its successor. */
+static value bf_splay (value t, mlsize_t wosz, value addr)
+{
+  value ltree = (value) NULL, rtree = (value) NULL;
+  value *lhook = &ltree, *rhook = &rtree;
+  value y;
+  int c;
+
+  while (1){
+    c = bf_compare (wosz, addr, t);
+    if (c < 0){
+      if (Bf_left (t) == (value) NULL) break;
+      if (bf_compare (wosz, addr, Bf_left (t)) < 0){
+        y = Bf_left (t);                                /* rotate right */
+        Bf_left (t) = Bf_right (y);
+        Bf_right (y) = t;
+        t = y;
+        if (Bf_left (t) == (value) NULL) break;
+      }
+      *rhook = t;                                       /* link right */
+      rhook = &Bf_left (t);
+      t = Bf_left (t);
+    }else if (c > 0){
+      if (Bf_right (t) == (value) NULL) break;
+      if (bf_compare (wosz, addr, Bf_right (t)) > 0){
+        y = Bf_right (t);                               /* rotate left */
+        Bf_right (t) = Bf_left (y);
+        Bf_left (y) = t;
+        t = y;
+        if (Bf_right (t) == (value) NULL) break;
+      }
+      *lhook = t;                                       /* link left */
+      lhook = &Bf_right (t);
+      t = Bf_right (t);
+    }else{
+      break;
+    }
+  }
+  *lhook = Bf_left (t);
+  *rhook = Bf_right (t);
+  Bf_left (t) = ltree;
+  Bf_right (t) = rtree;
+  return t;
+}
+
+static void bf_tree_insert (value v)
+{
+  mlsize_t wosz = Wosize_val (v);
+  value t = bf_large_tree;
+
+  if (t == (value) NULL){
+    Bf_left (v) = Bf_right (v) = (value) NULL;
+  }else{
+    t = bf_splay (t, wosz, v);
+    if (bf_compare (wosz, v, t) < 0){
+      Bf_left (v) = Bf_left (t);
+      Bf_right (v) = t;
+      Bf_left (t) = (value) NULL;
+    }else{
+      Bf_right (v) = Bf_right (t);
+      Bf_left (v) = t;
+      Bf_right (t) = (value) NULL;
+    }
+  }
+  bf_large_tree = v;
+}
+
+static void bf_tree_remove (value v)
+{
+  value t = bf_splay (bf_large_tree, Wosize_val (v), v);
+                                                           Assert (t == v);
+  if (Bf_left (t) == (value) NULL){
+    bf_large_tree = Bf_right (t);
+  }else{
+    /* [v] is larger than everything in its left subtree: splaying for it
+       brings the maximum up, with an empty right subtree. */
+    value x = bf_splay (Bf_left (t), Wosize_val (v), v);
+    Bf_right (x) = Bf_right (t);
+    bf_large_tree = x;
+  }
+}
+
+/* Smallest block of the tree that has at least [wosz] words, or NULL. */
+static value bf_tree_best_fit (mlsize_t wosz)
+{
+  value t;
+
+  if (bf_large_tree == (value) NULL) return (value) NULL;
+  /* The address 0 is below every node of size [wosz]. */
+  bf_large_tree = t = bf_splay (bf_large_tree, wosz, (value) NULL);
+  if (Wosize_val (t) >= wosz) return t;
+  t = Bf_right (t);
+  if (t == (value) NULL) return (value) NULL;
+  while (Bf_left (t) != (value) NULL) t = Bf_left (t);
+  return t;
+}
+
+/* Put [v] in the free list, or leave it white if it is too small.
+   The header of [v] gives its size; its color is overwritten. */
+static void bf_insert (value v)
+{
+  mlsize_t wosz = Wosize_val (v);
+
+  if (wosz < 2){
+    Hd_val (v) = Make_header (wosz, Abstract_tag, Caml_white);
+    return;
+  }
+  Hd_val (v) = Make_header (wosz, 0, Caml_blue);
+  caml_fl_cur_size += Whsize_wosize (wosz);
+  if (wosz <= BF_NUM_SMALL){
+    Bf_next (v) = bf_small_fl[wosz];
+    Bf_prev (v) = (value) NULL;
+    if (bf_small_fl[wosz] != (value) NULL) Bf_prev (bf_small_fl[wosz]) = v;
+    bf_small_fl[wosz] = v;
+    bf_small_map |= (uintnat) 1 << wosz;
+  }else{
+    bf_tree_insert (v);
+  }
+}
+
+static void bf_remove (value v)
+{
+  mlsize_t wosz = Wosize_val (v);
+                      Assert (Color_val (v) == Caml_blue && wosz >= 2);
+  caml_fl_cur_size -= Whsize_wosize (wosz);
+  if (wosz <= BF_NUM_SMALL){
+    if (Bf_prev (v) == (value) NULL){
+      bf_small_fl[wosz] = Bf_next (v);
+      if (Bf_next (v) == (value) NULL) bf_small_map &= ~((uintnat) 1 << wosz);
+    }else{
+      Bf_next (Bf_prev (v)) = Bf_next (v);
+    }
+    if (Bf_next (v) != (value) NULL) Bf_prev (Bf_next (v)) = Bf_prev (v);
+  }else{
+    bf_tree_remove (v);
+  }
+}
+
+static void bf_reset (void)
+{
+  mlsize_t i;
+
+  for (i = 0; i <= BF_NUM_SMALL; i++) bf_small_fl[i] = (value) NULL;
+  bf_small_map = 0;
+  bf_large_tree = (value) NULL;
+}
+
+static char *bf_allocate (mlsize_t wo_sz)
+{
+  value v = (value) NULL;
+  mlsize_t wosz;
+
+  if (wo_sz <= BF_NUM_SMALL){
+    uintnat mask = bf_small_map & ((uintnat) -1 << wo_sz);
+    if (mask != 0){
+      for (wosz = wo_sz; (mask & ((uintnat) 1 << wosz)) == 0; wosz++);
+      v = bf_small_fl[wosz];
+    }
+  }
+  if (v == (value) NULL) v = bf_tree_best_fit (wo_sz);
+  if (v == (value) NULL) return NULL;
+
+  bf_remove (v);
+  wosz = Wosize_val (v);
+  if (wosz == wo_sz) return (char *) Hp_val (v);
+  /* Split the block: the allocated block is right-justified, the remnant
+     keeps the address (and header) of [v]. */
+  Hd_val (v) = Make_header (wosz - Whsize_wosize (wo_sz), 0, Caml_blue);
+  bf_insert (v);
+  return (char *) &Field (v, wosz - Whsize_wosize (wo_sz));
+}
+
+/* Merge the dead block [bp] with the free block the sweeper saw just
+   before it and the free blocks that follow it, up to [limit]. */
+static char *bf_merge_block (char *bp, char *limit)
+{
+  value start = Val_bp (bp);
+  value prev = Val_bp (caml_fl_merge);
+  value cur;
+  mlsize_t wosz;
+
+  if (caml_fl_merge != Fl_head && Color_val (prev) == Caml_blue
+      && Bf_next_in_mem (prev) == start
+      && Wosize_val (prev) + Whsize_val (start) <= Max_wosize){
+    bf_remove (prev);
+    start = prev;
+  }else if (last_fragment != NULL
+            && Bf_next_in_mem (Val_bp (last_fragment)) == start
+            && Wosize_bp (last_fragment) + Whsize_val (start) <= Max_wosize){
+    start = Val_bp (last_fragment);
+  }
+  cur = Bf_next_in_mem (Val_bp (bp));
+  while ((char *) Hp_val (cur) < limit && Color_val (cur) == Caml_blue
+         && Wosize_whsize ((value *) Bf_next_in_mem (cur) - (value *) start)
+              <= Max_wosize){
+    bf_remove (cur);
+    cur = Bf_next_in_mem (cur);
+  }
+  wosz = Wosize_whsize ((value *) cur - (value *) start);
+  Hd_val (start) = Make_header (wosz, 0, Caml_blue);
+  bf_insert (start);
+  if (wosz >= 2){
+    caml_fl_merge = Bp_val (start);
+    last_fragment = NULL;
+  }else{
+    last_fragment = Bp_val (start);
+  }
+  return (char *) Hp_val (cur);
+}
+
+static void bf_add_blocks (char *bp)
+{
+  value v = Val_bp (bp), next;
+
+  while (v != (value) NULL){
+    next = Field (v, 0);
+    bf_insert (v);
+    v = next;
+  }
+}
+
 #ifdef DEBUG
+static uintnat bf_check_tree (value t)
+{
+  if (t == (value) NULL) return 0;
+  Assert (Color_val (t) == Caml_blue && Wosize_val (t) > BF_NUM_SMALL);
+  return Whsize_val (t) + bf_check_tree (Bf_left (t))
+         + bf_check_tree (Bf_right (t));
+}
+
 static void fl_check (void)
 {
   char *cur, *prev;
@@ -93,6 +359,19 @@ static void fl_check (void)
     prev = cur;
     cur = Next (prev);
   }
+  if (policy == Policy_best_fit){
+    mlsize_t i;
+    size_found = 0;
+    for (i = 2; i <= BF_NUM_SMALL; i++){
+      for (cur = (char *) bf_small_fl[i]; cur != NULL; cur = Next (cur)){
+        Assert (Wosize_bp (cur) == i && Color_hp (Hp_bp (cur)) == Caml_blue);
+        size_found += Whsize_bp (cur);
+      }
+    }
+    size_found += bf_check_tree (bf_large_tree);
+    Assert (size_found == caml_fl_cur_size);
+    return;
+  }
   if (policy == Policy_next_fit) Assert (prev_found || fl_prev == Fl_head);
   if (policy == Policy_first_fit) Assert (flp_found == flp_size);
   Assert (merge_found || caml_fl_merge == Fl_head);
@@ -159,6 +438,9 @@ char *caml_fl_allocate (mlsize_t wo_sz)
                                   Assert (sizeof (char *) == sizeof (value));
                                   Assert (wo_sz >= 1);
   switch (policy){
+  case Policy_best_fit:
+    return bf_allocate (wo_sz);
+
   case Policy_next_fit:
                                   Assert (fl_prev != NULL);
     /* Search from [fl_prev] to the end of the list. */
@@ -335,8 +617,6 @@ char *caml_fl_allocate (mlsize_t wo_sz)
   return NULL;  /* NOT REACHED */
 }
 
-static char *last_fragment;
-
 void caml_fl_init_merge (void)
 {
   last_fragment = NULL;
@@ -368,6 +648,9 @@ void caml_fl_reset (void)
   case Policy_first_fit:
     truncate_flp (Fl_head);
     break;
+  case Policy_best_fit:
+    bf_reset ();
+    break;
   default:
     Assert (0);
     break;
@@ -377,13 +660,16 @@ void caml_fl_reset (void)
 }
 
 /* [caml_fl_merge_block] returns the head pointer of the next block after [bp],
-   because merging blocks may change the size of [bp]. */
-char *caml_fl_merge_block (char *bp)
+   because merging blocks may change the size of [bp].  [limit] is the end
+   of the heap chunk that contains [bp]. */
+char *caml_fl_merge_block (char *bp, char *limit)
 {
   char *prev, *cur, *adj;
   header_t hd = Hd_bp (bp);
   mlsize_t prev_wosz;
 
+  if (policy == Policy_best_fit) return bf_merge_block (bp, limit);
+
   caml_fl_cur_size += Whsize_hd (hd);
 
 #ifdef DEBUG
@@ -467,6 +753,10 @@ char *caml_fl_merge_block (char *bp)
 */
 void caml_fl_add_blocks (char *bp)
 {
+  if (policy == Policy_best_fit){
+    bf_add_blocks (bp);
+    return;
+  }
                                                    Assert (fl_last != NULL);
                                             Assert (Next (fl_last) == NULL);
   caml_fl_cur_size += Whsize_bp (bp);
@@ -502,6 +792,35 @@ void caml_fl_add_blocks (char *bp)
   }
 }
 
+/* Take the free blocks between [lo] and [hi] out of the free list; they
+   stay blue.  This is called by the sweeper when it enters a heap chunk
+   [lo..hi] that is to be retired (see [compact.c]), so [caml_fl_merge]
+   is the last free-list block before [lo]. */
+void caml_fl_detach (char *lo, char *hi)
+{
+  char *prev, *cur, *hp;
+
+  if (policy == Policy_best_fit){
+    for (hp = lo; hp < hi; hp += Bhsize_hp (hp)){
+      if (Color_hp (hp) == Caml_blue) bf_remove (Val_hp (hp));
+    }
+    return;
+  }
+  prev = caml_fl_merge;
+  cur = Next (prev);
+                                            Assert (cur == NULL || cur > lo);
+  while (cur != NULL && cur < hi){
+    caml_fl_cur_size -= Whsize_bp (cur);
+    if (fl_prev == cur) fl_prev = prev;
+    cur = Next (cur);
+  }
+  Next (prev) = cur;
+  if (policy == Policy_first_fit) truncate_flp (prev);
+#ifdef DEBUG
+  fl_last = NULL;
+#endif
+}
+
 /* Cut a block of memory into Max_wosize pieces, give them headers,
    and optionally merge them into the free list.
    arguments:
@@ -523,14 +842,55 @@ void caml_make_free_blocks (value *p, mlsize_t size, int do_merge, int color)
       sz = size;
     }
     *(header_t *)p = Make_header (Wosize_whsize (sz), 0, color);
-    if (do_merge) caml_fl_merge_block (Bp_hp (p));
+    if (do_merge) caml_fl_merge_block (Bp_hp (p), (char *) (p + sz));
     size -= sz;
     p += sz;
   }
 }
 
+/* Next-fit and first-fit share the address-ordered free list, but
+   best-fit has its own structures.  When switching between the two,
+   rebuild the free list from the blue blocks of the heap, in address
+   order.  This must be done between two major cycles. */
+static void rebuild_free_list (void)
+{
+  char *ch, *chend, *hp;
+  value chain = (value) NULL, *last = &chain, v;
+
+                                          Assert (caml_gc_phase == Phase_idle);
+  /* Chain the free blocks through their first field before the old
+     structures are overwritten. */
+  for (ch = caml_heap_start; ch != NULL; ch = Chunk_next (ch)){
+    if (Chunk_large (ch)) continue;  /* the tail is not in the free list */
+    chend = ch + Chunk_size (ch);
+    Chunk_evac (ch) = Evac_none;   /* retired chunks go back in service */
+    for (hp = ch; hp < chend; hp += Bhsize_hp (hp)){
+      if (Color_hp (hp) == Caml_blue){
+        *last = Val_hp (hp);
+        last = &Field (Val_hp (hp), 0);
+      }
+    }
+  }
+  *last = (value) NULL;
+
+  Field ((value) Fl_head, 0) = (value) NULL;
+  fl_prev = Fl_head;
+  truncate_flp (Fl_head);
+  bf_reset ();
+  caml_fl_cur_size = 0;
+  caml_fl_init_merge ();
+  for (v = chain; v != (value) NULL; v = chain){
+    chain = Field (v, 0);
+    Hd_val (v) = Whitehd_hd (Hd_val (v));
+    caml_fl_merge_block (Bp_val (v), (char *) Hp_val (Bf_next_in_mem (v)));
+  }
+}
+
 void caml_set_allocation_policy (uintnat p)
 {
+  int rebuild = caml_heap_start != NULL
+                && (p == Policy_best_fit) != (policy == Policy_best_fit);
+
   switch (p){
   case Policy_next_fit:
     fl_prev = Fl_head;
@@ -541,7 +901,11 @@ void caml_set_allocation_policy (uintnat p)
     beyond = NULL;
     policy = p;
     break;
-  default:
+  case Policy_best_fit:
+    policy = p;
     break;
+  default:
+    return;
   }
+  if (rebuild) rebuild_free_list ();
 }
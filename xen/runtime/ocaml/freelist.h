@@ -22,11 +22,17 @@
 
 extern asize_t caml_fl_cur_size;     /* size in words */
 
+/* Allocation policies, see [caml_set_allocation_policy]. */
+#define Policy_next_fit 0
+#define Policy_first_fit 1
+#define Policy_best_fit 2
+
 char *caml_fl_allocate (mlsize_t);
 void caml_fl_init_merge (void);
 void caml_fl_reset (void);
-char *caml_fl_merge_block (char *);
+char *caml_fl_merge_block (char *, char *);
 void caml_fl_add_blocks (char *);
+void caml_fl_detach (char *, char *);
 void caml_make_free_blocks (value *, mlsize_t, int, int);
 void caml_set_allocation_policy (uintnat);
 
@@ -19,6 +19,7 @@
 #include "gc.h"
 #include "gc_ctrl.h"
 #include "major_gc.h"
+#include "memory.h"
 #include "minor_gc.h"
 #include "misc.h"
 #include "mlvalues.h"
@@ -41,7 +42,8 @@ intnat caml_stat_minor_collections = 0,
        caml_stat_heap_size = 0,              /* bytes */
        caml_stat_top_heap_size = 0,          /* bytes */
        caml_stat_compactions = 0,
-       caml_stat_heap_chunks = 0;
+       caml_stat_heap_chunks = 0,
+       caml_stat_evacuated_chunks = 0;     /* freed by evacuation */
 
 extern uintnat caml_major_heap_increment;  /* bytes; see major_gc.c */
 extern uintnat caml_percent_free;          /*        see major_gc.c */
@@ -170,7 +172,15 @@ static value heap_stats (int returnstats)
           }
         }
         break;
-      case Caml_gray: case Caml_black:
+      case Caml_gray:
+        if (caml_gc_phase == Phase_evacuate){
+          /* A moved block, left behind by the evacuation (compact.c). */
+          ++ free_blocks;
+          free_words += Whsize_hd (cur_hd);
+          break;
+        }
+        /* fall through */
+      case Caml_black:
         Assert (Wosize_hd (cur_hd) > 0);
         ++ live_blocks;
         live_words += Whsize_hd (cur_hd);
@@ -366,7 +376,7 @@ CAMLprim value caml_gc_set(value v)
   uintnat newpf, newpm;
   asize_t newheapincr;
   asize_t newminsize;
-  uintnat oldpolicy;
+  uintnat oldpolicy, newpolicy;
 
   caml_verb_gc = Long_val (Field (v, 3));
 
@@ -392,16 +402,25 @@ CAMLprim value caml_gc_set(value v)
     caml_gc_message (0x20, "New heap increment size: %luk bytes\n",
                      caml_major_heap_increment/1024);
   }
+  /* Switching to or from best-fit rebuilds the free list, which must
+     happen between two major cycles.  Finishing the cycle empties the
+     minor heap and invalidates [v], so read the minor heap size first. */
+  newminsize = Bsize_wsize (norm_minsize (Long_val (Field (v, 0))));
   oldpolicy = caml_allocation_policy;
-  caml_set_allocation_policy (Long_val (Field (v, 6)));
+  newpolicy = Long_val (Field (v, 6));
+  if (newpolicy != oldpolicy
+      && (newpolicy == Policy_best_fit || oldpolicy == Policy_best_fit)){
+    caml_empty_minor_heap ();
+    caml_finish_major_cycle ();
+  }
+  caml_set_allocation_policy (newpolicy);
   if (oldpolicy != caml_allocation_policy){
     caml_gc_message (0x20, "New allocation policy: %d\n",
                      caml_allocation_policy);
   }
 
     /* Minor heap size comes last because it will trigger a minor collection
-       (thus invalidating [v]) and it can raise [Out_of_memory]. */
-  newminsize = Bsize_wsize (norm_minsize (Long_val (Field (v, 0))));
+       and it can raise [Out_of_memory]. */
   if (newminsize != caml_minor_heap_size){
     caml_gc_message (0x20, "New minor heap size: %luk bytes\n",
                      newminsize/1024);
@@ -438,7 +457,7 @@ CAMLprim value caml_gc_major(value v)
   caml_empty_minor_heap ();
   caml_finish_major_cycle ();
   test_and_compact ();
-  caml_final_do_calls ();
+  caml_final_do_all_calls ();
   return Val_unit;
 }
 
@@ -447,11 +466,11 @@ CAMLprim value caml_gc_full_major(value v)
   caml_gc_message (0x1, "Full major GC cycle requested\n", 0);
   caml_empty_minor_heap ();
   caml_finish_major_cycle ();
-  caml_final_do_calls ();
+  caml_final_do_all_calls ();
   caml_empty_minor_heap ();
   caml_finish_major_cycle ();
   test_and_compact ();
-  caml_final_do_calls ();
+  caml_final_do_all_calls ();
   return Val_unit;
 }
 
@@ -467,11 +486,105 @@ CAMLprim value caml_gc_compaction(value v)
   caml_gc_message (0x10, "Heap compaction requested\n", 0);
   caml_empty_minor_heap ();
   caml_finish_major_cycle ();
-  caml_final_do_calls ();
+  caml_final_do_all_calls ();
   caml_empty_minor_heap ();
   caml_finish_major_cycle ();
   caml_compact_heap ();
-  caml_final_do_calls ();
+  caml_final_do_all_calls ();
+  return Val_unit;
+}
+
+/* Evacuation of sparse heap chunks, see compact.c. */
+CAMLprim value caml_gc_get_evacuation (value v)
+{
+  CAMLparam0 ();   /* v is ignored */
+  CAMLlocal1 (res);
+
+  res = caml_alloc_tuple (2);
+  Store_field (res, 0, Val_long (caml_percent_evacuate));
+  Store_field (res, 1, Val_long (caml_evacuation_pause));
+  CAMLreturn (res);
+}
+
+CAMLprim value caml_gc_set_evacuation (value v)
+{
+  intnat newpe = Long_val (Field (v, 0));
+  intnat newpause = Long_val (Field (v, 1));
+
+  if (newpe < 0) newpe = 0;
+  if (newpe > 100) newpe = 100;
+  if (newpause < 1) newpause = 1;
+  if (newpe != caml_percent_evacuate){
+    caml_percent_evacuate = newpe;
+    caml_gc_message (0x20, "New evacuation threshold: %d%%\n",
+                     caml_percent_evacuate);
+  }
+  if (newpause != caml_evacuation_pause){
+    caml_evacuation_pause = newpause;
+    caml_gc_message (0x20, "New evacuation pause: %duS\n",
+                     caml_evacuation_pause);
+  }
+  return Val_unit;
+}
+
+CAMLprim value caml_gc_evacuated_chunks (value v)
+{
+  return Val_long (caml_stat_evacuated_chunks);
+}
+
+/* External memory held by custom blocks, see memory.c. */
+CAMLprim value caml_gc_external_memory (value v)
+{
+  CAMLparam0 ();   /* v is ignored */
+  CAMLlocal1 (res);
+
+  res = caml_alloc_tuple (3);
+  Store_field (res, 0, Val_long (caml_external_budget));
+  Store_field (res, 1, Val_long (caml_external_size));
+  Store_field (res, 2, Val_long (caml_external_peak));
+  CAMLreturn (res);
+}
+
+CAMLprim value caml_gc_set_external_budget (value v)
+{
+  intnat newbudget = Long_val (v);
+
+  if (newbudget < Page_size) newbudget = Page_size;
+  caml_external_budget = newbudget;
+  caml_gc_message (0x20, "New external memory budget: %"
+                   ARCH_INTNAT_PRINTF_FORMAT "uk bytes\n",
+                   caml_external_budget / 1024);
+  return Val_unit;
+}
+
+CAMLprim value caml_gc_large_objects (value v)
+{
+  CAMLparam0 ();   /* v is ignored */
+  CAMLlocal1 (res);
+
+  res = caml_alloc_tuple (5);
+  Store_field (res, 0, Val_long (Bsize_wsize (caml_large_wosize)));
+  Store_field (res, 1, Val_long (caml_large_chunks));
+  Store_field (res, 2, Val_long (caml_large_bytes));
+  Store_field (res, 3, Val_long (caml_large_allocated));
+  Store_field (res, 4, Val_long (caml_large_freed));
+  CAMLreturn (res);
+}
+
+CAMLprim value caml_gc_set_large_threshold (value v)
+{
+  intnat newthreshold = Long_val (v);
+
+  if (newthreshold <= 0){
+    caml_large_wosize = 0;
+    caml_gc_message (0x20, "Large-object space disabled\n", 0);
+  }else{
+    if (newthreshold < Page_size) newthreshold = Page_size;
+    caml_large_wosize = Wsize_bsize (newthreshold);
+    caml_gc_message (0x20, "New large object threshold: %"
+                     ARCH_INTNAT_PRINTF_FORMAT "uk bytes\n",
+                     Bsize_wsize (caml_large_wosize) / 1024);
+  }
   return Val_unit;
 }
 
@@ -0,0 +1,175 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Duration of the GC pauses.
+
+   Each minor collection, major slice, compaction and heap growth is
+   timed and counted in a histogram with one bucket per power of two
+   nanoseconds.  Optionally, the events are also recorded in a ring
+   buffer, with the time at which they ended and the number of words
+   they processed, so that latency spikes can be matched with GC
+   activity.  Events can be nested: a heap growth may happen during a
+   minor collection, and a compaction at the end of a major slice. */
+
+#include <stdlib.h>
+#ifndef SYS_xen
+#include <sys/time.h>
+#endif
+
+#include "alloc.h"
+#include "fail.h"
+#include "gc_events.h"
+#include "memory.h"
+#include "mlvalues.h"
+
+#define Num_buckets 64
+
+struct gc_event {
+  uint64_t time;      /* end of the event, ns */
+  uint64_t duration;  /* ns */
+  uintnat words;
+  int kind;
+};
+
+static uintnat histogram [Gc_ev_num_kinds][Num_buckets];
+static uint64_t max_duration [Gc_ev_num_kinds];
+
+static struct gc_event *ring = NULL;
+static uintnat ring_size = 0;   /* 0: events are not recorded */
+static uintnat ring_count = 0;  /* total number of events recorded */
+
+#ifdef SYS_xen
+/* Mini-OS monotonic clock, see xencaml/clock_stubs.c.  [getrusage] is
+   not available on Xen. */
+extern uint64_t caml_xen_monotonic_clock (void);
+
+uint64_t caml_gc_clock (void)
+{
+  return caml_xen_monotonic_clock ();
+}
+#else
+uint64_t caml_gc_clock (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return (uint64_t) tv.tv_sec * 1000000000 + (uint64_t) tv.tv_usec * 1000;
+}
+#endif
+
+/* Record an event of kind [kind] that started at time [start]. */
+void caml_gc_event (int kind, uint64_t start, uintnat words)
+{
+  uint64_t now = caml_gc_clock ();
+  uint64_t d = now - start;
+  int b = 0;
+
+  while (b < Num_buckets - 1 && (d >> (b + 1)) != 0) ++ b;
+  ++ histogram[kind][b];
+  if (d > max_duration[kind]) max_duration[kind] = d;
+
+  if (ring_size != 0){
+    struct gc_event *ev = &ring[ring_count % ring_size];
+    ev->time = now;
+    ev->duration = d;
+    ev->words = words;
+    ev->kind = kind;
+    ++ ring_count;
+  }
+}
+
+CAMLprim value caml_gc_events_histogram (value vkind)
+{
+  CAMLparam0 ();
+  CAMLlocal1 (res);
+  int kind = Int_val (vkind), b, n = Num_buckets;
+
+  /* Drop the empty buckets at the end. */
+  while (n > 0 && histogram[kind][n - 1] == 0) -- n;
+  res = caml_alloc_tuple (n);   /* n may be 0: Atom (0) */
+  for (b = 0; b < n; b++){
+    Store_field (res, b, Val_long (histogram[kind][b]));
+  }
+  CAMLreturn (res);
+}
+
+CAMLprim value caml_gc_events_max (value vkind)
+{
+  return caml_copy_double ((double) max_duration[Int_val (vkind)] * 1e-9);
+}
+
+CAMLprim value caml_gc_events_set_log_size (value vsize)
+{
+  intnat size = Long_val (vsize);
+  struct gc_event *r = NULL;
+
+  if (size < 0) caml_invalid_argument ("Gc_events.set_log_size");
+  if (size > 0){
+    r = malloc (size * sizeof (struct gc_event));
+    if (r == NULL) caml_raise_out_of_memory ();
+  }
+  free (ring);
+  ring = r;
+  ring_size = size;
+  ring_count = 0;
+  return Val_unit;
+}
+
+/* The events in the log, oldest first.  The records are allocated
+   before the log is read, since the allocations may trigger a GC that
+   records new events; they are then filled without allocating. */
+CAMLprim value caml_gc_events_snapshot (value unit)
+{
+  CAMLparam0 ();
+  CAMLlocal3 (res, ev, tmp);
+  struct gc_event *e;
+  uintnat n, first, i;
+
+  /* A finaliser run by a GC may also reset or resize the log. */
+  do{
+    n = ring_count < ring_size ? ring_count : ring_size;
+    res = caml_alloc_tuple (n);
+    for (i = 0; i < n; i++){
+      ev = caml_alloc_tuple (4);
+      tmp = caml_copy_double (0.0);
+      Store_field (ev, 0, tmp);
+      tmp = caml_copy_double (0.0);
+      Store_field (ev, 2, tmp);
+      Store_field (res, i, ev);
+    }
+  }while (n > (ring_count < ring_size ? ring_count : ring_size));
+  /* The last [n] events, counting those recorded meanwhile. */
+  first = ring_count - n;
+  for (i = 0; i < n; i++){
+    e = &ring[(first + i) % ring_size];
+    ev = Field (res, i);
+    Store_double_val (Field (ev, 0), (double) e->time * 1e-9);
+    Store_field (ev, 1, Val_int (e->kind));
+    Store_double_val (Field (ev, 2), (double) e->duration * 1e-9);
+    Store_field (ev, 3, Val_long (e->words));
+  }
+  CAMLreturn (res);
+}
+
+CAMLprim value caml_gc_events_reset (value unit)
+{
+  int k, b;
+
+  for (k = 0; k < Gc_ev_num_kinds; k++){
+    for (b = 0; b < Num_buckets; b++) histogram[k][b] = 0;
+    max_duration[k] = 0;
+  }
+  ring_count = 0;
+  return Val_unit;
+}
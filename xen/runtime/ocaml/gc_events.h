@@ -0,0 +1,36 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Timing of the GC pauses. */
+
+#ifndef CAML_GC_EVENTS_H
+#define CAML_GC_EVENTS_H
+
+#include <stdint.h>
+
+#include "misc.h"
+
+/* Kinds of events; keep in sync with [Gc_events.kind] in lib/gc_events.ml */
+#define Gc_ev_minor 0
+#define Gc_ev_major_slice 1
+#define Gc_ev_compaction 2
+#define Gc_ev_heap_growth 3
+#define Gc_ev_evacuation 4
+#define Gc_ev_num_kinds 5
+
+uint64_t caml_gc_clock (void);      /* in nanoseconds */
+void caml_gc_event (int kind, uint64_t start, uintnat words);
+
+
+#endif /* CAML_GC_EVENTS_H */
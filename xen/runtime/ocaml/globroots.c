@@ -13,6 +13,7 @@
 
 /* Registration of global memory roots */
 
+#include "alloc.h"
 #include "memory.h"
 #include "misc.h"
 #include "mlvalues.h"
@@ -25,6 +26,7 @@
 
 struct global_root {
   value * root;                    /* the address of the root */
+  int level;                       /* the size of [forward] minus 1 */
   struct global_root * forward[1]; /* variable-length array */
 };
 
@@ -32,8 +34,9 @@ struct global_root {
 
 struct global_root_list {
   value * root;                 /* dummy value for layout compatibility */
-  struct global_root * forward[NUM_LEVELS]; /* forward chaining */
   int level;                    /* max used level */
+  struct global_root * forward[NUM_LEVELS]; /* forward chaining */
+  uintnat count;                /* number of roots in the list */
 };
 
 /* Generate a random level for a new node: 0 with probability 3/4,
@@ -61,6 +64,42 @@ static int random_level(void)
   return level;
 }
 
+/* Nodes are recycled through per-level free lists rather than going
+   back to malloc: stubs that register and remove a root for each
+   request, and the minor GC moving the young roots to the old list,
+   would otherwise allocate and free one node per root each time. */
+
+#define Max_free_roots 1024
+
+static struct global_root * free_roots[NUM_LEVELS] = { NULL, };
+static int num_free_roots = 0;
+
+static struct global_root * alloc_root_node(int level)
+{
+  struct global_root * e = free_roots[level];
+
+  if (e != NULL) {
+    free_roots[level] = e->forward[0];
+    num_free_roots--;
+    return e;
+  }
+  e = caml_stat_alloc(sizeof(struct global_root) +
+                      level * sizeof(struct global_root *));
+  e->level = level;
+  return e;
+}
+
+static void free_root_node(struct global_root * e)
+{
+  if (num_free_roots >= Max_free_roots) {
+    caml_stat_free(e);
+    return;
+  }
+  e->forward[0] = free_roots[e->level];
+  free_roots[e->level] = e;
+  num_free_roots++;
+}
+
 /* Insertion in a global root list */
 
 static void caml_insert_global_root(struct global_root_list * rootlist,
@@ -91,13 +130,13 @@ static void caml_insert_global_root(struct global_root_list * rootlist,
       update[i] = (struct global_root *) rootlist;
     rootlist->level = new_level;
   }
-  e = caml_stat_alloc(sizeof(struct global_root) +
-                      new_level * sizeof(struct global_root *));
+  e = alloc_root_node(new_level);
   e->root = r;
   for (i = 0; i <= new_level; i++) {
     e->forward[i] = update[i]->forward[i];
     update[i]->forward[i] = e;
   }
+  rootlist->count++;
 }
 
 /* Deletion in a global root list */
@@ -129,7 +168,8 @@ static void caml_delete_global_root(struct global_root_list * rootlist,
       update[i]->forward[i] = e->forward[i];
   }
   /* Reclaim list element */
-  caml_stat_free(e);
+  free_root_node(e);
+  rootlist->count--;
   /* Down-correct list level */
   while (rootlist->level > 0 &&
          rootlist->forward[rootlist->level] == NULL)
@@ -157,20 +197,21 @@ static void caml_empty_global_roots(struct global_root_list * rootlist)
 
   for (gr = rootlist->forward[0]; gr != NULL; /**/) {
     next = gr->forward[0];
-    caml_stat_free(gr);
+    free_root_node(gr);
     gr = next;
   }
   for (i = 0; i <= rootlist->level; i++) rootlist->forward[i] = NULL;
   rootlist->level = 0;
+  rootlist->count = 0;
 }
 
 /* The three global root lists */
 
-struct global_root_list caml_global_roots = { NULL, { NULL, }, 0 };
+struct global_root_list caml_global_roots = { NULL, 0, { NULL, }, 0 };
                   /* mutable roots, don't know whether old or young */
-struct global_root_list caml_global_roots_young = { NULL, { NULL, }, 0 };
+struct global_root_list caml_global_roots_young = { NULL, 0, { NULL, }, 0 };
                  /* generational roots pointing to minor or major heap */
-struct global_root_list caml_global_roots_old = { NULL, { NULL, }, 0 };
+struct global_root_list caml_global_roots_old = { NULL, 0, { NULL, }, 0 };
                   /* generational roots pointing to major heap */
 
 /* Register a global C root of the mutable kind */
@@ -279,3 +320,17 @@ void caml_scan_global_young_roots(scanning_action f)
   }
   caml_empty_global_roots(&caml_global_roots_young);
 }
+
+/* Number of roots in each list: (mutable, young, old) */
+
+CAMLprim value caml_gc_global_roots(value unit)
+{
+  CAMLparam0 ();
+  CAMLlocal1 (res);
+
+  res = caml_alloc_tuple (3);
+  Field (res, 0) = Val_long (caml_global_roots.count);
+  Field (res, 1) = Val_long (caml_global_roots_young.count);
+  Field (res, 2) = Val_long (caml_global_roots_old.count);
+  CAMLreturn (res);
+}
@@ -18,6 +18,7 @@
 #include <string.h>
 #include <stdio.h>
 #include "alloc.h"
+#include "bigarray.h"
 #include "callback.h"
 #include "custom.h"
 #include "fail.h"
@@ -527,7 +528,9 @@ static void intern_alloc(mlsize_t whsize, mlsize_t num_objects)
     }else if (wosize <= Max_young_wosize){
       intern_block = caml_alloc_small (wosize, String_tag);
     }else{
-      intern_block = caml_alloc_shr (wosize, String_tag);
+      /* The block is split into the unmarshalled objects: keep it out of
+         the large-object space. */
+      intern_block = caml_alloc_shr_no_large (wosize, String_tag);
       /* do not do the urgent_gc check here because it might darken
          intern_block into gray and break the Assert 3 lines down */
     }
@@ -711,6 +714,72 @@ CAMLexport value caml_input_value_from_block(char * data, intnat len)
   return obj;
 }
 
+/* Input from bigarrays and from lists of cstructs (records whose first
+   three fields are a bigarray, an offset and a length).  The data is
+   read in place, unless the cstructs are not adjacent in memory, in
+   which case they are first gathered in one block.  The offsets and
+   lengths are checked by the OCaml side. */
+
+CAMLprim value caml_input_value_from_bigarray(value ba, value ofs, value len)
+{
+  CAMLparam1 (ba);
+  CAMLlocal1 (obj);
+
+  obj = caml_input_value_from_block((char *) Caml_ba_data_val(ba)
+                                    + Long_val(ofs), Long_val(len));
+  CAMLreturn (obj);
+}
+
+CAMLprim value caml_input_value_from_cstructs(value bufs)
+{
+  CAMLparam1 (bufs);
+  CAMLlocal1 (obj);
+  value l, c;
+  char * start, * end, * data, * block;
+  intnat len, total;
+  int adjacent;
+  uint32 magic;
+  mlsize_t block_len;
+
+  if (bufs == Val_emptylist)
+    caml_failwith("input_value_from_cstructs: empty input");
+  start = end = NULL;
+  total = 0;
+  adjacent = 1;
+  for (l = bufs; l != Val_emptylist; l = Field(l, 1)) {
+    c = Field(l, 0);
+    data = (char *) Caml_ba_data_val(Field(c, 0)) + Long_val(Field(c, 1));
+    len = Long_val(Field(c, 2));
+    if (start == NULL) start = data;
+    else if (data != end) adjacent = 0;
+    end = data + len;
+    total += len;
+  }
+  if (adjacent) {
+    obj = caml_input_value_from_block(start, total);
+    CAMLreturn (obj);
+  }
+  block = caml_stat_alloc(total);
+  for (data = block, l = bufs; l != Val_emptylist; l = Field(l, 1)) {
+    c = Field(l, 0);
+    len = Long_val(Field(c, 2));
+    memmove(data,
+            (char *) Caml_ba_data_val(Field(c, 0)) + Long_val(Field(c, 1)),
+            len);
+    data += len;
+  }
+  intern_src = (unsigned char *) block;
+  intern_input_malloced = 0;
+  magic = total < 5*4 ? 0 : read32u();
+  block_len = total < 5*4 ? 0 : read32u();
+  if (magic != Intext_magic_number || 5*4 + block_len > total) {
+    caml_stat_free(block);
+    caml_failwith("input_value_from_cstructs: bad object");
+  }
+  obj = caml_input_value_from_malloc(block, 0);
+  CAMLreturn (obj);
+}
+
 CAMLprim value caml_marshal_data_size(value buff, value ofs)
 {
   uint32 magic;
@@ -13,6 +13,7 @@
 
 /* The table-driven automaton for lexers generated by camllex. */
 
+#include "bigarray.h"
 #include "fail.h"
 #include "mlvalues.h"
 #include "stacks.h"
@@ -54,8 +55,13 @@ struct lexing_table {
 #define Short(tbl,n) (((short *)(tbl))[(n)])
 #endif
 
-CAMLprim value caml_lex_engine(struct lexing_table *tbl, value start_state,
-                               struct lexer_buffer *lexbuf)
+/* The engines read the input from [buf], which is the contents of
+   [lexbuf->lex_buffer]: either a string (for Lexing) or a bigarray (for
+   lexers that work in place on I/O pages).  The positions in [lexbuf]
+   are offsets in [buf]; the table format is the same in both cases. */
+
+static value lex_engine(struct lexing_table *tbl, value start_state,
+                        struct lexer_buffer *lexbuf, unsigned char *buf)
 {
   int state, base, backtrk, c;
 
@@ -87,7 +93,7 @@ CAMLprim value caml_lex_engine(struct lexing_table *tbl, value start_state,
       }
     }else{
       /* Read next input char */
-      c = Byte_u(lexbuf->lex_buffer, Long_val(lexbuf->lex_curr_pos));
+      c = buf[Long_val(lexbuf->lex_curr_pos)];
       lexbuf->lex_curr_pos += 2;
     }
     /* Determine next state */
@@ -152,8 +158,8 @@ static void run_tag(char *pc, value mem) {
   }
 }
 
-CAMLprim value caml_new_lex_engine(struct lexing_table *tbl, value start_state,
-                                   struct lexer_buffer *lexbuf)
+static value new_lex_engine(struct lexing_table *tbl, value start_state,
+                            struct lexer_buffer *lexbuf, unsigned char *buf)
 {
   int state, base, backtrk, c, pstate ;
   state = Int_val(start_state);
@@ -192,7 +198,7 @@ CAMLprim value caml_new_lex_engine(struct lexing_table *tbl, value start_state,
       }
     }else{
       /* Read next input char */
-      c = Byte_u(lexbuf->lex_buffer, Long_val(lexbuf->lex_curr_pos));
+      c = buf[Long_val(lexbuf->lex_curr_pos)];
       lexbuf->lex_curr_pos += 2;
     }
     /* Determine next state */
@@ -227,3 +233,34 @@ CAMLprim value caml_new_lex_engine(struct lexing_table *tbl, value start_state,
     }
   }
 }
+
+CAMLprim value caml_lex_engine(struct lexing_table *tbl, value start_state,
+                               struct lexer_buffer *lexbuf)
+{
+  return lex_engine(tbl, start_state, lexbuf, &Byte_u(lexbuf->lex_buffer, 0));
+}
+
+CAMLprim value caml_new_lex_engine(struct lexing_table *tbl, value start_state,
+                                   struct lexer_buffer *lexbuf)
+{
+  return new_lex_engine(tbl, start_state, lexbuf,
+                        &Byte_u(lexbuf->lex_buffer, 0));
+}
+
+/* Same, for a lexbuf whose [lex_buffer] field is a char bigarray. */
+
+CAMLprim value caml_lex_engine_bigarray(struct lexing_table *tbl,
+                                        value start_state,
+                                        struct lexer_buffer *lexbuf)
+{
+  return lex_engine(tbl, start_state, lexbuf,
+                    Caml_ba_data_val(lexbuf->lex_buffer));
+}
+
+CAMLprim value caml_new_lex_engine_bigarray(struct lexing_table *tbl,
+                                            value start_state,
+                                            struct lexer_buffer *lexbuf)
+{
+  return new_lex_engine(tbl, start_state, lexbuf,
+                        Caml_ba_data_val(lexbuf->lex_buffer));
+}
@@ -12,6 +12,7 @@
 /***********************************************************************/
 
 #include <limits.h>
+#include <string.h>
 
 #include "compact.h"
 #include "custom.h"
@@ -21,7 +22,10 @@
 #include "freelist.h"
 #include "gc.h"
 #include "gc_ctrl.h"
+#include "gc_events.h"
 #include "major_gc.h"
+#include "memory.h"
+#include "memprof.h"
 #include "misc.h"
 #include "mlvalues.h"
 #include "roots.h"
@@ -31,28 +35,101 @@ uintnat caml_percent_free;
 uintnat caml_major_heap_increment;
 CAMLexport char *caml_heap_start;
 char *caml_gc_sweep_hp;
-int caml_gc_phase;        /* always Phase_mark, Phase_sweep, or Phase_idle */
+int caml_gc_phase;        /* Phase_mark, Phase_evacuate, Phase_sweep, or
+                             Phase_idle */
 static value *gray_vals;
 static value *gray_vals_cur, *gray_vals_end;
 static asize_t gray_vals_size;
-static int heap_is_pure;   /* The heap is pure if the only gray objects
-                              below [markhp] are also in [gray_vals]. */
+static int heap_is_pure;   /* The heap is pure if the gray objects that
+                              are not in [gray_vals] will be found by the
+                              current scan of the redarken ranges. */
 uintnat caml_allocated_words;
 uintnat caml_dependent_size, caml_dependent_allocated;
 double caml_extra_heap_resources;
 uintnat caml_fl_size_at_phase_change = 0;
 
 extern char *caml_fl_merge;  /* Defined in freelist.c. */
+extern void caml_shrink_heap (char *);              /* memory.c */
 
 static char *markhp, *chunk, *limit;
+static char *retired_free;  /* Last free block of the retired chunk. */
 
-int caml_gc_subphase;     /* Subphase_{main,weak1,weak2,final} */
+static void sweep_enter_chunk (void);
+static void start_sweep (void);
+
+int caml_gc_subphase;     /* Subphase_{main,ephe,weak1,weak2,final} */
 static value *weak_prev;
+static value *ephe_prev;
+static int ephe_progress;  /* Some data was darkened by this pass. */
 
 #ifdef DEBUG
 static unsigned long major_gc_counter = 0;
 #endif
 
+/* Prefetch the header of a block that will be examined soon. */
+#if defined(__GNUC__)
+#define Prefetch(p) __builtin_prefetch ((p), 1, 3)
+#else
+#define Prefetch(p)
+#endif
+
+/* Record that the gray block [hp] of chunk [c] is no longer in
+   [gray_vals]. */
+static void redarken_block (char *c, char *hp)
+{
+  char *end = hp + Bhsize_hp (hp);
+
+  if (Chunk_redarken_end (c) == NULL){
+    Chunk_redarken_first (c) = hp;
+    Chunk_redarken_end (c) = end;
+  }else{
+    if (hp < Chunk_redarken_first (c)) Chunk_redarken_first (c) = hp;
+    if (end > Chunk_redarken_end (c)) Chunk_redarken_end (c) = end;
+  }
+}
+
+/* Mark stack overflow: drop the older half of [gray_vals].  The dropped
+   blocks stay gray, and the range they span in each chunk is recorded,
+   so that [mark_slice] only has to scan these ranges to find them
+   again instead of the whole heap. */
+static void prune_gray_vals (void)
+{
+  asize_t n = gray_vals_size / 2, nchunks = 0, lo, hi, mid;
+  char **chunks, *c;
+  value *p;
+
+  caml_gc_message (0x08, "Mark stack overflow\n", 0);
+  for (c = caml_heap_start; c != NULL; c = Chunk_next (c)) ++ nchunks;
+  chunks = (char **) malloc (nchunks * sizeof (char *));
+  if (chunks == NULL){
+    for (c = caml_heap_start; c != NULL; c = Chunk_next (c)){
+      Chunk_redarken_first (c) = c;
+      Chunk_redarken_end (c) = c + Chunk_size (c);
+    }
+  }else{
+    nchunks = 0;
+    for (c = caml_heap_start; c != NULL; c = Chunk_next (c)){
+      chunks[nchunks++] = c;                   /* sorted by address */
+    }
+    for (p = gray_vals; p < gray_vals + n; p++){
+      lo = 0;
+      hi = nchunks;
+      while (hi - lo > 1){
+        mid = (lo + hi) / 2;
+        if (chunks[mid] <= Hp_val (*p)) lo = mid; else hi = mid;
+      }
+      Assert (Hp_val (*p) < chunks[lo] + Chunk_size (chunks[lo]));
+      redarken_block (chunks[lo], Hp_val (*p));
+    }
+    free (chunks);
+  }
+  memmove (gray_vals, gray_vals + n, (gray_vals_size - n) * sizeof (value));
+  gray_vals_cur = gray_vals + (gray_vals_size - n);
+  heap_is_pure = 0;
+}
+
+/* [gray_vals] is full.  It grows by doubling up to 1/16 of the heap
+   size; beyond that, it is pruned. */
 static void realloc_gray_vals (void)
 {
   value *new;
@@ -66,8 +143,7 @@ static void realloc_gray_vals (void)
                              2 * gray_vals_size * sizeof (value));
     if (new == NULL){
       caml_gc_message (0x08, "No room for growing gray_vals\n", 0);
-      gray_vals_cur = gray_vals;
-      heap_is_pure = 0;
+      prune_gray_vals ();
     }else{
       gray_vals = new;
       gray_vals_cur = gray_vals + gray_vals_size;
@@ -75,9 +151,57 @@ static void realloc_gray_vals (void)
       gray_vals_end = gray_vals + gray_vals_size;
     }
   }else{
-    gray_vals_cur = gray_vals + gray_vals_size / 2;
-    heap_is_pure = 0;
+    prune_gray_vals ();
+  }
+}
+
+/* Scan the redarken range of [c], or of the first chunk after it that
+   has one.  Set [markhp] to NULL if there is none. */
+static void redarken_chunk (char *c)
+{
+  while (c != NULL && Chunk_redarken_end (c) == NULL) c = Chunk_next (c);
+  chunk = c;
+  if (c == NULL){
+    markhp = NULL;
+  }else{
+    markhp = Chunk_redarken_first (c);
+    limit = Chunk_redarken_end (c);
+    Chunk_redarken_first (c) = Chunk_redarken_end (c) = NULL;
+  }
+}
+
+/* Darken [child], found in the field [*p] of a block being marked, and
+   short-circuit [*p] if [child] is a forward block.  Return the new top
+   of the mark stack. */
+static value *mark_child (value child, value *p, value *gray_vals_ptr)
+{
+  header_t hd = Hd_val (child);
+
+  if (Tag_hd (hd) == Forward_tag){
+    value f = Forward_val (child);
+    if (Is_block (f)
+        && (!Is_in_value_area(f) || Tag_val (f) == Forward_tag
+            || Tag_val (f) == Lazy_tag || Tag_val (f) == Double_tag)){
+      /* Do not short-circuit the pointer. */
+    }else{
+      *p = f;
+      Evac_record (p, f);
+    }
+  }
+  else if (Tag_hd(hd) == Infix_tag) {
+    child -= Infix_offset_val(child);
+    hd = Hd_val(child);
   }
+  if (Is_white_hd (hd)){
+    Hd_val (child) = Grayhd_hd (hd);
+    *gray_vals_ptr++ = child;
+    if (gray_vals_ptr >= gray_vals_end) {
+      gray_vals_cur = gray_vals_ptr;
+      realloc_gray_vals ();
+      gray_vals_ptr = gray_vals_cur;
+    }
+  }
+  return gray_vals_ptr;
 }
 
 void caml_darken (value v, value *p /* not used */)
@@ -108,6 +232,7 @@ static void start_cycle (void)
   Assert (caml_gc_phase == Phase_idle);
   Assert (gray_vals_cur == gray_vals);
   caml_gc_message (0x01, "Starting new major GC cycle\n", 0);
+  caml_evac_begin ();
   caml_darken_all_roots();
   caml_gc_phase = Phase_mark;
   caml_gc_subphase = Subphase_main;
@@ -118,12 +243,20 @@ static void start_cycle (void)
 #endif
 }
 
+/* Size of the prefetch FIFO: a child is examined [Pb_size] pointers
+   after its header was prefetched.  Must be a power of 2. */
+#define Pb_size 8
+#define Pb_mask (Pb_size - 1)
+
 static void mark_slice (intnat work)
 {
   value *gray_vals_ptr;  /* Local copy of gray_vals_cur */
   value v, child;
   header_t hd;
   mlsize_t size, i;
+  value pb_child [Pb_size];     /* Prefetch FIFO: children found and */
+  value *pb_field [Pb_size];    /*  the fields that point to them */
+  unsigned int pb_in = 0, pb_out = 0;
 
   caml_gc_message (0x40, "Marking %ld words\n", work);
   caml_gc_message (0x40, "Subphase = %ld\n", caml_gc_subphase);
@@ -139,43 +272,30 @@ static void mark_slice (intnat work)
         for (i = 0; i < size; i++){
           child = Field (v, i);
           if (Is_block (child) && Is_in_heap (child)) {
-            hd = Hd_val (child);
-            if (Tag_hd (hd) == Forward_tag){
-              value f = Forward_val (child);
-              if (Is_block (f)
-                  && (!Is_in_value_area(f) || Tag_val (f) == Forward_tag
-                      || Tag_val (f) == Lazy_tag || Tag_val (f) == Double_tag)){
-                /* Do not short-circuit the pointer. */
-              }else{
-                Field (v, i) = f;
-              }
-            }
-            else if (Tag_hd(hd) == Infix_tag) {
-              child -= Infix_offset_val(child);
-              hd = Hd_val(child);
-            }
-            if (Is_white_hd (hd)){
-              Hd_val (child) = Grayhd_hd (hd);
-              *gray_vals_ptr++ = child;
-              if (gray_vals_ptr >= gray_vals_end) {
-                gray_vals_cur = gray_vals_ptr;
-                realloc_gray_vals ();
-                gray_vals_ptr = gray_vals_cur;
-              }
+            /* Every live pointer into a chunk being evacuated is
+               recorded here or by the write barrier. */
+            Evac_record (&Field (v, i), child);
+            Prefetch (Hp_val (child));
+            if (pb_in - pb_out == Pb_size){
+              gray_vals_ptr = mark_child (pb_child[pb_out & Pb_mask],
+                                          pb_field[pb_out & Pb_mask],
+                                          gray_vals_ptr);
+              ++ pb_out;
             }
+            pb_child[pb_in & Pb_mask] = child;
+            pb_field[pb_in & Pb_mask] = &Field (v, i);
+            ++ pb_in;
           }
         }
       }
       work -= Whsize_wosize(size);
+    }else if (pb_out != pb_in){
+      gray_vals_ptr = mark_child (pb_child[pb_out & Pb_mask],
+                                  pb_field[pb_out & Pb_mask], gray_vals_ptr);
+      ++ pb_out;
     }else if (markhp != NULL){
       if (markhp == limit){
-        chunk = Chunk_next (chunk);
-        if (chunk == NULL){
-          markhp = NULL;
-        }else{
-          markhp = chunk;
-          limit = chunk + Chunk_size (chunk);
-        }
+        redarken_chunk (Chunk_next (chunk));
       }else{
         if (Is_gray_val (Val_hp (markhp))){
           Assert (gray_vals_ptr == gray_vals);
@@ -185,16 +305,43 @@ static void mark_slice (intnat work)
       }
     }else if (!heap_is_pure){
       heap_is_pure = 1;
-      chunk = caml_heap_start;
-      markhp = chunk;
-      limit = chunk + Chunk_size (chunk);
+      redarken_chunk (caml_heap_start);
     }else{
       switch (caml_gc_subphase){
       case Subphase_main: {
-        /* The main marking phase is over.  Start removing weak pointers to
-           dead values. */
-        caml_gc_subphase = Subphase_weak1;
-        weak_prev = &caml_weak_list_head;
+        /* The main marking phase is over.  Mark the data of the live
+           ephemerons whose key is live. */
+        caml_gc_subphase = Subphase_ephe;
+        ephe_prev = &caml_ephe_list_head;
+        ephe_progress = 0;
+      }
+        break;
+      case Subphase_ephe: {
+        value cur;
+
+        /* Marking the data may make other keys live: repeat until a
+           whole pass over the list marks nothing. */
+        cur = *ephe_prev;
+        if (cur != (value) NULL){
+          if (Is_black_val (cur)
+              && !caml_ephe_is_white (Field (cur, Ephe_key))
+              && caml_ephe_is_white (Field (cur, Ephe_data))){
+            gray_vals_cur = gray_vals_ptr;
+            caml_darken (Field (cur, Ephe_data), NULL);
+            gray_vals_ptr = gray_vals_cur;
+            ephe_progress = 1;
+          }
+          ephe_prev = &Field (cur, 0);
+          work -= Ephe_size;
+        }else if (ephe_progress){
+          ephe_prev = &caml_ephe_list_head;
+          ephe_progress = 0;
+        }else{
+          /* Start removing weak pointers to dead values. */
+          caml_gc_subphase = Subphase_weak1;
+          weak_prev = &caml_weak_list_head;
+          ephe_prev = &caml_ephe_list_head;
+        }
       }
         break;
       case Subphase_weak1: {
@@ -203,7 +350,30 @@ static void mark_slice (intnat work)
         header_t hd;
 
         cur = *weak_prev;
-        if (cur != (value) NULL){
+        if (cur == (value) NULL && *ephe_prev != (value) NULL){
+          /* The weak arrays are done, clean the ephemerons.  A dead key
+             releases the data.  A live key whose data is not marked was
+             revived by [caml_ephe_get_key] after its ephemeron was
+             examined: mark the data now, unless the ephemeron is dead. */
+          cur = *ephe_prev;
+          if (caml_ephe_is_white (Field (cur, Ephe_key))){
+            Field (cur, Ephe_key) = caml_weak_none;
+            Field (cur, Ephe_data) = caml_weak_none;
+          }else if (caml_ephe_is_white (Field (cur, Ephe_data))){
+            if (Is_black_val (cur)){
+              gray_vals_cur = gray_vals_ptr;
+              caml_darken (Field (cur, Ephe_data), NULL);
+              gray_vals_ptr = gray_vals_cur;
+            }else{
+              Field (cur, Ephe_data) = caml_weak_none;
+            }
+          }
+          /* The fields of ephemerons are not marked: record them. */
+          Evac_record (&Field (cur, Ephe_key), Field (cur, Ephe_key));
+          Evac_record (&Field (cur, Ephe_data), Field (cur, Ephe_data));
+          ephe_prev = &Field (cur, 0);
+          work -= Ephe_size;
+        }else if (cur != (value) NULL){
           hd = Hd_val (cur);
           sz = Wosize_hd (hd);
           for (i = 1; i < sz; i++){
@@ -225,6 +395,8 @@ static void mark_slice (intnat work)
               }
               if (Is_white_val (curfield)){
                 Field (cur, i) = caml_weak_none;
+              }else{
+                Evac_record (&Field (cur, i), curfield);
               }
             }
           }
@@ -238,6 +410,7 @@ static void mark_slice (intnat work)
           gray_vals_ptr = gray_vals_cur;
           caml_gc_subphase = Subphase_weak2;
           weak_prev = &caml_weak_list_head;
+          ephe_prev = &caml_ephe_list_head;
         }
       }
         break;
@@ -252,9 +425,21 @@ static void mark_slice (intnat work)
             /* The whole array is dead, remove it from the list. */
             *weak_prev = Field (cur, 0);
           }else{
+            Evac_record (weak_prev, cur);
+            if (Is_evacuating (cur)) caml_evac_weak (cur);
             weak_prev = &Field (cur, 0);
           }
           work -= 1;
+        }else if (*ephe_prev != (value) NULL){
+          cur = *ephe_prev;
+          if (Is_white_val (cur)){
+            *ephe_prev = Field (cur, 0);
+          }else{
+            Evac_record (ephe_prev, cur);
+            if (Is_evacuating (cur)) caml_evac_weak (cur);
+            ephe_prev = &Field (cur, 0);
+          }
+          work -= 1;
         }else{
           /* Subphase_weak2 is done.  Go to Subphase_final. */
           caml_gc_subphase = Subphase_final;
@@ -262,28 +447,131 @@ static void mark_slice (intnat work)
       }
         break;
       case Subphase_final: {
-        /* Initialise the sweep phase. */
+        /* Marking is done: evacuate the chunks selected for it, if
+           any, then sweep. */
         gray_vals_cur = gray_vals_ptr;
-        caml_gc_sweep_hp = caml_heap_start;
-        caml_fl_init_merge ();
-        caml_gc_phase = Phase_sweep;
-        chunk = caml_heap_start;
-        caml_gc_sweep_hp = chunk;
-        limit = chunk + Chunk_size (chunk);
+        if (caml_evac_start != NULL){
+          caml_gc_phase = Phase_evacuate;
+        }else{
+          start_sweep ();
+        }
         work = 0;
-        caml_fl_size_at_phase_change = caml_fl_cur_size;
       }
         break;
       default: Assert (0);
       }
     }
   }
+  /* Do not leave discovered children unmarked between slices. */
+  while (pb_out != pb_in){
+    gray_vals_ptr = mark_child (pb_child[pb_out & Pb_mask],
+                                pb_field[pb_out & Pb_mask], gray_vals_ptr);
+    ++ pb_out;
+  }
   gray_vals_cur = gray_vals_ptr;
 }
 
+/* Initialise the sweep phase. */
+static void start_sweep (void)
+{
+  caml_fl_init_merge ();
+  caml_gc_phase = Phase_sweep;
+  chunk = caml_heap_start;
+  caml_gc_sweep_hp = chunk;
+  limit = chunk + Chunk_size (chunk);
+  sweep_enter_chunk ();
+  caml_fl_size_at_phase_change = caml_fl_cur_size;
+}
+
+/* Called when the sweeper enters a new chunk.  A chunk selected for
+   evacuation is retired: its free blocks are taken out of the free
+   list, so that nothing new is allocated in it before the next cycle
+   evacuates it. */
+static void sweep_enter_chunk (void)
+{
+  Chunk_live (chunk) = 0;
+  retired_free = NULL;
+  if (Chunk_evac (chunk) == Evac_pending){
+    caml_fl_detach (chunk, limit);
+    Chunk_evac (chunk) = Evac_retired;
+  }
+}
+
+/* Sweep a block of a retired chunk: dead blocks become free but they are
+   not given to the free list.  Adjacent free blocks and fragments are
+   merged. */
+static void sweep_retired_block (char *hp, header_t hd)
+{
+  switch (Color_hd (hd)){
+  case Caml_white:
+    if (Tag_hd (hd) == Custom_tag){
+      void (*final_fun)(value) = Custom_ops_val(Val_hp(hp))->finalize;
+      if (final_fun != NULL) final_fun(Val_hp(hp));
+    }
+    if (caml_memprof_major_tracked) caml_memprof_free_major (Val_hp (hp));
+    /* fall through */
+  case Caml_blue:
+    if (retired_free != NULL && retired_free + Bhsize_hp (retired_free) == hp
+        && Wosize_hp (retired_free) + Whsize_hd (hd) <= Max_wosize){
+      Hd_hp (retired_free) = Make_header (Wosize_hp (retired_free)
+                                        + Whsize_hd (hd),
+                                        Abstract_tag, Caml_blue);
+    }else{
+      /* Fragments stay white, but later blocks can be merged into them. */
+      Hd_hp (hp) = Make_header (Wosize_hd (hd), Abstract_tag,
+                                Wosize_hd (hd) == 0 ? Caml_white : Caml_blue);
+      retired_free = hp;
+    }
+    break;
+  default:          /* gray or black */
+    Assert (Color_hd (hd) == Caml_black);
+    Hd_hp (hp) = Whitehd_hd (hd);
+    Chunk_live (chunk) += Whsize_hd (hd);
+    retired_free = NULL;
+    break;
+  }
+}
+
+/* Sweep the block of a large chunk; the rest of the chunk is skipped.
+   A large chunk holds a single object (see [caml_alloc_shr_no_large]);
+   anything after it is the abstract tail left by [Obj.truncate]. */
+static void sweep_large_block (char *hp, header_t hd)
+{
+  if (Color_hd (hd) == Caml_white){
+    if (Tag_hd (hd) == Custom_tag){
+      void (*final_fun)(value) = Custom_ops_val(Val_hp(hp))->finalize;
+      if (final_fun != NULL) final_fun(Val_hp(hp));
+    }
+    if (caml_memprof_major_tracked) caml_memprof_free_major (Val_hp (hp));
+  }else{
+    Assert (Color_hd (hd) == Caml_black);
+    Hd_hp (hp) = Whitehd_hd (hd);
+    Chunk_live (chunk) = Whsize_hd (hd);
+  }
+  caml_gc_sweep_hp = limit;
+}
+
+/* Called when the sweeper leaves a chunk.  A large chunk whose block is
+   dead is freed, and so is a retired chunk that has no live block left:
+   there is nothing to evacuate.  A chunk that could not be evacuated
+   rests for a cycle. */
+static void sweep_leave_chunk (void)
+{
+  if (Chunk_large (chunk)){
+    if (Chunk_live (chunk) == 0) caml_free_large (chunk);
+  }else if (Chunk_evac (chunk) == Evac_retired){
+    if (Chunk_live (chunk) == 0 && chunk != caml_heap_start){
+      ++ caml_stat_evacuated_chunks;
+      caml_shrink_heap (chunk);
+    }
+  }else if (Chunk_evac (chunk) < Evac_none){
+    ++ Chunk_evac (chunk);
+  }
+}
+
 static void sweep_slice (intnat work)
 {
-  char *hp;
+  char *hp, *next;
   header_t hd;
 
   caml_gc_message (0x40, "Sweeping %ld words\n", work);
@@ -293,13 +581,26 @@ static void sweep_slice (intnat work)
       hd = Hd_hp (hp);
       work -= Whsize_hd (hd);
       caml_gc_sweep_hp += Bhsize_hd (hd);
+      if (Chunk_large (chunk)){
+        work -= Wsize_bsize (limit - caml_gc_sweep_hp);
+        sweep_large_block (hp, hd);
+        continue;
+      }
+      if (Chunk_evac (chunk) == Evac_retired){
+        sweep_retired_block (hp, hd);
+        continue;
+      }
       switch (Color_hd (hd)){
       case Caml_white:
         if (Tag_hd (hd) == Custom_tag){
           void (*final_fun)(value) = Custom_ops_val(Val_hp(hp))->finalize;
           if (final_fun != NULL) final_fun(Val_hp(hp));
         }
-        caml_gc_sweep_hp = caml_fl_merge_block (Bp_hp (hp));
+        if (caml_memprof_major_tracked) caml_memprof_free_major (Val_hp (hp));
+        /* The merge also skips the free blocks that follow: count them. */
+        next = caml_fl_merge_block (Bp_hp (hp), limit);
+        work -= Wsize_bsize (next - caml_gc_sweep_hp);
+        caml_gc_sweep_hp = next;
         break;
       case Caml_blue:
         /* Only the blocks of the free-list are blue.  See [freelist.c]. */
@@ -308,24 +609,68 @@ static void sweep_slice (intnat work)
       default:          /* gray or black */
         Assert (Color_hd (hd) == Caml_black);
         Hd_hp (hp) = Whitehd_hd (hd);
+        Chunk_live (chunk) += Whsize_hd (hd);
         break;
       }
       Assert (caml_gc_sweep_hp <= limit);
     }else{
-      chunk = Chunk_next (chunk);
+      next = Chunk_next (chunk);
+      sweep_leave_chunk ();
+      chunk = next;
       if (chunk == NULL){
         /* Sweeping is done. */
         ++ caml_stat_major_collections;
         work = 0;
         caml_gc_phase = Phase_idle;
+        caml_evac_select ();
       }else{
         caml_gc_sweep_hp = chunk;
         limit = chunk + Chunk_size (chunk);
+        sweep_enter_chunk ();
       }
     }
   }
 }
 
+/* Lazy sweeping: sweep at most [Lazy_sweep_quantum] words, without
+   going past the end of the current chunk, or of the next one if the
+   current chunk is done.  This is called by [caml_alloc_shr] when the
+   free list cannot satisfy a request during the sweep phase, so that
+   the memory that is about to be freed is used before the heap is
+   expanded, and by the scheduler when the domain is idle.
+
+   The end of the last chunk is left to [caml_major_collection_slice],
+   which ends the cycle and decides on compaction: [sweep_slice] counts
+   every word it passes, so a budget of the words left in the chunk
+   stops it exactly at the limit.  Return 0 if there is nothing left to
+   sweep.
+
+   Sweeping runs the finalisers of custom blocks, so this must not be
+   called during a minor collection: a finaliser may remove a global
+   root while the minor GC is scanning them. */
+#define Lazy_sweep_quantum 16384
+
+int caml_sweep_lazily (void)
+{
+  intnat work;
+  uint64_t start;
+
+  if (caml_gc_phase != Phase_sweep) return 0;
+  if (caml_gc_sweep_hp < limit){
+    work = Wsize_bsize (limit - caml_gc_sweep_hp);
+  }else if (Chunk_next (chunk) != NULL){
+    work = Wsize_bsize (Chunk_size (Chunk_next (chunk)));
+  }else{
+    return 0;
+  }
+  if (work > Lazy_sweep_quantum) work = Lazy_sweep_quantum;
+  start = caml_gc_clock ();
+  sweep_slice (work);
+  caml_gc_event (Gc_ev_major_slice, start, work);
+  Assert (caml_gc_phase == Phase_sweep);
+  return 1;
+}
+
 /* The main entry point for the GC.  Called after each minor GC.
    [howmuch] is the amount of work to do, 0 to let the GC compute it.
    Return the computed amount of work to do.
@@ -334,6 +679,7 @@ intnat caml_major_collection_slice (intnat howmuch)
 {
   double p, dp;
   intnat computed_work;
+  uint64_t start;
   /*
      Free memory at the start of the GC cycle (garbage + free list) (assumed):
                  FM = caml_stat_heap_size * caml_percent_free
@@ -410,9 +756,14 @@ intnat caml_major_collection_slice (intnat howmuch)
   caml_gc_message (0x40, "ordered work = %ld words\n", howmuch);
   caml_gc_message (0x40, "computed work = %ld words\n", computed_work);
   if (howmuch == 0) howmuch = computed_work;
+  start = caml_gc_clock ();
   if (caml_gc_phase == Phase_mark){
     mark_slice (howmuch);
     caml_gc_message (0x02, "!", 0);
+  }else if (caml_gc_phase == Phase_evacuate){
+    /* Evacuation is bounded by time, not by the amount of work. */
+    if (!caml_evac_slice (caml_evacuation_pause)) start_sweep ();
+    caml_gc_message (0x02, "&", 0);
   }else{
     Assert (caml_gc_phase == Phase_sweep);
     sweep_slice (howmuch);
@@ -420,6 +771,8 @@ intnat caml_major_collection_slice (intnat howmuch)
   }
 
   if (caml_gc_phase == Phase_idle) caml_compact_heap_maybe ();
+  /* After the compaction, which is part of the same pause. */
+  caml_gc_event (Gc_ev_major_slice, start, howmuch);
 
   caml_stat_major_words += caml_allocated_words;
   caml_allocated_words = 0;
@@ -439,6 +792,10 @@ void caml_finish_major_cycle (void)
 {
   if (caml_gc_phase == Phase_idle) start_cycle ();
   while (caml_gc_phase == Phase_mark) mark_slice (LONG_MAX);
+  if (caml_gc_phase == Phase_evacuate){
+    while (caml_evac_slice (0));
+    start_sweep ();
+  }
   Assert (caml_gc_phase == Phase_sweep);
   while (caml_gc_phase == Phase_sweep) sweep_slice (LONG_MAX);
   Assert (caml_gc_phase == Phase_idle);
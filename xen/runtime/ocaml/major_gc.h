@@ -23,12 +23,29 @@ typedef struct {
   asize_t alloc;         /* in bytes, used for compaction */
   asize_t size;          /* in bytes */
   char *next;
+  asize_t live;          /* in words, as found by the last sweep */
+  intnat evac;           /* evacuation state, see [compact.c] */
+  char *redarken_first;  /* gray blocks dropped from the mark stack, */
+  char *redarken_end;    /*   see [major_gc.c]; NULL end: none */
+  intnat large;          /* holds a single large block, see [memory.c] */
 } heap_chunk_head;
 
 #define Chunk_size(c) (((heap_chunk_head *) (c)) [-1]).size
 #define Chunk_alloc(c) (((heap_chunk_head *) (c)) [-1]).alloc
 #define Chunk_next(c) (((heap_chunk_head *) (c)) [-1]).next
 #define Chunk_block(c) (((heap_chunk_head *) (c)) [-1]).block
+#define Chunk_live(c) (((heap_chunk_head *) (c)) [-1]).live
+#define Chunk_evac(c) (((heap_chunk_head *) (c)) [-1]).evac
+#define Chunk_redarken_first(c) (((heap_chunk_head *) (c)) [-1]).redarken_first
+#define Chunk_redarken_end(c) (((heap_chunk_head *) (c)) [-1]).redarken_end
+#define Chunk_large(c) (((heap_chunk_head *) (c)) [-1]).large
+
+/* Values of [Chunk_evac]; a negative value is the number of major cycles
+   a chunk that could not be evacuated rests before it can be selected
+   again. */
+#define Evac_none 0       /* in service */
+#define Evac_pending 1    /* selected: the next sweep retires it */
+#define Evac_retired 2    /* out of service: the next cycle evacuates it */
 
 extern int caml_gc_phase;
 extern int caml_gc_subphase;
@@ -40,10 +57,12 @@ extern uintnat caml_fl_size_at_phase_change;
 #define Phase_mark 0
 #define Phase_sweep 1
 #define Phase_idle 2
+#define Phase_evacuate 3
 #define Subphase_main 10
 #define Subphase_weak1 11
 #define Subphase_weak2 12
 #define Subphase_final 13
+#define Subphase_ephe 14
 
 CAMLextern char *caml_heap_start;
 extern uintnat total_heap_size;
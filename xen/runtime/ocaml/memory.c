@@ -17,9 +17,11 @@
 #include "freelist.h"
 #include "gc.h"
 #include "gc_ctrl.h"
+#include "gc_events.h"
 #include "major_gc.h"
 #include "memory.h"
 #include "major_gc.h"
+#include "memprof.h"
 #include "minor_gc.h"
 #include "misc.h"
 #include "mlvalues.h"
@@ -27,6 +29,11 @@
 
 extern uintnat caml_percent_free;                   /* major_gc.c */
 
+#ifdef SYS_xen
+extern char *caml_heap_region_alloc (asize_t);      /* heap_region.c */
+extern int caml_heap_region_free (char *, asize_t); /* heap_region.c */
+#endif
+
 /* Page table management */
 
 #define Page(p) ((uintnat) (p) >> Page_log)
@@ -228,12 +235,32 @@ char *caml_alloc_for_heap (asize_t request)
   char *mem;
   void *block;
                                               Assert (request % Page_size == 0);
+#ifdef SYS_xen
+  /* Take the chunk from the reserved heap region if possible.  The head
+     goes at the end of an extra leading page so that the chunk itself
+     stays page-aligned. */
+  block = caml_heap_region_alloc (request + Page_size);
+  if (block != NULL){
+    mem = (char *) block + Page_size;
+    Chunk_size (mem) = request;
+    Chunk_block (mem) = block;
+    Chunk_live (mem) = Wsize_bsize (request);
+    Chunk_evac (mem) = Evac_none;
+    Chunk_redarken_first (mem) = Chunk_redarken_end (mem) = NULL;
+    Chunk_large (mem) = 0;
+    return mem;
+  }
+#endif
   mem = caml_aligned_malloc (request + sizeof (heap_chunk_head),
                              sizeof (heap_chunk_head), &block);
   if (mem == NULL) return NULL;
   mem += sizeof (heap_chunk_head);
   Chunk_size (mem) = request;
   Chunk_block (mem) = block;
+  Chunk_live (mem) = Wsize_bsize (request);
+  Chunk_evac (mem) = Evac_none;
+  Chunk_redarken_first (mem) = Chunk_redarken_end (mem) = NULL;
+  Chunk_large (mem) = 0;
   return mem;
 }
 
@@ -242,6 +269,10 @@ char *caml_alloc_for_heap (asize_t request)
 */
 void caml_free_for_heap (char *mem)
 {
+#ifdef SYS_xen
+  if (caml_heap_region_free (Chunk_block (mem), Chunk_size (mem) + Page_size)
+      == 0) return;
+#endif
   free (Chunk_block (mem));
 }
 
@@ -305,6 +336,7 @@ static char *expand_heap (mlsize_t request)
 {
   char *mem, *hp, *prev;
   asize_t over_request, malloc_request, remain;
+  uint64_t start = caml_gc_clock ();
 
   Assert (request <= Max_wosize);
   over_request = request + request / 100 * caml_percent_free;
@@ -343,6 +375,7 @@ static char *expand_heap (mlsize_t request)
     caml_free_for_heap (mem);
     return NULL;
   }
+  caml_gc_event (Gc_ev_heap_growth, start, Wsize_bsize (malloc_request));
   return Bp_hp (mem);
 }
 
@@ -358,8 +391,9 @@ void caml_shrink_heap (char *chunk)
      want to shift the page table, it's too messy (see above).
      It will never happen anyway, because of the way compaction works.
      (see compact.c)
+     Large chunks are the exception: they are never compacted.
   */
-  if (chunk == caml_heap_start) return;
+  if (chunk == caml_heap_start && !Chunk_large (chunk)) return;
 
   caml_stat_heap_size -= Chunk_size (chunk);
   caml_gc_message (0x04, "Shrinking heap to %luk bytes\n",
@@ -388,9 +422,68 @@ void caml_shrink_heap (char *chunk)
   caml_free_for_heap (chunk);
 }
 
+/* Large-object space.  A block of at least [caml_large_wosize] words
+   that is a string, a float array or an ordinary block gets a heap
+   chunk of its own, rounded up to whole pages, instead of being
+   carved out of the free list.  Big buffers thus neither fragment the
+   free list nor make [expand_heap] add big chunks that stay mostly
+   free once they die.  The rest of the last page is a blue block that
+   is not in the free list, like the free blocks of retired chunks.
+
+   A large chunk is swept like any other, and given back as a whole by
+   [caml_free_large] when its block is dead.  Compaction leaves large
+   chunks where they are (see [compact.c]).  Other tags are excluded
+   because compaction must not meet weak arrays, ephemerons or closures
+   there. */
+uintnat caml_large_wosize = Wsize_bsize (Large_object_def);
+uintnat caml_large_chunks = 0, caml_large_bytes = 0;
+uintnat caml_large_allocated = 0, caml_large_freed = 0;
+
+#define Is_large_tag(t) ((t) == 0 || (t) == String_tag \
+                         || (t) == Double_array_tag)
+
+static char *alloc_large (mlsize_t wosize)
+{
+  asize_t size, rest;
+  char *mem, *tail;
+  uint64_t start = caml_gc_clock ();
+
+  size = (Bhsize_wosize (wosize) + Page_size - 1) / Page_size * Page_size;
+  mem = caml_alloc_for_heap (size);
+  if (mem == NULL) return NULL;
+  Chunk_large (mem) = 1;
+  Hd_hp (mem) = Make_header (wosize, 0, Caml_white);
+  rest = size - Bhsize_wosize (wosize);
+  if (rest > 0){
+    tail = mem + Bhsize_wosize (wosize);
+    Hd_hp (tail) = Make_header (Wosize_bhsize (rest), Abstract_tag,
+                                rest == sizeof (header_t) ? Caml_white
+                                                          : Caml_blue);
+  }
+  if (caml_add_to_heap (mem) != 0){
+    caml_free_for_heap (mem);
+    return NULL;
+  }
+  ++ caml_large_chunks;
+  ++ caml_large_allocated;
+  caml_large_bytes += size;
+  caml_gc_event (Gc_ev_heap_growth, start, Wsize_bsize (size));
+  return mem;
+}
+
+/* Called by the sweeper when the block of a large chunk is dead. */
+void caml_free_large (char *chunk)
+{
+  Assert (Chunk_large (chunk));
+  -- caml_large_chunks;
+  ++ caml_large_freed;
+  caml_large_bytes -= Chunk_size (chunk);
+  caml_shrink_heap (chunk);
+}
+
 color_t caml_allocation_color (void *hp)
 {
-  if (caml_gc_phase == Phase_mark
+  if (caml_gc_phase == Phase_mark || caml_gc_phase == Phase_evacuate
       || (caml_gc_phase == Phase_sweep && (addr)hp >= (addr)caml_gc_sweep_hp)){
     return Caml_black;
   }else{
@@ -401,20 +494,25 @@ color_t caml_allocation_color (void *hp)
   }
 }
 
-CAMLexport value caml_alloc_shr (mlsize_t wosize, tag_t tag)
+/* Return 0 if there is no memory for the block. */
+static value alloc_shr (mlsize_t wosize, tag_t tag, int large_ok)
 {
   char *hp, *new_block;
 
-  if (wosize > Max_wosize) caml_raise_out_of_memory ();
-  hp = caml_fl_allocate (wosize);
+  if (wosize > Max_wosize) return 0;
+  hp = NULL;
+  if (large_ok && caml_large_wosize != 0 && wosize >= caml_large_wosize
+      && Is_large_tag (tag)){
+    hp = alloc_large (wosize);
+  }
+  if (hp == NULL) hp = caml_fl_allocate (wosize);
+  /* Not while promoting: see [caml_sweep_lazily]. */
+  while (hp == NULL && !caml_in_minor_collection && caml_sweep_lazily ()){
+    hp = caml_fl_allocate (wosize);
+  }
   if (hp == NULL){
     new_block = expand_heap (wosize);
-    if (new_block == NULL) {
-      if (caml_in_minor_collection)
-        caml_fatal_error ("Fatal error: out of memory.\n");
-      else
-        caml_raise_out_of_memory ();
-    }
+    if (new_block == NULL) return 0;
     caml_fl_add_blocks (new_block);
     hp = caml_fl_allocate (wosize);
   }
@@ -422,7 +520,7 @@ CAMLexport value caml_alloc_shr (mlsize_t wosize, tag_t tag)
   Assert (Is_in_heap (Val_hp (hp)));
 
   /* Inline expansion of caml_allocation_color. */
-  if (caml_gc_phase == Phase_mark
+  if (caml_gc_phase == Phase_mark || caml_gc_phase == Phase_evacuate
       || (caml_gc_phase == Phase_sweep && (addr)hp >= (addr)caml_gc_sweep_hp)){
     Hd_hp (hp) = Make_header (wosize, tag, Caml_black);
   }else{
@@ -432,10 +530,6 @@ CAMLexport value caml_alloc_shr (mlsize_t wosize, tag_t tag)
     Hd_hp (hp) = Make_header (wosize, tag, Caml_white);
   }
   Assert (Hd_hp (hp) == Make_header (wosize, tag, caml_allocation_color (hp)));
-  caml_allocated_words += Whsize_wosize (wosize);
-  if (caml_allocated_words > Wsize_bsize (caml_minor_heap_size)){
-    caml_urge_major_slice ();
-  }
 #ifdef DEBUG
   {
     uintnat i;
@@ -447,6 +541,46 @@ CAMLexport value caml_alloc_shr (mlsize_t wosize, tag_t tag)
   return Val_hp (hp);
 }
 
+static value alloc_shr_checked (mlsize_t wosize, tag_t tag, int large_ok)
+{
+  value v = alloc_shr (wosize, tag, large_ok);
+
+  if (v == 0){
+    if (caml_in_minor_collection)
+      caml_fatal_error ("Fatal error: out of memory.\n");
+    else
+      caml_raise_out_of_memory ();
+  }
+  caml_allocated_words += Whsize_wosize (wosize);
+  if (caml_allocated_words > Wsize_bsize (caml_minor_heap_size)){
+    caml_urge_major_slice ();
+  }
+  if (!caml_in_minor_collection) caml_memprof_alloc_major (v);
+  return v;
+}
+
+CAMLexport value caml_alloc_shr (mlsize_t wosize, tag_t tag)
+{
+  return alloc_shr_checked (wosize, tag, 1);
+}
+
+/* The sweeper and the compactor expect a large chunk to hold a single
+   object.  A block that the caller will split into several objects
+   (see [intern_alloc]) must not go to the large-object space. */
+CAMLexport value caml_alloc_shr_no_large (mlsize_t wosize, tag_t tag)
+{
+  return alloc_shr_checked (wosize, tag, 0);
+}
+
+/* Allocate the new copy of a block that is being evacuated (see
+   [compact.c]).  Return 0 instead of raising when the heap cannot
+   grow.  The copy replaces the original, so it is neither counted as
+   allocated nor sampled by the profiler. */
+value caml_alloc_shr_for_evacuation (mlsize_t wosize, tag_t tag)
+{
+  return alloc_shr (wosize, tag, 1);
+}
+
 /* Dependent memory is all memory blocks allocated out of the heap
    that depend on the GC (and finalizers) for deallocation.
    For the GC to take dependent memory into account when computing
@@ -471,6 +605,44 @@ CAMLexport void caml_free_dependent_memory (mlsize_t nbytes)
   }
 }
 
+/* External memory is memory held outside the heap by custom blocks
+   and freed by their finalisers, such as the data of bigarrays.  Call
+   [caml_alloc_external_memory] when you allocate some, and
+   [caml_free_external_memory] when you free it.
+   Unlike dependent memory, which is weighed against the size of the
+   major heap, external memory is weighed against a fixed budget: the
+   GC does a full cycle each time the unused part of the budget is
+   allocated, so it speeds up as the memory in use gets close to the
+   budget.  A small heap full of blocks that hold large buffers is
+   thus collected before the buffers exhaust the C allocator.
+*/
+uintnat caml_external_budget = External_budget_def;
+uintnat caml_external_size = 0;
+uintnat caml_external_peak = 0;
+
+CAMLexport void caml_alloc_external_memory (uintnat nbytes)
+{
+  uintnat headroom = caml_external_budget / 16 + 1;
+
+  caml_external_size += nbytes;
+  if (caml_external_size > caml_external_peak){
+    caml_external_peak = caml_external_size;
+  }
+  if (caml_external_size + headroom < caml_external_budget){
+    headroom = caml_external_budget - caml_external_size;
+  }
+  caml_adjust_gc_speed (nbytes, headroom);
+}
+
+CAMLexport void caml_free_external_memory (uintnat nbytes)
+{
+  if (caml_external_size < nbytes){
+    caml_external_size = 0;
+  }else{
+    caml_external_size -= nbytes;
+  }
+}
+
 /* Use this function to tell the major GC to speed up when you use
    finalized blocks to automatically deallocate resources (other
    than memory). The GC will do at least one cycle every [max]
@@ -507,6 +679,7 @@ CAMLexport CAMLweakdef void caml_initialize (value *fp, value val)
 {
   CAMLassert(Is_in_heap(fp));
   *fp = val;
+  Evac_record (fp, val);
   if (Is_block (val) && Is_young (val)) {
     if (caml_ref_table.ptr >= caml_ref_table.limit){
       caml_realloc_ref_table (&caml_ref_table);
@@ -543,11 +716,17 @@ CAMLexport CAMLweakdef void caml_modify (value *fp, value val)
     /* The modified object resides in the minor heap.
        Conditions 1 and 2 cannot occur. */
     *fp = val;
+  } else if (Is_sealed(fp)) {
+    /* The modified object was sealed: it must not point to the heap. */
+    caml_sealed_modify(fp, val);
   } else {
     /* The modified object resides in the major heap. */
     CAMLassert(Is_in_heap(fp));
     old = *fp;
     *fp = val;
+    /* A pointer into a chunk being evacuated must be updated when its
+       block is moved: record where it is. */
+    Evac_record (fp, val);
     if (Is_block(old)) {
       /* If [old] is a pointer within the minor heap, we already
          have a major->minor pointer and [fp] is already in the
@@ -34,12 +34,16 @@ extern "C" {
 
 
 CAMLextern value caml_alloc_shr (mlsize_t, tag_t);
+CAMLextern value caml_alloc_shr_no_large (mlsize_t, tag_t);
 CAMLextern void caml_adjust_gc_speed (mlsize_t, mlsize_t);
 CAMLextern void caml_alloc_dependent_memory (mlsize_t);
 CAMLextern void caml_free_dependent_memory (mlsize_t);
+CAMLextern void caml_alloc_external_memory (uintnat);
+CAMLextern void caml_free_external_memory (uintnat);
 CAMLextern void caml_modify (value *, value);
 CAMLextern void caml_initialize (value *, value);
 CAMLextern value caml_check_urgent_gc (value);
+CAMLextern int caml_sweep_lazily (void);
 CAMLextern void * caml_stat_alloc (asize_t);              /* Size in bytes. */
 CAMLextern void caml_stat_free (void *);
 CAMLextern void * caml_stat_resize (void *, asize_t);     /* Size in bytes. */
@@ -48,15 +52,25 @@ void caml_free_for_heap (char *mem);
 int caml_add_to_heap (char *mem);
 color_t caml_allocation_color (void *hp);
 
-/* void caml_shrink_heap (char *);        Only used in compact.c */
+/* void caml_shrink_heap (char *);  Only used in compact.c and major_gc.c */
 
 /* <private> */
 
+extern uintnat caml_external_budget;     /* bytes */
+extern uintnat caml_external_size, caml_external_peak;
+extern uintnat caml_large_wosize;        /* 0: no large-object space */
+extern uintnat caml_large_chunks, caml_large_bytes;
+extern uintnat caml_large_allocated, caml_large_freed;
+void caml_free_large (char *chunk);
+value caml_alloc_shr_for_evacuation (mlsize_t, tag_t);
+
 #define Not_in_heap 0
 #define In_heap 1
 #define In_young 2
 #define In_static_data 4
 #define In_code_area 8
+#define In_sealed_data 16       /* with In_static_data; see sealed.c */
+#define In_evacuation 32        /* with In_heap; see compact.c */
 
 #ifdef ARCH_SIXTYFOUR
 
@@ -86,6 +100,28 @@ CAMLextern unsigned char * caml_page_table[Pagetable1_size];
 #define Is_in_heap(a) (Classify_addr(a) & In_heap)
 #define Is_in_heap_or_young(a) (Classify_addr(a) & (In_heap | In_young))
 
+/* Bounds of the sealed chunks, which may also contain other memory. */
+extern char *caml_sealed_start, *caml_sealed_end;
+#define Is_sealed(a) \
+  ((char *)(a) >= caml_sealed_start && (char *)(a) < caml_sealed_end \
+   && (Classify_addr(a) & In_sealed_data))
+extern int volatile caml_sealed_violation;
+void caml_sealed_modify (value *fp, value val);
+void caml_sealed_raise_violation (void);
+
+/* Bounds of the heap chunks being evacuated, NULL outside of an
+   evacuation (see compact.c).  A pointer into these chunks that is
+   stored in the major heap without [caml_modify] or [caml_initialize]
+   must be recorded with [Evac_record]. */
+extern char *caml_evac_start, *caml_evac_end;
+#define Is_evacuating(a) \
+  ((char *)(a) >= caml_evac_start && (char *)(a) < caml_evac_end \
+   && (Classify_addr(a) & In_evacuation))
+void caml_evac_record (value *fp, value v);
+#define Evac_record(fp, v) do{                                           \
+    if (Is_block (v) && Is_evacuating (v)) caml_evac_record ((fp), (v)); \
+  }while(0)
+
 int caml_page_table_add(int kind, void * start, void * end);
 int caml_page_table_remove(int kind, void * start, void * end);
 int caml_page_table_initialize(mlsize_t bytesize);
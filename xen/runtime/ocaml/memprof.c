@@ -0,0 +1,521 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Sampling allocation profiler.
+
+   Allocated words are sampled by a Poisson process of rate [rate]
+   samples per word: the distance between two samples is drawn from an
+   exponential distribution.  Since the distribution is memoryless, a
+   new distance can be drawn whenever it is convenient, e.g. after each
+   minor collection.
+
+   In the minor heap, the sampling point is enforced by lowering
+   [caml_young_limit]: the allocation that crosses it calls
+   [caml_garbage_collection], which takes the sample (see
+   signals_asm.c).  By then the allocation has been undone, and it is
+   redone just after, so the sampled block is the one that will end at
+   [caml_young_ptr]; it is identified by its end address when the next
+   minor collection promotes it.  Small blocks allocated from C do not
+   check [caml_young_limit]: the allocation functions of alloc.c check
+   the sampling point themselves.  Blocks allocated directly in the
+   major heap are sampled by [caml_alloc_shr].
+
+   Each sample records the call stack of the allocation.  Samples are
+   aggregated by call stack, and sampled blocks are followed until
+   they die, to count how many are promoted and how long they live.
+   Tracking is approximate: sampled blocks that could not be followed
+   (the tables are full, or the heap was compacted) are neither live nor
+   freed. */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "fail.h"
+#include "gc_ctrl.h"
+#include "memory.h"
+#include "memprof.h"
+#include "minor_gc.h"
+#include "mlvalues.h"
+#include "stack.h"
+
+#define Max_frames 32
+#define Max_pending 256            /* sampled blocks in the minor heap */
+#define Max_tracked (1 << 20)      /* sampled blocks in the major heap */
+
+struct site {
+  uintnat hash;
+  uintnat samples;       /* number of samples */
+  uintnat minor;         /* samples taken in the minor heap */
+  uintnat promoted;      /* minor samples that were promoted */
+  uintnat freed;         /* sampled blocks that are dead */
+  uintnat lifetime;      /* major cycles survived by the dead blocks */
+  uintnat live;          /* sampled blocks that are still followed */
+  uintnat nframes;
+  uintnat frames[1];     /* return addresses, innermost first */
+};
+
+struct pending {
+  char *end;             /* end of the block in the minor heap */
+  value v;               /* the block, found by [caml_oldify_one] */
+  struct site *site;
+};
+
+struct tracked {
+  value v;               /* 0: empty slot */
+  struct site *site;
+  uintnat birth;         /* [caml_stat_major_collections] at allocation */
+};
+
+char *caml_memprof_young_trigger = NULL;
+int caml_memprof_young_pending = 0;
+uintnat caml_memprof_major_tracked = 0;
+
+static double rate = 0.0;               /* samples per word; 0: stopped */
+static double major_countdown;          /* words until the next sample */
+static uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+static struct site **sites = NULL;      /* hash table */
+static uintnat sites_mask = 0, num_sites = 0;
+
+/* Sorted by decreasing [end], the order of allocation. */
+static struct pending pending [Max_pending];
+
+static struct tracked *tracked = NULL;  /* hash table, keyed by [v] */
+static uintnat tracked_mask = 0;
+
+/* Distance to the next sample, in words. */
+static double draw_gap (void)
+{
+  double u;
+
+  rng ^= rng >> 12;                                          /* xorshift* */
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  u = (double) (((rng * 2685821657736338717ULL) >> 11) + 1)
+      / 9007199254740992.0;                                 /* in (0, 1] */
+  return -log (u) / rate;
+}
+
+static uintnat hash_word (uintnat h, uintnat w)
+{
+  h ^= w + 0x9E3779B9 + (h << 6) + (h >> 2);
+  return h;
+}
+
+/* Call stack of the current allocation. */
+static uintnat capture_stack (uintnat *frames)
+{
+  uintnat pc = caml_last_return_address;
+  char *sp = caml_bottom_of_stack;
+  frame_descr *d;
+  uintnat n = 0;
+
+  if (sp == NULL) return 0;
+  while (n < Max_frames){
+    d = caml_next_frame_descriptor (&pc, &sp);
+    if (d == NULL) break;
+    frames[n++] = d->retaddr;
+#ifndef Stack_grows_upwards
+    if (sp > caml_top_of_stack) break;
+#else
+    if (sp < caml_top_of_stack) break;
+#endif
+  }
+  return n;
+}
+
+static int grow_sites (void)
+{
+  uintnat new_mask = sites_mask == 0 ? 255 : 2 * sites_mask + 1;
+  struct site **new_sites, *s;
+  uintnat i, h;
+
+  new_sites = calloc (new_mask + 1, sizeof (struct site *));
+  if (new_sites == NULL) return -1;
+  for (i = 0; sites != NULL && i <= sites_mask; i++){
+    s = sites[i];
+    if (s == NULL) continue;
+    for (h = s->hash & new_mask; new_sites[h] != NULL; h = (h + 1) & new_mask);
+    new_sites[h] = s;
+  }
+  free (sites);
+  sites = new_sites;
+  sites_mask = new_mask;
+  return 0;
+}
+
+/* The site of the current allocation, or NULL if out of memory. */
+static struct site *current_site (void)
+{
+  uintnat frames [Max_frames];
+  uintnat n, i, h, hash = 0;
+  struct site *s;
+
+  n = capture_stack (frames);
+  for (i = 0; i < n; i++) hash = hash_word (hash, frames[i]);
+  if (2 * (num_sites + 1) > sites_mask + 1 && grow_sites () != 0) return NULL;
+  for (h = hash & sites_mask; (s = sites[h]) != NULL; h = (h + 1) & sites_mask){
+    if (s->hash == hash && s->nframes == n
+        && memcmp (s->frames, frames, n * sizeof (uintnat)) == 0){
+      return s;
+    }
+  }
+  s = calloc (1, sizeof (struct site) + n * sizeof (uintnat));
+  if (s == NULL) return NULL;
+  s->hash = hash;
+  s->nframes = n;
+  memcpy (s->frames, frames, n * sizeof (uintnat));
+  sites[h] = s;
+  ++ num_sites;
+  return s;
+}
+
+static uintnat hash_value (value v)
+{
+  uintnat h = (uintnat) v >> 3;
+  return (h ^ (h >> 11) ^ (h >> 23)) & tracked_mask;
+}
+
+static int grow_tracked (void)
+{
+  uintnat new_mask = tracked_mask == 0 ? 1023 : 2 * tracked_mask + 1;
+  struct tracked *old = tracked, *t;
+  uintnat old_mask = tracked_mask, i, h;
+
+  if (new_mask + 1 > 2 * Max_tracked) return -1;
+  t = calloc (new_mask + 1, sizeof (struct tracked));
+  if (t == NULL) return -1;
+  tracked = t;
+  tracked_mask = new_mask;
+  for (i = 0; old != NULL && i <= old_mask; i++){
+    if (old[i].v == 0) continue;
+    for (h = hash_value (old[i].v); tracked[h].v != 0; h = (h + 1) & new_mask);
+    tracked[h] = old[i];
+  }
+  free (old);
+  return 0;
+}
+
+/* Follow the major block [v], sampled at [site]. */
+static void track_major (value v, struct site *s)
+{
+  uintnat h;
+
+  if (2 * (caml_memprof_major_tracked + 1) > tracked_mask + 1
+      && grow_tracked () != 0){
+    -- s->live;              /* cannot follow it */
+    return;
+  }
+  for (h = hash_value (v); tracked[h].v != 0; h = (h + 1) & tracked_mask);
+  tracked[h].v = v;
+  tracked[h].site = s;
+  tracked[h].birth = caml_stat_major_collections;
+  ++ caml_memprof_major_tracked;
+}
+
+/* Draw the next sampling point in the minor heap and raise
+   [caml_young_limit] to it.  Called wherever the limit is reset.  The
+   limit is never lowered: [caml_request_major_slice] and the signal
+   handlers set it to [caml_young_end] to trap at the next allocation,
+   and that request must not be lost. */
+void caml_memprof_renew_minor_sample (void)
+{
+  double gap;
+
+  if (rate == 0.0){
+    caml_memprof_young_trigger = NULL;
+    return;
+  }
+  gap = Bsize_wsize (draw_gap ());
+  if (gap < (double) (caml_young_ptr - caml_young_start)){
+    caml_memprof_young_trigger = caml_young_ptr - (uintnat) gap;
+    if (caml_memprof_young_trigger > caml_young_limit){
+      caml_young_limit = caml_memprof_young_trigger;
+    }
+  }else{
+    /* Beyond the minor heap: draw again after the next minor GC. */
+    caml_memprof_young_trigger = NULL;
+  }
+}
+
+static void add_pending (char *end, value v, struct site *s)
+{
+  int n = caml_memprof_young_pending;
+
+  if (n == Max_pending){
+    -- s->live;              /* cannot follow it */
+    return;
+  }
+  Assert (n == 0 || end <= pending[n - 1].end);
+  pending[n].end = end;
+  pending[n].v = v;
+  pending[n].site = s;
+  caml_memprof_young_pending = n + 1;
+}
+
+/* Called from [caml_garbage_collection] when an allocation in OCaml
+   code has crossed the sampling point.  The block will be allocated
+   just below [caml_young_ptr]. */
+void caml_memprof_track_young (void)
+{
+  struct site *s = current_site ();
+
+  if (s != NULL){
+    ++ s->samples;
+    ++ s->minor;
+    ++ s->live;
+    add_pending (caml_young_ptr, 0, s);
+  }
+  caml_memprof_renew_minor_sample ();
+}
+
+/* [v] was allocated from C and crossed the sampling point. */
+void caml_memprof_sample_young_block (value v)
+{
+  struct site *s = current_site ();
+
+  if (s != NULL){
+    ++ s->samples;
+    ++ s->minor;
+    ++ s->live;
+    add_pending ((char *) v + Bosize_val (v), v, s);
+  }
+  caml_memprof_renew_minor_sample ();
+}
+
+/* [v], with header [hd], is about to be promoted. */
+void caml_memprof_oldify (value v, header_t hd)
+{
+  char *end = (char *) v + Bosize_hd (hd);
+  int lo = 0, hi = caml_memprof_young_pending, mid;
+
+  if (end > pending[0].end || end < pending[hi - 1].end) return;
+  while (lo < hi){                       /* [pending] is decreasing */
+    mid = (lo + hi) / 2;
+    if (pending[mid].end > end) lo = mid + 1; else hi = mid;
+  }
+  if (lo < caml_memprof_young_pending && pending[lo].end == end){
+    pending[lo].v = v;
+  }
+}
+
+/* End of a minor collection: the pending blocks that were forwarded
+   have been promoted, the others are dead. */
+void caml_memprof_minor_done (void)
+{
+  int i;
+  struct pending *p;
+
+  for (i = 0; i < caml_memprof_young_pending; i++){
+    p = &pending[i];
+    if (p->v != 0 && Hd_val (p->v) == 0){
+      ++ p->site->promoted;
+      track_major (Field (p->v, 0), p->site);
+    }else{
+      ++ p->site->freed;
+      -- p->site->live;
+    }
+  }
+  caml_memprof_young_pending = 0;
+}
+
+/* [v] was just allocated in the major heap, outside of a minor
+   collection. */
+void caml_memprof_alloc_major (value v)
+{
+  struct site *s;
+  uintnat n = 0;
+
+  if (rate == 0.0) return;
+  major_countdown -= Whsize_val (v);
+  if (major_countdown > 0) return;
+  while (major_countdown <= 0){
+    major_countdown += draw_gap ();
+    ++ n;
+  }
+  s = current_site ();
+  if (s == NULL) return;
+  s->samples += n;
+  ++ s->live;
+  track_major (v, s);
+}
+
+/* The index of the entry of [v] in [tracked], or -1 if [v] is not
+   followed. */
+static intnat find_tracked (value v)
+{
+  uintnat h;
+
+  for (h = hash_value (v); tracked[h].v != v; h = (h + 1) & tracked_mask){
+    if (tracked[h].v == 0) return -1;
+  }
+  return h;
+}
+
+/* Delete the entry [h], moving back the ones that follow it. */
+static void remove_tracked (uintnat h)
+{
+  uintnat j, k;
+
+  tracked[h].v = 0;
+  for (j = (h + 1) & tracked_mask; tracked[j].v != 0;
+       j = (j + 1) & tracked_mask){
+    k = hash_value (tracked[j].v);
+    if ((j > h && (k <= h || k > j)) || (j < h && (k <= h && k > j))){
+      tracked[h] = tracked[j];
+      tracked[j].v = 0;
+      h = j;
+    }
+  }
+}
+
+/* [v] is being swept. */
+void caml_memprof_free_major (value v)
+{
+  intnat h = find_tracked (v);
+  struct site *s;
+
+  if (h < 0) return;
+  s = tracked[h].site;
+  ++ s->freed;
+  -- s->live;
+  s->lifetime += caml_stat_major_collections - tracked[h].birth;
+  -- caml_memprof_major_tracked;
+  remove_tracked (h);
+}
+
+/* [v] was moved to [nv] by the evacuation of its heap chunk. */
+void caml_memprof_move_major (value v, value nv)
+{
+  intnat h = find_tracked (v);
+  struct tracked t;
+  uintnat j;
+
+  if (h < 0) return;
+  t = tracked[h];
+  remove_tracked (h);
+  t.v = nv;
+  for (j = hash_value (nv); tracked[j].v != 0; j = (j + 1) & tracked_mask);
+  tracked[j] = t;
+}
+
+/* Blocks are about to move: stop following them. */
+void caml_memprof_forget_major (void)
+{
+  uintnat i;
+
+  if (caml_memprof_major_tracked == 0) return;
+  for (i = 0; i <= tracked_mask; i++){
+    if (tracked[i].v != 0){
+      -- tracked[i].site->live;
+      tracked[i].v = 0;
+    }
+  }
+  caml_memprof_major_tracked = 0;
+}
+
+CAMLprim value caml_memprof_start (value vrate)
+{
+  double r = Double_val (vrate);
+
+  if (!(r > 0.0 && r <= 1.0)) caml_invalid_argument ("Memprof.start");
+  rate = r;
+  major_countdown = draw_gap ();
+  caml_memprof_renew_minor_sample ();
+  return Val_unit;
+}
+
+CAMLprim value caml_memprof_stop (value unit)
+{
+  /* A trigger already in [caml_young_limit] costs one spurious trap. */
+  rate = 0.0;
+  caml_memprof_young_trigger = NULL;
+  return Val_unit;
+}
+
+CAMLprim value caml_memprof_reset (value unit)
+{
+  uintnat i;
+
+  caml_memprof_young_pending = 0;
+  caml_memprof_major_tracked = 0;
+  free (tracked);
+  tracked = NULL;
+  tracked_mask = 0;
+  for (i = 0; sites != NULL && i <= sites_mask; i++) free (sites[i]);
+  free (sites);
+  sites = NULL;
+  sites_mask = num_sites = 0;
+  return Val_unit;
+}
+
+/* Little-endian encoding of the profile; see lib/memprof.mli. */
+static unsigned char *put_u64 (unsigned char *p, uint64_t x)
+{
+  int i;
+  for (i = 0; i < 8; i++){ *p++ = x & 0xFF; x >>= 8; }
+  return p;
+}
+
+static unsigned char *put_u32 (unsigned char *p, uint32_t x)
+{
+  int i;
+  for (i = 0; i < 4; i++){ *p++ = x & 0xFF; x >>= 8; }
+  return p;
+}
+
+CAMLprim value caml_memprof_dump (value unit)
+{
+  CAMLparam0 ();
+  CAMLlocal1 (res);
+  unsigned char *buf, *p;
+  uintnat size, i, j;
+  struct site *s;
+  union { double d; uint64_t i; } r;
+
+  size = 4 + 4 + 8 + 4 + 8;
+  for (i = 0; sites != NULL && i <= sites_mask; i++){
+    if (sites[i] != NULL) size += 4 + 8 * sites[i]->nframes + 6 * 8;
+  }
+  /* Build the profile outside the heap: allocating the string may take
+     samples. */
+  buf = malloc (size);
+  if (buf == NULL) caml_raise_out_of_memory ();
+  memcpy (buf, "MPRF", 4);
+  p = put_u32 (buf + 4, 1);
+  r.d = rate;
+  p = put_u64 (p, r.i);
+  p = put_u32 (p, sizeof (value));
+  p = put_u64 (p, num_sites);
+  for (i = 0; sites != NULL && i <= sites_mask; i++){
+    s = sites[i];
+    if (s == NULL) continue;
+    p = put_u32 (p, s->nframes);
+    for (j = 0; j < s->nframes; j++) p = put_u64 (p, s->frames[j]);
+    p = put_u64 (p, s->samples);
+    p = put_u64 (p, s->minor);
+    p = put_u64 (p, s->promoted);
+    p = put_u64 (p, s->freed);
+    p = put_u64 (p, s->lifetime);
+    p = put_u64 (p, s->live);
+  }
+  Assert (p == buf + size);
+  res = caml_alloc_string (size);
+  memcpy (String_val (res), buf, size);
+  free (buf);
+  CAMLreturn (res);
+}
@@ -0,0 +1,46 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Sampling allocation profiler. */
+
+#ifndef CAML_MEMPROF_H
+#define CAML_MEMPROF_H
+
+#include "misc.h"
+#include "mlvalues.h"
+
+/* Allocating below this address in the minor heap takes a sample;
+   NULL when the profiler is stopped. */
+extern char *caml_memprof_young_trigger;
+extern int caml_memprof_young_pending;    /* see [caml_oldify_one] */
+extern uintnat caml_memprof_major_tracked;
+
+void caml_memprof_renew_minor_sample (void);
+void caml_memprof_track_young (void);
+void caml_memprof_sample_young_block (value);
+void caml_memprof_oldify (value, header_t);
+void caml_memprof_minor_done (void);
+void caml_memprof_alloc_major (value);
+void caml_memprof_free_major (value);
+void caml_memprof_move_major (value, value);
+void caml_memprof_forget_major (void);
+
+/* Sample [v], just allocated in the minor heap by [Alloc_small] from C,
+   if it crosses the sampling point. */
+#define Memprof_sample_small(v) do{                                      \
+    if ((char *) Hp_val (v) < caml_memprof_young_trigger)               \
+      caml_memprof_sample_young_block (v);                              \
+  }while(0)
+
+#endif /* CAML_MEMPROF_H */
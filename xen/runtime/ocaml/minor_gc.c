@@ -17,8 +17,10 @@
 #include "finalise.h"
 #include "gc.h"
 #include "gc_ctrl.h"
+#include "gc_events.h"
 #include "major_gc.h"
 #include "memory.h"
+#include "memprof.h"
 #include "minor_gc.h"
 #include "misc.h"
 #include "mlvalues.h"
@@ -97,6 +99,7 @@ void caml_set_minor_heap_size (asize_t size)
   caml_young_limit = caml_young_start;
   caml_young_ptr = caml_young_end;
   caml_minor_heap_size = size;
+  caml_memprof_renew_minor_sample ();
 
   reset_table (&caml_ref_table);
   reset_table (&caml_weak_ref_table);
@@ -122,6 +125,9 @@ void caml_oldify_one (value v, value *p)
       *p = Field (v, 0);  /*  then forward pointer is first field. */
     }else{
       tag = Tag_hd (hd);
+      if (caml_memprof_young_pending && tag != Infix_tag){
+        caml_memprof_oldify (v, hd);
+      }
       if (tag < Infix_tag){
         value field0;
 
@@ -133,6 +139,7 @@ void caml_oldify_one (value v, value *p)
         Field (v, 0) = result;     /*  and forward pointer. */
         if (sz > 1){
           Field (result, 0) = field0;
+          Evac_record (&Field (result, 0), field0);
           Field (result, 1) = oldify_todo_list;    /* Add this block */
           oldify_todo_list = v;                    /*  to the "to do" list. */
         }else{
@@ -187,6 +194,7 @@ void caml_oldify_one (value v, value *p)
     }
   }else{
     *p = v;
+    Evac_record (p, v);
   }
 }
 
@@ -215,6 +223,7 @@ void caml_oldify_mopup (void)
         caml_oldify_one (f, &Field (new_v, i));
       }else{
         Field (new_v, i) = f;
+        Evac_record (&Field (new_v, i), f);
       }
     }
   }
@@ -226,8 +235,11 @@ void caml_oldify_mopup (void)
 void caml_empty_minor_heap (void)
 {
   value **r;
+  uint64_t start;
+  uintnat words;
 
   if (caml_young_ptr != caml_young_end){
+    start = caml_gc_clock ();
     caml_in_minor_collection = 1;
     caml_gc_message (0x02, "<", 0);
     caml_oldify_local_roots();
@@ -244,14 +256,18 @@ void caml_empty_minor_heap (void)
         }
       }
     }
+    if (caml_memprof_young_pending) caml_memprof_minor_done ();
     if (caml_young_ptr < caml_young_start) caml_young_ptr = caml_young_start;
-    caml_stat_minor_words += Wsize_bsize (caml_young_end - caml_young_ptr);
+    words = Wsize_bsize (caml_young_end - caml_young_ptr);
+    caml_stat_minor_words += words;
     caml_young_ptr = caml_young_end;
     caml_young_limit = caml_young_start;
+    caml_memprof_renew_minor_sample ();
     clear_table (&caml_ref_table);
     clear_table (&caml_weak_ref_table);
     caml_gc_message (0x02, ">", 0);
     caml_in_minor_collection = 0;
+    caml_gc_event (Gc_ev_minor, start, words);
   }
   caml_final_empty_young ();
 #ifdef DEBUG
@@ -113,13 +113,15 @@ void caml_fatal_uncaught_exception(value exn)
   fprintf(stderr, "Fatal error: exception %s\n", msg);
   free(msg);
   /* Display the backtrace if available */
-  if (caml_backtrace_active
+  if (caml_backtrace_requested
 #ifndef NATIVE_CODE
       && !caml_debugger_in_use
 #endif
       ) {
     caml_print_exception_backtrace();
   }
+  /* Display the recent exceptions */
+  if (caml_exn_ring_active) caml_print_exn_ring();
   /* Terminate the process */
   exit(2);
 }
@@ -0,0 +1,288 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Sealed values.
+
+   [caml_seal] copies an immutable value graph into a chunk of memory
+   that is outside the heap: the page table classifies it as static
+   data (plus [In_sealed_data]), like the data of compiled modules, so
+   the major GC neither marks nor sweeps it, while compare, hash and
+   marshal treat its blocks as ordinary values.  Headers are black, as
+   in static data.  Sharing and cycles are preserved.  Sealed chunks
+   are never freed.
+
+   A sealed block may only point to sealed blocks and to static data,
+   since nothing in the heap is kept alive by it.  [caml_modify]
+   therefore refuses to store a pointer to the heap into a sealed
+   block, and raises [Invalid_argument] soon after (see
+   [caml_sealed_modify]).  The pages are not write-protected: stores
+   that do not go through [caml_modify] are not checked.  Blocks whose contents can change
+   behind the write barrier, or that need finalisation, are not
+   sealed: closures, objects, lazy values, abstract blocks and custom
+   blocks with a finaliser.
+
+   Sealing takes two passes over the graph: the first lists the blocks
+   to copy, breadth-first, and assigns each an offset in the chunk;
+   the second copies them and relocates their fields.  Nothing is
+   allocated in the heap in between, so no block moves. */
+
+#include <string.h>
+
+#include "alloc.h"
+#include "custom.h"
+#include "fail.h"
+#include "major_gc.h"
+#include "memory.h"
+#include "minor_gc.h"
+#include "misc.h"
+#include "mlvalues.h"
+#include "signals.h"
+
+char *caml_sealed_start = NULL, *caml_sealed_end = NULL;
+
+static char *sealed_chunks = NULL;      /* chained by [Chunk_next] */
+static uintnat sealed_bytes = 0, sealed_blocks = 0, sealed_count = 0;
+
+struct entry {
+  value orig;                           /* 0: empty slot */
+  uintnat ofs;                          /* in words, header included */
+};
+
+struct seal {
+  struct entry *table;                  /* hash table, keyed by [orig] */
+  uintnat mask, num;
+  value *blocks;                        /* in the order of [ofs] */
+  uintnat size;                         /* capacity of [blocks] */
+  uintnat words;                        /* total, headers included */
+  const char *error;
+};
+
+#define Hash_val(v) ((((uintnat) (v)) >> 3) * 0x9E3779B97F4A7C15ULL)
+
+static struct entry *lookup (struct seal *s, value v)
+{
+  uintnat h = Hash_val (v) & s->mask;
+
+  while (s->table[h].orig != 0){
+    if (s->table[h].orig == v) return &s->table[h];
+    h = (h + 1) & s->mask;
+  }
+  return &s->table[h];
+}
+
+static int grow (struct seal *s)
+{
+  struct entry *old = s->table, *e;
+  uintnat old_mask = s->mask, i;
+  value *blocks;
+
+  s->mask = 2 * old_mask + 1;
+  s->table = calloc (s->mask + 1, sizeof (struct entry));
+  blocks = realloc (s->blocks, (s->mask + 1) / 2 * sizeof (value));
+  if (s->table == NULL || blocks == NULL){
+    free (s->table);
+    s->table = old;
+    s->mask = old_mask;
+    if (blocks != NULL) s->blocks = blocks;
+    return -1;
+  }
+  s->blocks = blocks;
+  s->size = (s->mask + 1) / 2;
+  for (i = 0; i <= old_mask; i++){
+    if (old[i].orig == 0) continue;
+    e = lookup (s, old[i].orig);
+    *e = old[i];
+  }
+  free (old);
+  return 0;
+}
+
+/* Whether [v] must be copied; set [s->error] if it cannot be. */
+static int to_copy (struct seal *s, value v)
+{
+  struct custom_operations *ops;
+
+  if (Is_long (v) || ! Is_in_heap_or_young (v)) return 0;
+  switch (Tag_val (v)){
+  case Closure_tag: case Infix_tag:
+    s->error = "Sealed.seal: functional value"; return 0;
+  case Object_tag:
+    s->error = "Sealed.seal: object"; return 0;
+  case Lazy_tag:
+    s->error = "Sealed.seal: unforced lazy value"; return 0;
+  case Abstract_tag:
+    s->error = "Sealed.seal: abstract value"; return 0;
+  case Custom_tag:
+    ops = Custom_ops_val (v);
+    if (ops->finalize != NULL){
+      s->error = "Sealed.seal: custom block with a finaliser"; return 0;
+    }
+    return 1;
+  default:
+    return 1;
+  }
+}
+
+static void add (struct seal *s, value v)
+{
+  struct entry *e = lookup (s, v);
+
+  if (e->orig != 0) return;
+  if (s->num >= s->size){
+    if (grow (s) != 0){ s->error = "Sealed.seal: out of memory"; return; }
+    e = lookup (s, v);
+  }
+  e->orig = v;
+  e->ofs = s->words;
+  s->blocks[s->num++] = v;
+  s->words += Whsize_val (v);
+}
+
+/* First pass: list the blocks reachable from [root]. */
+static void list_blocks (struct seal *s, value root)
+{
+  uintnat i, j;
+  value v;
+
+  if (to_copy (s, root)) add (s, root);
+  for (i = 0; i < s->num && s->error == NULL; i++){
+    v = s->blocks[i];
+    if (Tag_val (v) >= No_scan_tag) continue;
+    for (j = 0; j < Wosize_val (v) && s->error == NULL; j++){
+      if (to_copy (s, Field (v, j))) add (s, Field (v, j));
+    }
+  }
+}
+
+/* Second pass: copy the blocks to [chunk]. */
+static void copy_blocks (struct seal *s, char *chunk)
+{
+  uintnat i, j;
+  value v, f, *dst;
+  struct entry *e;
+
+  for (i = 0; i < s->num; i++){
+    v = s->blocks[i];
+    dst = (value *) chunk + lookup (s, v)->ofs;
+    dst[0] = Blackhd_hd (Hd_val (v));
+    dst++;
+    if (Tag_val (v) >= No_scan_tag){
+      memcpy (dst, Op_val (v), Bsize_wsize (Wosize_val (v)));
+      continue;
+    }
+    for (j = 0; j < Wosize_val (v); j++){
+      f = Field (v, j);
+      if (Is_block (f) && (e = lookup (s, f))->orig != 0){
+        f = (value) ((value *) chunk + e->ofs + 1);
+      }
+      dst[j] = f;
+    }
+  }
+}
+
+static value seal (value root)
+{
+  struct seal s;
+  asize_t size;
+  char *chunk;
+  value res = root;
+
+  s.mask = 255;
+  s.table = calloc (s.mask + 1, sizeof (struct entry));
+  s.size = (s.mask + 1) / 2;
+  s.blocks = malloc (s.size * sizeof (value));
+  s.num = s.words = 0;
+  s.error = NULL;
+  if (s.table == NULL || s.blocks == NULL){
+    s.error = "Sealed.seal: out of memory";
+  }
+  if (s.error == NULL) list_blocks (&s, root);
+  if (s.error == NULL && s.num > 0){
+    size = (Bsize_wsize (s.words) + Page_size - 1) & ~(Page_size - 1);
+    chunk = caml_alloc_for_heap (size);
+    if (chunk == NULL){
+      s.error = "Sealed.seal: out of memory";
+    }else if (caml_page_table_add (In_static_data | In_sealed_data,
+                                   chunk, chunk + size) != 0){
+      caml_free_for_heap (chunk);
+      s.error = "Sealed.seal: out of memory";
+    }else{
+      copy_blocks (&s, chunk);
+      res = (value) ((value *) chunk + lookup (&s, root)->ofs + 1);
+      Chunk_next (chunk) = sealed_chunks;
+      sealed_chunks = chunk;
+      if (caml_sealed_start == NULL || chunk < caml_sealed_start){
+        caml_sealed_start = chunk;
+      }
+      if (chunk + size > caml_sealed_end) caml_sealed_end = chunk + size;
+      sealed_bytes += size;
+      sealed_blocks += s.num;
+      sealed_count++;
+    }
+  }
+  free (s.table);
+  free (s.blocks);
+  if (s.error != NULL) caml_invalid_argument ((char *) s.error);
+  return res;
+}
+
+int volatile caml_sealed_violation = 0;
+
+/* Called by [caml_modify] when [fp] is in a sealed block.  Native code
+   calls [caml_modify] directly, where it cannot raise, so a store of a
+   pointer to the heap is dropped and the exception is raised at the
+   next poll point, the way signals are handled (see signals.c).  Only
+   stores through [caml_modify] are checked: integer fields and the
+   bytes of strings and floats are written in place. */
+void caml_sealed_modify (value *fp, value val)
+{
+  if (Is_block (val) && Is_in_heap_or_young (val)){
+    caml_sealed_violation = 1;
+#ifndef NATIVE_CODE
+    caml_something_to_do = 1;
+#else
+    caml_young_limit = caml_young_end;
+#endif
+    return;
+  }
+  *fp = val;
+}
+
+void caml_sealed_raise_violation (void)
+{
+  caml_sealed_violation = 0;
+  caml_invalid_argument ("Sealed: a sealed value was mutated to point "
+                         "to the heap");
+}
+
+CAMLprim value caml_sealed_seal (value v)
+{
+  return seal (v);
+}
+
+CAMLprim value caml_sealed_is_sealed (value v)
+{
+  return Val_bool (Is_block (v) && Is_sealed (v));
+}
+
+CAMLprim value caml_sealed_stats (value unit)
+{
+  value res = caml_alloc_small (3, 0);
+
+  Field (res, 0) = Val_long (sealed_count);
+  Field (res, 1) = Val_long (sealed_blocks);
+  Field (res, 2) = Val_long (sealed_bytes);
+  return res;
+}
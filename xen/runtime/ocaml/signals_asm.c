@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include "fail.h"
 #include "memory.h"
+#include "memprof.h"
 #include "osdeps.h"
 #include "signals.h"
 #include "signals_machdep.h"
@@ -65,11 +66,21 @@ extern char caml_system__code_begin, caml_system__code_end;
 
 void caml_garbage_collection(void)
 {
+  /* The allocation that trapped has crossed the sampling point of the
+     allocation profiler.  It is retried when we return, so the sampled
+     block will end at the final value of [caml_young_ptr]. */
+  int sampled = caml_young_ptr < caml_memprof_young_trigger;
+
   caml_young_limit = caml_young_start;
   if (caml_young_ptr < caml_young_start || caml_force_major_slice) {
     caml_minor_collection();
   }
   caml_process_pending_signals();
+  if (sampled)
+    caml_memprof_track_young();
+  else
+    caml_memprof_renew_minor_sample();
+  if (caml_sealed_violation) caml_sealed_raise_violation();
 }
 
 DECLARE_SIGNAL_HANDLER(handle_signal)
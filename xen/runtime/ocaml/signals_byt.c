@@ -46,6 +46,7 @@ void caml_process_event(void)
     caml_async_action_hook = NULL;
     (*async_action)();
   }
+  if (caml_sealed_violation) caml_sealed_raise_violation();
 }
 
 static void handle_signal(int signal_number)
@@ -91,6 +91,12 @@ static uintnat heap_chunk_init = Heap_chunk_def;
 static uintnat heap_size_init = Init_heap_def;
 static uintnat max_stack_init = Max_stack_def;
 
+#ifdef SYS_xen
+/* Scale the defaults to the memory of the domain (see xencaml/main.c). */
+extern void caml_xen_heap_sizes (uintnat *minor_wsz, uintnat *heap_wsz,
+                                 uintnat *incr_wsz);
+#endif
+
 /* Parse the CAMLRUNPARAM variable */
 /* The option letter for each runtime option is the first letter of the
    last word of the ML name of the option (see [stdlib/gc.mli]).
@@ -173,6 +179,9 @@ void caml_main(char **argv)
   caml_verb_gc = 63;
 #endif
   caml_top_of_stack = &tos;
+#ifdef SYS_xen
+  caml_xen_heap_sizes (&minor_heap_init, &heap_size_init, &heap_chunk_init);
+#endif
   parse_camlrunparam();
   caml_init_gc (minor_heap_init, heap_size_init, heap_chunk_init,
                 percent_free_init, max_percent_free_init);
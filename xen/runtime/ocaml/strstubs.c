@@ -17,6 +17,7 @@
 #include <alloc.h>
 #include <memory.h>
 #include <fail.h>
+#include <bigarray.h>
 #include <caml/compatibility.h>
 
 /* The backtracking NFA interpreter */
@@ -347,11 +348,10 @@ static int re_match(value re,
    Beginning of group #N is at 2N, end is at 2N+1.
    Take position = -1 when group wasn't matched. */
 
-static value re_alloc_groups(value re, value str)
+static value re_alloc_groups(value re, unsigned char * starttxt)
 {
-  CAMLparam1(str);
+  CAMLparam0();
   CAMLlocal1(res);
-  unsigned char * starttxt = (unsigned char *) String_val(str);
   int n = Numgroups(re);
   int i;
   struct re_group * group;
@@ -382,7 +382,7 @@ CAMLprim value re_string_match(value re, value str, value pos)
   if (txt < starttxt || txt > endtxt)
     caml_invalid_argument("Str.string_match");
   if (re_match(re, starttxt, txt, endtxt, 0)) {
-    return re_alloc_groups(re, str);
+    return re_alloc_groups(re, starttxt);
   } else {
     return Atom(0);
   }
@@ -397,70 +397,257 @@ CAMLprim value re_partial_match(value re, value str, value pos)
   if (txt < starttxt || txt > endtxt)
     caml_invalid_argument("Str.string_partial_match");
   if (re_match(re, starttxt, txt, endtxt, 1)) {
-    return re_alloc_groups(re, str);
+    return re_alloc_groups(re, starttxt);
   } else {
     return Atom(0);
   }
 }
 
-CAMLprim value re_search_forward(value re, value str, value startpos)
+/* Literal prefilter.  When every match must begin with a fixed string,
+   i.e. the program starts with CHAR and STRING instructions, possibly
+   mixed with instructions that consume nothing, the searches look for
+   that string with a word-at-a-time scan and run [re_match] only where
+   it occurs.  Otherwise they skip to the characters in [Startchars]. */
+
+#define MAX_PREFIX 64
+
+static int re_literal_prefix(value re, unsigned char * buf)
 {
-  unsigned char * starttxt = &Byte_u(str, 0);
-  unsigned char * txt = &Byte_u(str, Long_val(startpos));
-  unsigned char * endtxt = &Byte_u(str, caml_string_length(str));
-  unsigned char * startchars;
+  value * pc = &Field(Prog(re), 0);
+  value str;
+  intnat instr;
+  mlsize_t n;
+  int len = 0;
 
-  if (txt < starttxt || txt > endtxt)
-    caml_invalid_argument("Str.search_forward");
-  if (Startchars(re) == -1) {
+  while (len < MAX_PREFIX) {
+    instr = Long_val(*pc++);
+    switch (Opcode(instr)) {
+    case CHAR:
+      buf[len++] = Arg(instr);
+      break;
+    case STRING:
+      str = Field(Cpool(re), Arg(instr));
+      n = caml_string_length(str);
+      if (n > MAX_PREFIX - len) n = MAX_PREFIX - len;
+      memcpy(buf + len, String_val(str), n);
+      len += n;
+      break;
+    case BOL: case EOL: case WORDBOUNDARY:
+    case BEGGROUP: case ENDGROUP: case SETMARK:
+      break;
+    default:
+      return len;
+    }
+  }
+  return len;
+}
+
+#define Ones ((uintnat) -1 / 0xFF)
+#define Has_zero_byte(w) (((w) - Ones) & ~(w) & (Ones << 7))
+
+/* First occurrence of [c] in [p, end), or NULL. */
+static unsigned char * re_scan_forward(unsigned char * p, unsigned char * end,
+                                       unsigned char c)
+{
+  uintnat pat = Ones * c;
+
+  while (p < end && ((uintnat) p & (sizeof(uintnat) - 1)) != 0) {
+    if (*p == c) return p;
+    p++;
+  }
+  while (end - p >= (intnat) sizeof(uintnat)
+         && ! Has_zero_byte(*(uintnat *) p ^ pat))
+    p += sizeof(uintnat);
+  while (p < end) {
+    if (*p == c) return p;
+    p++;
+  }
+  return NULL;
+}
+
+/* Last occurrence of [c] in [start, p], or NULL. */
+static unsigned char * re_scan_backward(unsigned char * start,
+                                        unsigned char * p, unsigned char c)
+{
+  uintnat pat = Ones * c;
+
+  while (p >= start && ((uintnat) (p + 1) & (sizeof(uintnat) - 1)) != 0) {
+    if (*p == c) return p;
+    p--;
+  }
+  while (p + 1 - start >= (intnat) sizeof(uintnat)
+         && ! Has_zero_byte(*(uintnat *) (p + 1 - sizeof(uintnat)) ^ pat))
+    p -= sizeof(uintnat);
+  while (p >= start) {
+    if (*p == c) return p;
+    p--;
+  }
+  return NULL;
+}
+
+/* The searches proper.  Return 1 and leave the groups in [re_group] if
+   a match starts between [txt] and the end (resp. the beginning) of the
+   text, 0 otherwise. */
+
+static int re_search_forward_in(value re, unsigned char * starttxt,
+                                unsigned char * txt, unsigned char * endtxt)
+{
+  unsigned char * startchars;
+  unsigned char prefix[MAX_PREFIX];
+  int plen = re_literal_prefix(re, prefix);
+
+  if (plen > 0) {
+    while (endtxt - txt >= plen) {
+      txt = re_scan_forward(txt, endtxt - plen + 1, prefix[0]);
+      if (txt == NULL) break;
+      if (memcmp(txt + 1, prefix + 1, plen - 1) == 0
+          && re_match(re, starttxt, txt, endtxt, 0))
+        return 1;
+      txt++;
+    }
+    return 0;
+  } else if (Startchars(re) == -1) {
     do {
       if (re_match(re, starttxt, txt, endtxt, 0))
-        return re_alloc_groups(re, str);
+        return 1;
       txt++;
     } while (txt <= endtxt);
-    return Atom(0);
+    return 0;
   } else {
     startchars =
       (unsigned char *) String_val(Field(Cpool(re), Startchars(re)));
     do {
       while (txt < endtxt && startchars[*txt] == 0) txt++;
       if (re_match(re, starttxt, txt, endtxt, 0))
-        return re_alloc_groups(re, str);
+        return 1;
       txt++;
     } while (txt <= endtxt);
-    return Atom(0);
+    return 0;
   }
 }
 
-CAMLprim value re_search_backward(value re, value str, value startpos)
+static int re_search_backward_in(value re, unsigned char * starttxt,
+                                 unsigned char * txt, unsigned char * endtxt)
 {
-  unsigned char * starttxt = &Byte_u(str, 0);
-  unsigned char * txt = &Byte_u(str, Long_val(startpos));
-  unsigned char * endtxt = &Byte_u(str, caml_string_length(str));
   unsigned char * startchars;
-
-  if (txt < starttxt || txt > endtxt)
-    caml_invalid_argument("Str.search_backward");
-  if (Startchars(re) == -1) {
+  unsigned char prefix[MAX_PREFIX];
+  int plen = re_literal_prefix(re, prefix);
+
+  if (plen > 0) {
+    if (endtxt - starttxt < plen) return 0;
+    if (endtxt - txt < plen) txt = endtxt - plen;
+    while (txt != NULL) {
+      txt = re_scan_backward(starttxt, txt, prefix[0]);
+      if (txt == NULL) break;
+      if (memcmp(txt + 1, prefix + 1, plen - 1) == 0
+          && re_match(re, starttxt, txt, endtxt, 0))
+        return 1;
+      if (txt == starttxt) break;
+      txt--;
+    }
+    return 0;
+  } else if (Startchars(re) == -1) {
     do {
       if (re_match(re, starttxt, txt, endtxt, 0))
-        return re_alloc_groups(re, str);
+        return 1;
       txt--;
     } while (txt >= starttxt);
-    return Atom(0);
+    return 0;
   } else {
     startchars =
       (unsigned char *) String_val(Field(Cpool(re), Startchars(re)));
     do {
       while (txt > starttxt && startchars[*txt] == 0) txt--;
       if (re_match(re, starttxt, txt, endtxt, 0))
-        return re_alloc_groups(re, str);
+        return 1;
       txt--;
     } while (txt >= starttxt);
-    return Atom(0);
+    return 0;
   }
 }
 
+CAMLprim value re_search_forward(value re, value str, value startpos)
+{
+  unsigned char * starttxt = &Byte_u(str, 0);
+  unsigned char * txt = &Byte_u(str, Long_val(startpos));
+  unsigned char * endtxt = &Byte_u(str, caml_string_length(str));
+
+  if (txt < starttxt || txt > endtxt)
+    caml_invalid_argument("Str.search_forward");
+  if (re_search_forward_in(re, starttxt, txt, endtxt))
+    return re_alloc_groups(re, starttxt);
+  else
+    return Atom(0);
+}
+
+CAMLprim value re_search_backward(value re, value str, value startpos)
+{
+  unsigned char * starttxt = &Byte_u(str, 0);
+  unsigned char * txt = &Byte_u(str, Long_val(startpos));
+  unsigned char * endtxt = &Byte_u(str, caml_string_length(str));
+
+  if (txt < starttxt || txt > endtxt)
+    caml_invalid_argument("Str.search_backward");
+  if (re_search_backward_in(re, starttxt, txt, endtxt))
+    return re_alloc_groups(re, starttxt);
+  else
+    return Atom(0);
+}
+
+/* Matching and searching in the [len] bytes of a bigarray starting at
+   [ofs], which the caller has checked against the bigarray size (as
+   Cstruct does).  Positions, in the arguments and in the result, are
+   relative to [ofs].  This lets network code run a regexp over a
+   received buffer without copying it into a string first. */
+
+CAMLprim value re_string_match_bigarray(value re, value ba, value ofs,
+                                        value len, value pos)
+{
+  unsigned char * starttxt =
+    (unsigned char *) Caml_ba_data_val(ba) + Long_val(ofs);
+  unsigned char * txt = starttxt + Long_val(pos);
+  unsigned char * endtxt = starttxt + Long_val(len);
+
+  if (txt < starttxt || txt > endtxt)
+    caml_invalid_argument("Str.string_match");
+  if (re_match(re, starttxt, txt, endtxt, 0))
+    return re_alloc_groups(re, starttxt);
+  else
+    return Atom(0);
+}
+
+CAMLprim value re_search_forward_bigarray(value re, value ba, value ofs,
+                                          value len, value startpos)
+{
+  unsigned char * starttxt =
+    (unsigned char *) Caml_ba_data_val(ba) + Long_val(ofs);
+  unsigned char * txt = starttxt + Long_val(startpos);
+  unsigned char * endtxt = starttxt + Long_val(len);
+
+  if (txt < starttxt || txt > endtxt)
+    caml_invalid_argument("Str.search_forward");
+  if (re_search_forward_in(re, starttxt, txt, endtxt))
+    return re_alloc_groups(re, starttxt);
+  else
+    return Atom(0);
+}
+
+CAMLprim value re_search_backward_bigarray(value re, value ba, value ofs,
+                                           value len, value startpos)
+{
+  unsigned char * starttxt =
+    (unsigned char *) Caml_ba_data_val(ba) + Long_val(ofs);
+  unsigned char * txt = starttxt + Long_val(startpos);
+  unsigned char * endtxt = starttxt + Long_val(len);
+
+  if (txt < starttxt || txt > endtxt)
+    caml_invalid_argument("Str.search_backward");
+  if (re_search_backward_in(re, starttxt, txt, endtxt))
+    return re_alloc_groups(re, starttxt);
+  else
+    return Atom(0);
+}
+
 /* Replacement */
 
 CAMLprim value re_replacement_text(value repl, value groups, value orig)
@@ -11,7 +11,7 @@
 /*                                                                     */
 /***********************************************************************/
 
-/* Operations on weak arrays */
+/* Operations on weak arrays and ephemerons */
 
 #include <string.h>
 
@@ -20,8 +20,10 @@
 #include "major_gc.h"
 #include "memory.h"
 #include "mlvalues.h"
+#include "weak.h"
 
 value caml_weak_list_head = 0;
+value caml_ephe_list_head = 0;
 
 static value weak_dummy = 0;
 value caml_weak_none = (value) &weak_dummy;
@@ -36,6 +38,7 @@ CAMLprim value caml_weak_create (value len)
   res = caml_alloc_shr (size, Abstract_tag);
   for (i = 1; i < size; i++) Field (res, i) = caml_weak_none;
   Field (res, 0) = caml_weak_list_head;
+  Evac_record (&Field (res, 0), caml_weak_list_head);
   caml_weak_list_head = res;
   return res;
 }
@@ -58,6 +61,7 @@ static void do_set (value ar, mlsize_t offset, value v)
     }
   }else{
     Field (ar, offset) = v;
+    Evac_record (&Field (ar, offset), v);
   }
 }
 
@@ -189,3 +193,84 @@ CAMLprim value caml_weak_blit (value ars, value ofs,
   }
   return Val_unit;
 }
+
+/* Ephemerons.  The key and data are [caml_weak_none] when unset.  See
+   [mark_slice] for the way the major GC handles them. */
+
+/* [v] is a block of the major heap that is not marked yet. */
+int caml_ephe_is_white (value v)
+{
+  if (v == caml_weak_none || !Is_block (v) || !Is_in_heap (v)) return 0;
+  if (Tag_val (v) == Infix_tag) v -= Infix_offset_val (v);
+  return Is_white_val (v);
+}
+
+CAMLprim value caml_ephe_create (value unit)
+{
+  value res;
+
+  res = caml_alloc_shr (Ephe_size, Abstract_tag);
+  Field (res, Ephe_data) = caml_weak_none;
+  Field (res, Ephe_key) = caml_weak_none;
+  Field (res, 0) = caml_ephe_list_head;
+  Evac_record (&Field (res, 0), caml_ephe_list_head);
+  caml_ephe_list_head = res;
+  return res;
+}
+
+static value ephe_get (value e, mlsize_t offset)
+{
+  CAMLparam1 (e);
+  CAMLlocal2 (res, elt);
+                                                   Assert (Is_in_heap (e));
+  elt = Field (e, offset);
+  if (elt == caml_weak_none){
+    res = None_val;
+  }else{
+    if (caml_gc_phase == Phase_mark && Is_block (elt) && Is_in_heap (elt)){
+      caml_darken (elt, NULL);
+    }
+    res = caml_alloc_small (1, Some_tag);
+    Field (res, 0) = elt;
+  }
+  CAMLreturn (res);
+}
+
+CAMLprim value caml_ephe_get_key (value e)
+{
+  return ephe_get (e, Ephe_key);
+}
+
+CAMLprim value caml_ephe_get_data (value e)
+{
+  return ephe_get (e, Ephe_data);
+}
+
+CAMLprim value caml_ephe_check_key (value e)
+{
+  return Val_bool (Field (e, Ephe_key) != caml_weak_none);
+}
+
+CAMLprim value caml_ephe_set_key (value e, value k)
+{
+  caml_modify (&Field (e, Ephe_key), k);
+  return Val_unit;
+}
+
+CAMLprim value caml_ephe_set_data (value e, value d)
+{
+  caml_modify (&Field (e, Ephe_data), d);
+  return Val_unit;
+}
+
+CAMLprim value caml_ephe_unset_key (value e)
+{
+  caml_modify (&Field (e, Ephe_key), caml_weak_none);
+  return Val_unit;
+}
+
+CAMLprim value caml_ephe_unset_data (value e)
+{
+  caml_modify (&Field (e, Ephe_data), caml_weak_none);
+  return Val_unit;
+}
@@ -14,8 +14,11 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <stdint.h>
 #include <time.h>
 #include <sys/time.h>
+#include <mini-os/os.h>
+#include <mini-os/time.h>
 
 #include <caml/mlvalues.h>
 #include <caml/alloc.h>
@@ -59,3 +62,10 @@ unix_gmtime(value t)
   if (tm == NULL) caml_failwith("gmtime");
   CAMLreturn(alloc_tm(tm));
 }
+
+/* Clock used to time the GC pauses, see ocaml/gc_events.c. */
+uint64_t
+caml_xen_monotonic_clock(void)
+{
+  return NOW();
+}
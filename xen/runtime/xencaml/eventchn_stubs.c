@@ -33,6 +33,8 @@ static uint8_t ev_callback_ml[NR_EVENTS];
 /* Override the default Mini-OS implementation. We don't want to call the event
    handlers here (from within the interrupt handler). Instead, we'll call
    evtchn_look_for_work later. */
+extern void caml_profiler_tick(struct pt_regs *regs);
+
 void do_hypervisor_callback(struct pt_regs *regs)
 {
     int            cpu = 0;
@@ -40,8 +42,36 @@ void do_hypervisor_callback(struct pt_regs *regs)
     vcpu_info_t   *vcpu_info = &s->vcpu_info[cpu];
 
     vcpu_info->evtchn_upcall_pending = 0;
+    /* Upcalls only happen while the profiler runs, or when blocked. */
+    caml_profiler_tick(regs);
+}
+
+/* True if a port is pending for evtchn_look_for_work.  The upcalls of
+   the profiler clear evtchn_upcall_pending whatever the port, so the
+   selector is checked as well. */
+int
+evtchn_work_pending(void)
+{
+  unsigned long  l1, l1i;
+  int            cpu = 0;
+  shared_info_t *s = HYPERVISOR_shared_info;
+  vcpu_info_t   *vcpu_info = &s->vcpu_info[cpu];
+
+  if (vcpu_info->evtchn_upcall_pending)
+    return 1;
+  l1 = vcpu_info->evtchn_pending_sel;
+  while ( l1 != 0 ) {
+    l1i = __ffs(l1);
+    l1 &= ~(1UL << l1i);
+    if ( active_evtchns(cpu, s, l1i) != 0 )
+      return 1;
+  }
+  return 0;
 }
 
+/* Number of notifications passed on to OCaml, for the metrics page. */
+uintnat caml_evtchn_delivered = 0;
+
 /* Walk through the ports, setting the OCaml callback
    mask for any active ones, and clear the Xen side.
    Return true if any OCaml callbacks are needed. */
@@ -72,6 +102,7 @@ evtchn_look_for_work(void)
       port = (l1i * (sizeof(unsigned long) * 8)) + l2i;
       clear_evtchn(port);
       ev_callback_ml[port] = 1;
+      caml_evtchn_delivered++;
       work_to_do = 1;
     }
   }
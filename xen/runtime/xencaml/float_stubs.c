@@ -0,0 +1,446 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Kernels over unboxed float arrays and float64 bigarrays: sum, dot
+   product, axpy, minimum, maximum and scaling.  On x86_64 they use SSE2,
+   or AVX2 when CPUID and XGETBV report that the CPU has it and that the
+   kernel saves the YMM state; elsewhere they are plain C.  The variant
+   is chosen on first use.
+
+   Sums and dot products are accumulated in several partial sums, so
+   their rounding differs from a left-to-right loop.  [min] and [max]
+   return NaN as soon as one element is NaN, and order [-0.] before
+   [0.], so that every variant returns the same bits whatever the order
+   in which it visits the elements.  lib_test/float_kernels_test.c
+   checks the variants against each other. */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/bigarray.h>
+
+#if defined(__x86_64__) && defined(__SSE2__)
+#define HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(HAVE_SSE2) && defined(__GNUC__) && __GNUC__ >= 5
+#define HAVE_AVX2
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+/* A float array or a one-dimensional float64 bigarray. */
+static double *
+float_data(value v, size_t *len)
+{
+  if (Tag_val(v) == Custom_tag) {
+    *len = Caml_ba_array_val(v)->dim[0];
+    return (double *) Caml_ba_data_val(v);
+  }
+  *len = Wosize_val(v) / Double_wosize;
+  return (double *) v;
+}
+
+static double
+nan_value(void)
+{
+  union { uint64_t i; double d; } u;
+
+  u.i = 0x7ff8000000000000ULL;
+  return u.d;
+}
+
+/* Portable kernels */
+
+static double
+sum_c(const double *x, size_t n)
+{
+  double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    s0 += x[i]; s1 += x[i + 1]; s2 += x[i + 2]; s3 += x[i + 3];
+  }
+  for (; i < n; i++) s0 += x[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+static double
+dot_c(const double *x, const double *y, size_t n)
+{
+  double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    s0 += x[i] * y[i]; s1 += x[i + 1] * y[i + 1];
+    s2 += x[i + 2] * y[i + 2]; s3 += x[i + 3] * y[i + 3];
+  }
+  for (; i < n; i++) s0 += x[i] * y[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+static void
+axpy_c(double a, const double *x, double *y, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++) y[i] += a * x[i];
+}
+
+static void
+scale_c(double a, double *x, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++) x[i] *= a;
+}
+
+/* Minimum ([is_max] = 0) or maximum of [x[i..n-1]], starting from [m];
+   NaN if one of them is NaN.  Of two equal elements, which can only be
+   [0.] and [-0.], the minimum is the negative one. */
+static double
+extremum_tail(const double *x, size_t i, size_t n, double m, int is_max)
+{
+  for (; i < n; i++) {
+    if (x[i] != x[i]) return nan_value();
+    if (is_max ? x[i] > m : x[i] < m) m = x[i];
+    else if (x[i] == m && (signbit(x[i]) != 0) != is_max) m = x[i];
+  }
+  return m;
+}
+
+static double
+extremum_c(const double *x, size_t n, int is_max)
+{
+  return extremum_tail(x, 1, n, x[0], is_max);
+}
+
+#ifdef HAVE_SSE2
+
+static double
+sum_sse2(const double *x, size_t n)
+{
+  __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+  double r[2], s;
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    a0 = _mm_add_pd(a0, _mm_loadu_pd(x + i));
+    a1 = _mm_add_pd(a1, _mm_loadu_pd(x + i + 2));
+  }
+  _mm_storeu_pd(r, _mm_add_pd(a0, a1));
+  s = r[0] + r[1];
+  for (; i < n; i++) s += x[i];
+  return s;
+}
+
+static double
+dot_sse2(const double *x, const double *y, size_t n)
+{
+  __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+  double r[2], s;
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    a0 = _mm_add_pd(a0, _mm_mul_pd(_mm_loadu_pd(x + i),
+                                   _mm_loadu_pd(y + i)));
+    a1 = _mm_add_pd(a1, _mm_mul_pd(_mm_loadu_pd(x + i + 2),
+                                   _mm_loadu_pd(y + i + 2)));
+  }
+  _mm_storeu_pd(r, _mm_add_pd(a0, a1));
+  s = r[0] + r[1];
+  for (; i < n; i++) s += x[i] * y[i];
+  return s;
+}
+
+static void
+axpy_sse2(double a, const double *x, double *y, size_t n)
+{
+  __m128d va = _mm_set1_pd(a);
+  size_t i = 0;
+
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i),
+                                    _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+  for (; i < n; i++) y[i] += a * x[i];
+}
+
+static void
+scale_sse2(double a, double *x, size_t n)
+{
+  __m128d va = _mm_set1_pd(a);
+  size_t i = 0;
+
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(x + i, _mm_mul_pd(va, _mm_loadu_pd(x + i)));
+  for (; i < n; i++) x[i] *= a;
+}
+
+/* [_mm_min_pd] and [_mm_max_pd] return their second argument when the
+   two compare equal; merge the bits of equal lanes instead, so that
+   [-0.] wins in [min_sse2] and [0.] in [max_sse2]. */
+static inline __m128d
+min_sse2(__m128d m, __m128d v)
+{
+  return _mm_or_pd(_mm_min_pd(m, v), _mm_and_pd(m, _mm_cmpeq_pd(m, v)));
+}
+
+static inline __m128d
+max_sse2(__m128d m, __m128d v)
+{
+  return _mm_and_pd(_mm_max_pd(m, v), _mm_or_pd(m, _mm_cmpneq_pd(m, v)));
+}
+
+static double
+extremum_sse2(const double *x, size_t n, int is_max)
+{
+  __m128d m, v, nan;
+  double r[2];
+  size_t i;
+
+  if (n < 2) return extremum_c(x, n, is_max);
+  m = _mm_loadu_pd(x);
+  nan = _mm_cmpunord_pd(m, m);
+  for (i = 2; i + 2 <= n; i += 2) {
+    v = _mm_loadu_pd(x + i);
+    nan = _mm_or_pd(nan, _mm_cmpunord_pd(v, v));
+    m = is_max ? max_sse2(m, v) : min_sse2(m, v);
+  }
+  if (_mm_movemask_pd(nan) != 0) return nan_value();
+  _mm_storeu_pd(r, m);
+  return extremum_tail(x, i, n, extremum_tail(r, 1, 2, r[0], is_max),
+                       is_max);
+}
+
+#endif /* HAVE_SSE2 */
+
+#ifdef HAVE_AVX2
+
+static AVX2 double
+sum_avx2(const double *x, size_t n)
+{
+  __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+  double r[4], s;
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    a0 = _mm256_add_pd(a0, _mm256_loadu_pd(x + i));
+    a1 = _mm256_add_pd(a1, _mm256_loadu_pd(x + i + 4));
+  }
+  _mm256_storeu_pd(r, _mm256_add_pd(a0, a1));
+  s = (r[0] + r[1]) + (r[2] + r[3]);
+  for (; i < n; i++) s += x[i];
+  return s;
+}
+
+static AVX2 double
+dot_avx2(const double *x, const double *y, size_t n)
+{
+  __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+  double r[4], s;
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    a0 = _mm256_add_pd(a0, _mm256_mul_pd(_mm256_loadu_pd(x + i),
+                                         _mm256_loadu_pd(y + i)));
+    a1 = _mm256_add_pd(a1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4),
+                                         _mm256_loadu_pd(y + i + 4)));
+  }
+  _mm256_storeu_pd(r, _mm256_add_pd(a0, a1));
+  s = (r[0] + r[1]) + (r[2] + r[3]);
+  for (; i < n; i++) s += x[i] * y[i];
+  return s;
+}
+
+static AVX2 void
+axpy_avx2(double a, const double *x, double *y, size_t n)
+{
+  __m256d va = _mm256_set1_pd(a);
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(y + i,
+                     _mm256_add_pd(_mm256_loadu_pd(y + i),
+                                   _mm256_mul_pd(va, _mm256_loadu_pd(x + i))));
+  for (; i < n; i++) y[i] += a * x[i];
+}
+
+static AVX2 void
+scale_avx2(double a, double *x, size_t n)
+{
+  __m256d va = _mm256_set1_pd(a);
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(x + i, _mm256_mul_pd(va, _mm256_loadu_pd(x + i)));
+  for (; i < n; i++) x[i] *= a;
+}
+
+static inline AVX2 __m256d
+min_avx2(__m256d m, __m256d v)
+{
+  return _mm256_or_pd(_mm256_min_pd(m, v),
+                      _mm256_and_pd(m, _mm256_cmp_pd(m, v, _CMP_EQ_OQ)));
+}
+
+static inline AVX2 __m256d
+max_avx2(__m256d m, __m256d v)
+{
+  return _mm256_and_pd(_mm256_max_pd(m, v),
+                       _mm256_or_pd(m, _mm256_cmp_pd(m, v, _CMP_NEQ_UQ)));
+}
+
+static AVX2 double
+extremum_avx2(const double *x, size_t n, int is_max)
+{
+  __m256d m, v, nan;
+  double r[4];
+  size_t i;
+
+  if (n < 4) return extremum_c(x, n, is_max);
+  m = _mm256_loadu_pd(x);
+  nan = _mm256_cmp_pd(m, m, _CMP_UNORD_Q);
+  for (i = 4; i + 4 <= n; i += 4) {
+    v = _mm256_loadu_pd(x + i);
+    nan = _mm256_or_pd(nan, _mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+    m = is_max ? max_avx2(m, v) : min_avx2(m, v);
+  }
+  if (_mm256_movemask_pd(nan) != 0) return nan_value();
+  _mm256_storeu_pd(r, m);
+  return extremum_tail(x, i, n, extremum_tail(r, 1, 4, r[0], is_max),
+                       is_max);
+}
+
+static int
+cpu_has_avx2(void)
+{
+  uint32_t a, b, c, d, lo, hi;
+
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(0), "c"(0));
+  if (a < 7) return 0;
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(1), "c"(0));
+  if (!(c & (1 << 27)) || !(c & (1 << 28))) return 0;  /* OSXSAVE, AVX */
+  __asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  if ((lo & 6) != 6) return 0;                         /* XMM, YMM state */
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(7), "c"(0));
+  return (b >> 5) & 1;                                 /* AVX2 */
+}
+
+#endif /* HAVE_AVX2 */
+
+struct float_kernels {
+  double (*sum)(const double *, size_t);
+  double (*dot)(const double *, const double *, size_t);
+  void (*axpy)(double, const double *, double *, size_t);
+  void (*scale)(double, double *, size_t);
+  double (*extremum)(const double *, size_t, int);
+};
+
+static struct float_kernels selected = { NULL, NULL, NULL, NULL, NULL };
+
+static void
+select_kernels(void)
+{
+  selected.sum = sum_c;
+  selected.dot = dot_c;
+  selected.axpy = axpy_c;
+  selected.scale = scale_c;
+  selected.extremum = extremum_c;
+#ifdef HAVE_SSE2
+  selected.sum = sum_sse2;
+  selected.dot = dot_sse2;
+  selected.axpy = axpy_sse2;
+  selected.scale = scale_sse2;
+  selected.extremum = extremum_sse2;
+#endif
+#ifdef HAVE_AVX2
+  if (cpu_has_avx2()) {
+    selected.sum = sum_avx2;
+    selected.dot = dot_avx2;
+    selected.axpy = axpy_avx2;
+    selected.scale = scale_avx2;
+    selected.extremum = extremum_avx2;
+  }
+#endif
+}
+
+static const struct float_kernels *
+kernels(void)
+{
+  if (selected.sum == NULL) select_kernels();
+  return &selected;
+}
+
+/* The OCaml side checks that the lengths agree and that [min] and [max]
+   are not applied to empty vectors. */
+
+CAMLprim value
+caml_float_vec_sum(value vx)
+{
+  size_t n;
+  double *x = float_data(vx, &n);
+
+  return caml_copy_double(kernels()->sum(x, n));
+}
+
+CAMLprim value
+caml_float_vec_dot(value vx, value vy)
+{
+  size_t n, ny;
+  double *x = float_data(vx, &n), *y = float_data(vy, &ny);
+
+  return caml_copy_double(kernels()->dot(x, y, n));
+}
+
+CAMLprim value
+caml_float_vec_axpy(value a, value vx, value vy)
+{
+  size_t n, ny;
+  double *x = float_data(vx, &n), *y = float_data(vy, &ny);
+
+  kernels()->axpy(Double_val(a), x, y, n);
+  return Val_unit;
+}
+
+CAMLprim value
+caml_float_vec_scale(value a, value vx)
+{
+  size_t n;
+  double *x = float_data(vx, &n);
+
+  kernels()->scale(Double_val(a), x, n);
+  return Val_unit;
+}
+
+CAMLprim value
+caml_float_vec_min(value vx)
+{
+  size_t n;
+  double *x = float_data(vx, &n);
+
+  return caml_copy_double(kernels()->extremum(x, n, 0));
+}
+
+CAMLprim value
+caml_float_vec_max(value vx)
+{
+  size_t n;
+  double *x = float_data(vx, &n);
+
+  return caml_copy_double(kernels()->extremum(x, n, 1));
+}
@@ -0,0 +1,161 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Fast seedable 64-bit hash of byte ranges in strings and bigarrays,
+   after wyhash (Wang Yi, public domain).  It reads 16 or 48 bytes per
+   round with 64x64->128 bit multiplies, so it is much faster than
+   [Hashtbl.hash] on long inputs, and it sees every byte, where
+   [Hashtbl.hash] stops after the first 256 bytes of a string.  It is
+   not a cryptographic hash. */
+
+#include <stdint.h>
+#include <string.h>
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/bigarray.h>
+
+static const uint64_t secret[4] = {
+  0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+  0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+/* 64x64->128 bit multiply: the low half in [*a], the high half in [*b]. */
+static inline void
+mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+  __uint128_t r = (__uint128_t) *a * *b;
+  *a = (uint64_t) r;
+  *b = (uint64_t) (r >> 64);
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32), c = t < rl, lo = t + (rm1 << 32);
+  c += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t
+mix(uint64_t a, uint64_t b)
+{
+  mum(&a, &b);
+  return a ^ b;
+}
+
+/* Little-endian loads, so that the hash is the same on every host. */
+static inline uint64_t
+read64(const uint8_t *p)
+{
+  uint64_t v;
+  memcpy(&v, p, 8);
+#ifdef ARCH_BIG_ENDIAN
+  v = __builtin_bswap64(v);
+#endif
+  return v;
+}
+
+static inline uint64_t
+read32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, 4);
+#ifdef ARCH_BIG_ENDIAN
+  v = __builtin_bswap32(v);
+#endif
+  return v;
+}
+
+static uint64_t
+hash64(uint64_t seed, const uint8_t *p, size_t len)
+{
+  uint64_t a, b;
+  size_t i;
+
+  seed ^= mix(seed ^ secret[0], secret[1]);
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (read32(p) << 32) | read32(p + ((len >> 3) << 2));
+      b = (read32(p + len - 4) << 32) | read32(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    i = len;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = mix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+        see1 = mix(read64(p + 16) ^ secret[2], read64(p + 24) ^ see1);
+        see2 = mix(read64(p + 32) ^ secret[3], read64(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = mix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = read64(p + i - 16);
+    b = read64(p + i - 8);
+  }
+  a ^= secret[1];
+  b ^= seed;
+  mum(&a, &b);
+  return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+/* The offsets and lengths are checked by the OCaml side. */
+
+CAMLprim value
+caml_hash64_string(value v_seed, value v_str, value v_ofs, value v_len)
+{
+  return caml_copy_int64(hash64(Long_val(v_seed),
+                                (uint8_t *) String_val(v_str) + Long_val(v_ofs),
+                                Long_val(v_len)));
+}
+
+CAMLprim value
+caml_hash64_bigarray(value v_seed, value v_ba, value v_ofs, value v_len)
+{
+  return caml_copy_int64(hash64(Long_val(v_seed),
+                                (uint8_t *) Caml_ba_data_val(v_ba) + Long_val(v_ofs),
+                                Long_val(v_len)));
+}
+
+/* Variants returning the hash truncated to an OCaml int, which do not
+   allocate. */
+
+CAMLprim value
+caml_hash64_string_int(value v_seed, value v_str, value v_ofs, value v_len)
+{
+  return Val_long(hash64(Long_val(v_seed),
+                         (uint8_t *) String_val(v_str) + Long_val(v_ofs),
+                         Long_val(v_len)));
+}
+
+CAMLprim value
+caml_hash64_bigarray_int(value v_seed, value v_ba, value v_ofs, value v_len)
+{
+  return Val_long(hash64(Long_val(v_seed),
+                         (uint8_t *) Caml_ba_data_val(v_ba) + Long_val(v_ofs),
+                         Long_val(v_len)));
+}
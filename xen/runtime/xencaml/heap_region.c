@@ -0,0 +1,231 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Backing store for the OCaml major heap.
+
+   The first time the runtime asks for a heap chunk, a contiguous virtual
+   region as large as the memory of the domain is reserved in the Mini-OS
+   demand-map area.  Heap chunks are carved out of it by a first-fit
+   extent allocator over an address-ordered array of free extents, and
+   each page of a chunk is backed by a frame taken from the page
+   allocator.  None of this goes through _xmalloc, so the heap does not
+   fragment the arena shared with Io_page and the C stubs, and large
+   chunks are not rounded up to a power-of-two page order.
+
+   If the region cannot be reserved (or is exhausted), the functions
+   below fail and memory.c falls back to caml_aligned_malloc. */
+
+#include <stdint.h>
+#include <string.h>
+#include <mini-os/os.h>
+#include <mini-os/mm.h>
+#include <mini-os/lib.h>
+#include <xen/xen.h>
+
+/* For printk() */
+#include <log.h>
+
+struct extent {
+  unsigned long start;      /* index of the first page in the region */
+  unsigned long npages;
+};
+
+static unsigned long region_pages = 0;
+static unsigned long region_mapped = 0; /* pages currently backed */
+static int region_state = 0;            /* 0: not yet, 1: ready, -1: none */
+
+#if defined(__x86_64__)
+static unsigned long region_base = 0;   /* virtual address of the region */
+static uint32_t *region_pfn = NULL;     /* backing frame of each page */
+static struct extent *free_ext = NULL;  /* sorted by [start] */
+static unsigned long free_ext_count = 0, free_ext_capacity = 0;
+
+#define Map_batch 512
+
+static int region_init(void)
+{
+  region_pages = start_info.nr_pages;
+  region_pfn = malloc(region_pages * sizeof(uint32_t));
+  free_ext_capacity = 16;
+  free_ext = malloc(free_ext_capacity * sizeof(struct extent));
+  if (region_pfn != NULL && free_ext != NULL)
+    region_base = allocate_ondemand(region_pages, 1);
+  if (region_base == 0) {
+    printk("heap_region: cannot reserve %lu pages, using malloc\n",
+           region_pages);
+    free(region_pfn);
+    free(free_ext);
+    return -1;
+  }
+  free_ext[0].start = 0;
+  free_ext[0].npages = region_pages;
+  free_ext_count = 1;
+  return 1;
+}
+
+/* Remove [npages] pages from the free extents; return the index of the
+   first page, or -1 if no extent is large enough. */
+static long extent_take(unsigned long npages)
+{
+  unsigned long i, start;
+
+  for (i = 0; i < free_ext_count; i++) {
+    if (free_ext[i].npages >= npages) {
+      start = free_ext[i].start;
+      free_ext[i].start += npages;
+      free_ext[i].npages -= npages;
+      if (free_ext[i].npages == 0) {
+        memmove(&free_ext[i], &free_ext[i + 1],
+                (free_ext_count - i - 1) * sizeof(struct extent));
+        free_ext_count--;
+      }
+      return start;
+    }
+  }
+  return -1;
+}
+
+/* Give [npages] pages starting at [start] back to the free extents,
+   merging with the neighbours when they are adjacent. */
+static void extent_give(unsigned long start, unsigned long npages)
+{
+  unsigned long i = 0;
+  int merge_prev, merge_next;
+
+  while (i < free_ext_count && free_ext[i].start < start) i++;
+  merge_prev = i > 0
+    && free_ext[i - 1].start + free_ext[i - 1].npages == start;
+  merge_next = i < free_ext_count && start + npages == free_ext[i].start;
+
+  if (merge_prev && merge_next) {
+    free_ext[i - 1].npages += npages + free_ext[i].npages;
+    memmove(&free_ext[i], &free_ext[i + 1],
+            (free_ext_count - i - 1) * sizeof(struct extent));
+    free_ext_count--;
+  } else if (merge_prev) {
+    free_ext[i - 1].npages += npages;
+  } else if (merge_next) {
+    free_ext[i].start = start;
+    free_ext[i].npages += npages;
+  } else {
+    if (free_ext_count == free_ext_capacity) {
+      struct extent *bigger =
+        realloc(free_ext, 2 * free_ext_capacity * sizeof(struct extent));
+      if (bigger == NULL) {
+        /* The pages are already unmapped; only the address space leaks. */
+        printk("heap_region: losing %lu pages of address space\n", npages);
+        return;
+      }
+      free_ext = bigger;
+      free_ext_capacity *= 2;
+    }
+    memmove(&free_ext[i + 1], &free_ext[i],
+            (free_ext_count - i) * sizeof(struct extent));
+    free_ext[i].start = start;
+    free_ext[i].npages = npages;
+    free_ext_count++;
+  }
+}
+
+static void unback_pages(unsigned long start, unsigned long npages)
+{
+  unsigned long i;
+
+  unmap_frames(region_base + start * PAGE_SIZE, npages);
+  for (i = start; i < start + npages; i++)
+    free_page((void *) pfn_to_virt(region_pfn[i]));
+  region_mapped -= npages;
+}
+
+/* Back [npages] pages starting at [start] with fresh frames. */
+static int back_pages(unsigned long start, unsigned long npages)
+{
+  unsigned long mfns[Map_batch];
+  unsigned long done = 0, n, i, va;
+
+  while (done < npages) {
+    n = npages - done;
+    if (n > Map_batch) n = Map_batch;
+    for (i = 0; i < n; i++) {
+      va = alloc_page();
+      if (va == 0) {
+        while (i-- > 0) free_page((void *) mfn_to_virt(mfns[i]));
+        if (done > 0) unback_pages(start, done);
+        return -1;
+      }
+      region_pfn[start + done + i] = virt_to_pfn(va);
+      mfns[i] = virt_to_mfn(va);
+    }
+    if (do_map_frames(region_base + (start + done) * PAGE_SIZE, mfns, n,
+                      1, 0, DOMID_SELF, NULL, L1_PROT) != 0) {
+      for (i = 0; i < n; i++) free_page((void *) mfn_to_virt(mfns[i]));
+      if (done > 0) unback_pages(start, done);
+      return -1;
+    }
+    region_mapped += n;
+    done += n;
+  }
+  return 0;
+}
+#endif
+
+/* Allocate [size] bytes (a multiple of the page size) from the heap
+   region.  Return NULL if the region is unavailable or out of space. */
+char *caml_heap_region_alloc(unsigned long size)
+{
+#if defined(__x86_64__)
+  unsigned long npages = size / PAGE_SIZE;
+  long start;
+
+  if (region_state == 0) region_state = region_init();
+  if (region_state < 0) return NULL;
+
+  start = extent_take(npages);
+  if (start < 0) return NULL;
+  if (back_pages(start, npages) != 0) {
+    extent_give(start, npages);
+    return NULL;
+  }
+  return (char *) (region_base + start * PAGE_SIZE);
+#else
+  return NULL;
+#endif
+}
+
+/* Release a block obtained from [caml_heap_region_alloc].  Return -1 if
+   [p] does not belong to the region, 0 otherwise. */
+int caml_heap_region_free(char *p, unsigned long size)
+{
+#if defined(__x86_64__)
+  unsigned long start, npages = size / PAGE_SIZE;
+
+  if (region_state <= 0 || (unsigned long) p < region_base
+      || (unsigned long) p >= region_base + region_pages * PAGE_SIZE)
+    return -1;
+  start = ((unsigned long) p - region_base) / PAGE_SIZE;
+  unback_pages(start, npages);
+  extent_give(start, npages);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+/* Number of pages reserved for the region and currently backed by
+   frames. */
+void caml_heap_region_stats(unsigned long *reserved, unsigned long *mapped)
+{
+  *reserved = region_state > 0 ? region_pages : 0;
+  *mapped = region_mapped;
+}
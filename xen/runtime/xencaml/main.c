@@ -15,7 +15,9 @@
  */
 
 #include <mini-os/os.h>
+#include <mini-os/lib.h>
 #include <mini-os/sched.h>
+#include <mini-os/time.h>
 
 #include <caml/mlvalues.h>
 #include <caml/memory.h>
@@ -26,14 +28,106 @@ int errno;
 static char *argv[] = { "mirage", NULL };
 static unsigned long irqflags;
 
+extern int evtchn_work_pending(void);
+extern int caml_profiler_idle;
+extern void caml_profiler_drain(void);
+extern void caml_metrics_blocking(s_time_t start, s_time_t swept);
+extern void caml_metrics_woken(s_time_t now);
+
 CAMLprim value
 caml_block_domain(value v_until)
 {
   CAMLparam1(v_until);
-  block_domain((s_time_t)(Double_val(v_until) * 1000000000));
+  s_time_t until = (s_time_t)(Double_val(v_until) * 1000000000);
+  s_time_t start = NOW();
+  unsigned long flags;
+
+  /* Nothing to do until an event arrives or the timeout expires: use
+     the time to sweep the major heap, so that allocations do not have
+     to do it later. */
+  while (!evtchn_work_pending() && NOW() < until && caml_sweep_lazily())
+    ;
+  caml_metrics_blocking(start, NOW());
+  caml_profiler_drain();
+  caml_profiler_idle = 1;
+  /* SCHEDOP_block only looks at evtchn_upcall_pending, which a profiler
+     upcall may have cleared: test the ports with upcalls off, so that
+     none is missed between the test and the block. */
+  local_irq_save(flags);
+  if (!evtchn_work_pending())
+    block_domain(until);
+  local_irq_restore(flags);
+  caml_profiler_idle = 0;
+  caml_metrics_woken(NOW());
   CAMLreturn(Val_unit);
 }
 
+/* Boot-time sizes of the heaps, in thousandths of the memory of the
+   domain, so that a large domain does not spend its first seconds
+   growing a heap of 31 pages.  They can be changed on the command line
+   with MIRAGE_HEAP, e.g. "MIRAGE_HEAP=h=250,s=8"; OCAMLRUNPARAM, which
+   the runtime parses afterwards, still overrides the resulting sizes.
+   The stock defaults are a lower bound. */
+static unsigned long heap_permille = 125;       /* h: initial major heap */
+static unsigned long incr_permille = 31;        /* i: major heap increment */
+static unsigned long minor_permille = 4;        /* s: minor heap */
+static unsigned long external_permille = 250;   /* x: external memory */
+
+#define Minor_heap_cap (32 * 1024 * 1024)       /* bytes */
+
+static void parse_heap_fractions(const char *opt)
+{
+  char c, *end;
+  unsigned long v;
+
+  while (*opt != '\0') {
+    c = *opt++;
+    if (*opt != '=') continue;
+    v = simple_strtoul(opt + 1, &end, 10);
+    opt = end;
+    if (v > 1000) v = 1000;
+    switch (c) {
+    case 'h': heap_permille = v; break;
+    case 'i': incr_permille = v; break;
+    case 's': minor_permille = v; break;
+    case 'x': external_permille = v; break;
+    }
+  }
+}
+
+static void size_up(uintnat *wsz, uint64_t bytes)
+{
+  if (bytes / sizeof(value) > *wsz) *wsz = bytes / sizeof(value);
+}
+
+/* Called by caml_main, before it parses OCAMLRUNPARAM.  Sizes are in
+   words, as in OCAMLRUNPARAM. */
+void caml_xen_heap_sizes(uintnat *minor_wsz, uintnat *heap_wsz,
+                         uintnat *incr_wsz)
+{
+  uint64_t mem = (uint64_t) start_info.nr_pages * PAGE_SIZE;
+  uint64_t minor;
+  char *opt = getenv("MIRAGE_HEAP");
+
+  if (opt != NULL) parse_heap_fractions(opt);
+  minor = mem * minor_permille / 1000;
+  if (minor > Minor_heap_cap) minor = Minor_heap_cap;
+  size_up(minor_wsz, minor);
+  size_up(heap_wsz, mem * heap_permille / 1000);
+  size_up(incr_wsz, mem * incr_permille / 1000);
+  /* Io_page buffers and other bigarrays come from the malloc arena,
+     which shares the memory of the domain with the heap. */
+  if (external_permille > 0)
+    caml_external_budget = mem * external_permille / 1000;
+  printk("xencaml: %lu MiB: minor heap %luk, major heap %luk "
+         "(+%luk), external budget %luk\n",
+         (unsigned long) (mem >> 20),
+         (unsigned long) (Bsize_wsize(*minor_wsz) / 1024),
+         (unsigned long) (Bsize_wsize(*heap_wsz) / 1024),
+         (unsigned long) (Bsize_wsize(*incr_wsz) / 1024),
+         (unsigned long) (caml_external_budget / 1024));
+}
+
 #define CAML_ENTRYPOINT "OS.Main.run"
 
 void app_main_thread(void *unused)
@@ -0,0 +1,171 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Runtime metrics page.
+
+   A page of counters that the runtime refreshes each time the domain
+   blocks, and that OS.Metrics grants read-only to dom0, which can
+   then monitor the domain without asking anything of it.
+
+   The layout is little-endian: a 32-bit magic ("MMET"), a 32-bit
+   version, a 32-bit sequence number and a 32-bit number of fields,
+   then that many 64-bit fields, in the order of [enum field] below.
+   Fields are only ever added at the end, so a reader can ignore those
+   it does not know; the version changes if the meaning of an existing
+   field changes.
+
+   The sequence number is odd while the page is being updated.  A
+   reader copies the fields between two reads of the sequence number,
+   and starts again unless both are the same even number.  Times are
+   in nanoseconds since the domain started. */
+
+#include <stdint.h>
+#include <string.h>
+#include <mini-os/os.h>
+#include <mini-os/time.h>
+
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/bigarray.h>
+#include <caml/gc_ctrl.h>
+#include <caml/memory.h>
+
+#define Metrics_magic 0x54454D4D        /* "MMET" */
+#define Metrics_version 1
+
+enum field {
+  F_updated,              /* time of the last update */
+  F_minor_words,          /* words allocated in the minor heap */
+  F_promoted_words,
+  F_major_words,
+  F_minor_collections,
+  F_major_collections,
+  F_compactions,
+  F_heap_bytes,
+  F_top_heap_bytes,
+  F_heap_chunks,
+  F_external_bytes,       /* Io_page buffers and other bigarrays */
+  F_external_peak,
+  F_region_pages,         /* pages reserved for the major heap */
+  F_region_mapped,        /* ... and currently backed by frames */
+  F_events,               /* event channel notifications delivered */
+  F_blocks,               /* iterations of the main loop that blocked */
+  F_run_ns,               /* time running, outside of the two below */
+  F_sweep_ns,             /* time sweeping the heap before blocking */
+  F_blocked_ns,           /* time blocked */
+  F_timers,               /* threads in the sleep queue */
+  F_count
+};
+
+struct metrics {
+  uint32_t magic;
+  uint32_t version;
+  volatile uint32_t seq;
+  uint32_t nfields;
+  uint64_t field[F_count];
+};
+
+static union {
+  struct metrics m;
+  char bytes[PAGE_SIZE];
+} page __attribute__((aligned(PAGE_SIZE)));
+
+extern uintnat caml_evtchn_delivered;
+extern void caml_heap_region_stats(unsigned long *, unsigned long *);
+
+static uint64_t blocks = 0, run_ns = 0, sweep_ns = 0, blocked_ns = 0;
+static uint64_t timers = 0;
+static s_time_t last_wake = 0, last_block = 0;
+
+static void
+update(void)
+{
+  struct metrics *m = &page.m;
+  unsigned long reserved, mapped;
+
+  caml_heap_region_stats(&reserved, &mapped);
+  if (m->magic != Metrics_magic) {
+    m->magic = Metrics_magic;
+    m->version = Metrics_version;
+    m->nfields = F_count;
+  }
+  m->seq++;
+  wmb();
+  m->field[F_updated] = NOW();
+  m->field[F_minor_words] = caml_stat_minor_words;
+  m->field[F_promoted_words] = caml_stat_promoted_words;
+  m->field[F_major_words] = caml_stat_major_words;
+  m->field[F_minor_collections] = caml_stat_minor_collections;
+  m->field[F_major_collections] = caml_stat_major_collections;
+  m->field[F_compactions] = caml_stat_compactions;
+  m->field[F_heap_bytes] = caml_stat_heap_size;
+  m->field[F_top_heap_bytes] = caml_stat_top_heap_size;
+  m->field[F_heap_chunks] = caml_stat_heap_chunks;
+  m->field[F_external_bytes] = caml_external_size;
+  m->field[F_external_peak] = caml_external_peak;
+  m->field[F_region_pages] = reserved;
+  m->field[F_region_mapped] = mapped;
+  m->field[F_events] = caml_evtchn_delivered;
+  m->field[F_blocks] = blocks;
+  m->field[F_run_ns] = run_ns;
+  m->field[F_sweep_ns] = sweep_ns;
+  m->field[F_blocked_ns] = blocked_ns;
+  m->field[F_timers] = timers;
+  wmb();
+  m->seq++;
+}
+
+/* Called by caml_block_domain: the main loop started sweeping at
+   [start], and is about to block after sweeping until [swept]. */
+void
+caml_metrics_blocking(s_time_t start, s_time_t swept)
+{
+  run_ns += start - last_wake;
+  sweep_ns += swept - start;
+  blocks++;
+  last_block = swept;
+  update();
+}
+
+/* Called by caml_block_domain when the domain is woken up at [now]. */
+void
+caml_metrics_woken(s_time_t now)
+{
+  blocked_ns += now - last_block;
+  last_wake = now;
+}
+
+CAMLprim value
+caml_metrics_set_timers(value v_timers)
+{
+  timers = Long_val(v_timers);
+  return Val_unit;
+}
+
+CAMLprim value
+caml_metrics_update(value v_unit)
+{
+  update();
+  return Val_unit;
+}
+
+CAMLprim value
+caml_metrics_page(value v_unit)
+{
+  if (page.m.magic != Metrics_magic) update();
+  return caml_ba_alloc_dims(CAML_BA_UINT8 | CAML_BA_C_LAYOUT
+                            | CAML_BA_EXTERNAL, 1, page.bytes,
+                            (intnat) PAGE_SIZE);
+}
@@ -52,9 +52,28 @@
 	return ret; \
     }
 
+/* There is no environment: variables are read from the command line
+   of the domain, as space-separated NAME=VALUE words (set with [extra]
+   in the xl configuration).  The result is overwritten by the next
+   call. */
 char *getenv(const char *name)
 {
-  printk("getenv(%s) -> null\n", name);
+  static char value[MAX_GUEST_CMDLINE + 1];
+  const char *p = (const char *) start_info.cmd_line;
+  const char *end = p + strnlen(p, MAX_GUEST_CMDLINE);
+  size_t len = strlen(name), n;
+
+  while (p < end) {
+    while (p < end && *p == ' ') p++;
+    for (n = 0; p + n < end && p[n] != ' '; n++)
+      ;
+    if (n > len && p[len] == '=' && memcmp(p, name, len) == 0) {
+      memcpy(value, p + len + 1, n - len - 1);
+      value[n - len - 1] = 0;
+      return value;
+    }
+    p += n;
+  }
   return NULL;
 }
 
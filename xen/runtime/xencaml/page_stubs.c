@@ -26,7 +26,9 @@
 
 /* Allocate a page-aligned bigarray of length [n_pages] pages.
    Since CAML_BA_MANAGED is set the bigarray C finaliser will
-   call free() whenever all sub-bigarrays are unreachable.
+   call free() whenever all sub-bigarrays are unreachable, and
+   the pages count against the external memory budget of the GC
+   until then.
  */
 CAMLprim value
 caml_alloc_pages(value n_pages)
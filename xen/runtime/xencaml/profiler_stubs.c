@@ -0,0 +1,425 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Sampling CPU profiler.
+
+   While the profiler runs, the periodic timer of the VCPU is set to
+   the sampling period and event upcalls are enabled, so that each
+   VIRQ_TIMER interrupts whatever the domain is doing.  The upcall
+   (see eventchn_stubs.c) records the interrupted PC and the OCaml
+   return addresses above it into a ring of preallocated samples; it
+   allocates nothing and takes no lock.
+
+   The interrupted code is not at a call site, so its frame size is
+   unknown: when it is OCaml code, the walk starts from the first word
+   of the stack that is a known return address; when it is C code
+   called from OCaml, it starts from [caml_bottom_of_stack].  The walk
+   stays within the stack and stops at callbacks from C, so a stale
+   word can make a sample wrong but not crash it.  Samples taken while
+   the domain is blocked are counted as idle.
+
+   The ring is drained, in normal context, into a table of call stacks
+   each time the domain blocks and when the profile is read. */
+
+#include <stdint.h>
+#include <string.h>
+#include <mini-os/os.h>
+#include <mini-os/events.h>
+#include <mini-os/lib.h>
+#include <xen/event_channel.h>
+#include <xen/vcpu.h>
+
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/fail.h>
+#include <caml/stack.h>
+
+/* For printk() */
+#include <log.h>
+
+#define Prof_depth 32         /* frames per sample, interrupted PC included */
+#define Prof_scan 64          /* stack words searched for a return address */
+#define Prof_ring 1024        /* samples between two drains; a power of 2 */
+#define Xen_default_period 10000000ULL  /* ns, for PV guests */
+
+struct sample {
+  uintnat nframes;            /* 0 if the domain was blocked */
+  uintnat pcs[Prof_depth];    /* innermost first */
+};
+
+struct stack {
+  uintnat hash;
+  uintnat count;
+  uintnat nframes;
+  uintnat pcs[1];
+};
+
+int caml_profiler_idle = 0;   /* set by caml_block_domain */
+
+static int timer_port = -1;   /* -1 when not profiling */
+static uint64_t saved_period; /* ns, put back by caml_profiler_stop */
+static struct sample *ring = NULL;
+static uintnat ring_head = 0, ring_tail = 0;
+static uintnat dropped = 0, idle_samples = 0;
+static struct stack **stacks = NULL;
+static uintnat stacks_mask = 0, num_stacks = 0;
+
+#if defined(__x86_64__)
+
+extern char *caml_code_area_start, *caml_code_area_end;
+
+static frame_descr *
+find_descr(uintnat pc)
+{
+  uintnat h = Hash_retaddr(pc);
+  frame_descr *d;
+
+  while ((d = caml_frame_descriptors[h]) != NULL) {
+    if (d->retaddr == pc) return d;
+    h = (h + 1) & caml_frame_descriptors_mask;
+  }
+  return NULL;
+}
+
+/* Append to [pcs] the return addresses of the OCaml frames from the one
+   that returns to [pc] with stack pointer [sp], up to [top]. */
+static uintnat
+walk(uintnat pc, char *sp, char *top, uintnat *pcs, uintnat n)
+{
+  frame_descr *d;
+
+  while (n < Prof_depth) {
+    d = find_descr(pc);
+    if (d == NULL || d->frame_size == 0xFFFF) break;
+    pcs[n++] = pc;
+    sp += d->frame_size & 0xFFFC;
+    if (sp > top) break;
+    pc = Saved_return_address(sp);
+  }
+  return n;
+}
+
+static uintnat
+capture(struct pt_regs *regs, uintnat *pcs)
+{
+  char *pc = (char *) regs->rip, *sp = (char *) regs->rsp;
+  char *top = caml_top_of_stack;
+  uintnat *p;
+  int i;
+
+  pcs[0] = regs->rip;
+  if (top == NULL || sp >= top) return 1;
+  if (pc >= caml_code_area_start && pc < caml_code_area_end) {
+    for (p = (uintnat *) sp, i = 0;
+         i < Prof_scan && (char *) (p + 1) <= top; p++, i++)
+      if (find_descr(*p) != NULL)
+        return walk(*p, (char *) (p + 1), top, pcs, 1);
+    return 1;
+  }
+  if (caml_bottom_of_stack >= sp && caml_bottom_of_stack < top)
+    return walk(caml_last_return_address, caml_bottom_of_stack, top, pcs, 1);
+  return 1;
+}
+
+/* Called by the event upcall, with events disabled. */
+void
+caml_profiler_tick(struct pt_regs *regs)
+{
+  shared_info_t *s = HYPERVISOR_shared_info;
+  struct sample *smp;
+
+  if (timer_port < 0 || !synch_test_bit(timer_port, &s->evtchn_pending[0]))
+    return;
+  clear_evtchn(timer_port);
+  if (ring_head - ring_tail >= Prof_ring) {
+    dropped++;
+    return;
+  }
+  smp = &ring[ring_head & (Prof_ring - 1)];
+  smp->nframes = caml_profiler_idle ? 0 : capture(regs, smp->pcs);
+  ring_head++;
+}
+
+/* The port bound to VIRQ_TIMER by Mini-OS, or -1. */
+static int
+find_timer_port(void)
+{
+  evtchn_status_t op;
+  int port;
+
+  for (port = 1; port < (int) (sizeof(unsigned long) * 8 * 64); port++) {
+    op.dom = DOMID_SELF;
+    op.port = port;
+    if (HYPERVISOR_event_channel_op(EVTCHNOP_status, &op) != 0) break;
+    if (op.status == EVTCHNSTAT_virq && op.u.virq == VIRQ_TIMER) return port;
+  }
+  return -1;
+}
+
+static int
+set_period(uint64_t ns)
+{
+  struct vcpu_set_periodic_timer t;
+
+  if (ns == 0)
+    return HYPERVISOR_vcpu_op(VCPUOP_stop_periodic_timer, 0, NULL);
+  t.period_ns = ns;
+  return HYPERVISOR_vcpu_op(VCPUOP_set_periodic_timer, 0, &t);
+}
+
+#else
+
+void
+caml_profiler_tick(struct pt_regs *regs)
+{
+}
+
+static int
+find_timer_port(void)
+{
+  return -1;
+}
+
+static int
+set_period(uint64_t ns)
+{
+  return -1;
+}
+
+#endif
+
+/* Xen cannot report the period of the periodic timer, so it is kept
+   here; 0 when the timer is stopped.  Code that changes the period
+   must go through caml_timer_set_period, so that stopping the profiler
+   puts back the right one. */
+static uint64_t timer_period = Xen_default_period;
+
+int
+caml_timer_set_period(uint64_t ns)
+{
+  int rc = set_period(ns);
+
+  if (rc == 0) timer_period = ns;
+  return rc;
+}
+
+static uintnat
+hash_stack(struct sample *smp)
+{
+  uintnat h = 0, i;
+
+  for (i = 0; i < smp->nframes; i++)
+    h ^= smp->pcs[i] + 0x9E3779B9 + (h << 6) + (h >> 2);
+  return h;
+}
+
+static int
+grow_stacks(void)
+{
+  uintnat new_mask = stacks_mask == 0 ? 255 : 2 * stacks_mask + 1;
+  struct stack **new_stacks, *st;
+  uintnat i, h;
+
+  new_stacks = calloc(new_mask + 1, sizeof(struct stack *));
+  if (new_stacks == NULL) return -1;
+  for (i = 0; stacks != NULL && i <= stacks_mask; i++) {
+    st = stacks[i];
+    if (st == NULL) continue;
+    for (h = st->hash & new_mask; new_stacks[h] != NULL;
+         h = (h + 1) & new_mask);
+    new_stacks[h] = st;
+  }
+  free(stacks);
+  stacks = new_stacks;
+  stacks_mask = new_mask;
+  return 0;
+}
+
+static void
+add_sample(struct sample *smp)
+{
+  uintnat hash = hash_stack(smp), h;
+  struct stack *st;
+
+  if (smp->nframes == 0) {
+    idle_samples++;
+    return;
+  }
+  if (2 * (num_stacks + 1) > stacks_mask + 1 && grow_stacks() != 0) {
+    dropped++;
+    return;
+  }
+  for (h = hash & stacks_mask; (st = stacks[h]) != NULL;
+       h = (h + 1) & stacks_mask) {
+    if (st->hash == hash && st->nframes == smp->nframes
+        && memcmp(st->pcs, smp->pcs, smp->nframes * sizeof(uintnat)) == 0) {
+      st->count++;
+      return;
+    }
+  }
+  st = malloc(sizeof(struct stack) + smp->nframes * sizeof(uintnat));
+  if (st == NULL) {
+    dropped++;
+    return;
+  }
+  st->hash = hash;
+  st->count = 1;
+  st->nframes = smp->nframes;
+  memcpy(st->pcs, smp->pcs, smp->nframes * sizeof(uintnat));
+  stacks[h] = st;
+  num_stacks++;
+}
+
+/* Move the samples of the ring to the table.  Called when the domain
+   is about to block, and before the profile is read. */
+void
+caml_profiler_drain(void)
+{
+  unsigned long flags;
+
+  if (ring == NULL) return;
+  local_irq_save(flags);
+  while (ring_tail != ring_head) {
+    add_sample(&ring[ring_tail & (Prof_ring - 1)]);
+    ring_tail++;
+  }
+  local_irq_restore(flags);
+}
+
+CAMLprim value
+caml_profiler_start(value v_hz)
+{
+  intnat hz = Long_val(v_hz);
+  int port;
+
+  if (hz < 1 || hz > 10000) caml_invalid_argument("Profiler.start");
+  if (timer_port >= 0) caml_failwith("Profiler.start: already running");
+  if (ring == NULL) {
+    ring = malloc(Prof_ring * sizeof(struct sample));
+    if (ring == NULL) caml_raise_out_of_memory();
+  }
+  if (caml_frame_descriptors == NULL) caml_init_frame_descriptors();
+  port = find_timer_port();
+  saved_period = timer_period;
+  if (port < 0 || caml_timer_set_period(1000000000ULL / hz) != 0)
+    caml_failwith("Profiler.start: no periodic timer");
+  timer_port = port;
+  local_irq_enable();
+  return Val_unit;
+}
+
+CAMLprim value
+caml_profiler_stop(value v_unit)
+{
+  if (timer_port < 0) return Val_unit;
+  local_irq_disable();
+  timer_port = -1;
+  caml_timer_set_period(saved_period);
+  caml_profiler_drain();
+  return Val_unit;
+}
+
+CAMLprim value
+caml_profiler_reset(value v_unit)
+{
+  uintnat i;
+
+  caml_profiler_drain();
+  for (i = 0; stacks != NULL && i <= stacks_mask; i++) {
+    free(stacks[i]);
+    stacks[i] = NULL;
+  }
+  num_stacks = 0;
+  idle_samples = 0;
+  dropped = 0;
+  return Val_unit;
+}
+
+CAMLprim value
+caml_profiler_dropped(value v_unit)
+{
+  return Val_long(dropped);
+}
+
+/* One line of the folded profile: the frames from the outermost to the
+   interrupted PC, separated by semicolons, then the count.  Return its
+   length, and write it to [buf] unless NULL. */
+static uintnat
+folded_line(struct stack *st, char *buf)
+{
+  static const char digits[] = "0123456789abcdef";
+  char tmp[24];
+  uintnat len = 0, i, n, w;
+  int j;
+
+#define PUT(c) do { if (buf != NULL) buf[len] = (c); len++; } while (0)
+  for (i = st->nframes; i > 0; i--) {
+    w = st->pcs[i - 1];
+    PUT('0'); PUT('x');
+    for (j = 0; j == 0 || w != 0; w >>= 4) tmp[j++] = digits[w & 15];
+    while (j > 0) PUT(tmp[--j]);
+    PUT(i > 1 ? ';' : ' ');
+  }
+  n = st->count;
+  for (j = 0; j == 0 || n != 0; n /= 10) tmp[j++] = '0' + n % 10;
+  while (j > 0) PUT(tmp[--j]);
+  PUT('\n');
+#undef PUT
+  return len;
+}
+
+CAMLprim value
+caml_profiler_dump(value v_unit)
+{
+  struct stack idle;
+  uintnat i, len = 0, pos = 0;
+  value res;
+
+  caml_profiler_drain();
+  for (i = 0; stacks != NULL && i <= stacks_mask; i++)
+    if (stacks[i] != NULL) len += folded_line(stacks[i], NULL);
+  idle.nframes = 0;
+  idle.count = idle_samples;
+  if (idle_samples > 0) len += strlen("[idle] ") + folded_line(&idle, NULL);
+  res = caml_alloc_string(len);
+  for (i = 0; stacks != NULL && i <= stacks_mask; i++)
+    if (stacks[i] != NULL)
+      pos += folded_line(stacks[i], String_val(res) + pos);
+  if (idle_samples > 0) {
+    memcpy(String_val(res) + pos, "[idle] ", strlen("[idle] "));
+    pos += strlen("[idle] ");
+    pos += folded_line(&idle, String_val(res) + pos);
+  }
+  return res;
+}
+
+CAMLprim value
+caml_profiler_print(value v_unit)
+{
+  char line[Prof_depth * 20 + 24];
+  struct stack *st;
+  uintnat i, len;
+
+  caml_profiler_drain();
+  for (i = 0; stacks != NULL && i <= stacks_mask; i++) {
+    st = stacks[i];
+    if (st == NULL) continue;
+    len = folded_line(st, line);
+    line[len] = 0;
+    printk("%s", line);
+  }
+  if (idle_samples > 0) printk("[idle] %lu\n", (unsigned long) idle_samples);
+  return Val_unit;
+}
@@ -0,0 +1,81 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* mirage-metrics DOMID [INTERVAL]
+
+   Print the metrics of a Mirage domain once, or every INTERVAL seconds
+   with the difference since the previous sample for counters. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "mirage_metrics.h"
+
+static void
+print(struct mirage_metrics *m, struct mirage_metrics *prev)
+{
+  unsigned int i;
+
+  for (i = 0; i < m->nfields; i++) {
+    if (i < mirage_metrics_nnames)
+      printf("%-20s", mirage_metrics_names[i]);
+    else
+      printf("field%-15u", i);
+    printf(" %20llu", (unsigned long long) m->field[i]);
+    if (prev != NULL && i < prev->nfields)
+      printf(" %+20lld", (long long) (m->field[i] - prev->field[i]));
+    printf("\n");
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+  struct mirage_metrics_handle *h;
+  static struct mirage_metrics m, prev;
+  int domid, interval = 0, first = 1;
+
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: %s DOMID [INTERVAL]\n", argv[0]);
+    return 2;
+  }
+  domid = atoi(argv[1]);
+  if (argc == 3) interval = atoi(argv[2]);
+
+  h = mirage_metrics_open(domid);
+  if (h == NULL) {
+    fprintf(stderr, "%s: cannot map the metrics page of domain %d: %s\n",
+            argv[0], domid, strerror(errno));
+    return 1;
+  }
+  do {
+    if (mirage_metrics_read(h, &m) != 0) {
+      fprintf(stderr, "%s: no consistent metrics page\n", argv[0]);
+      mirage_metrics_close(h);
+      return 1;
+    }
+    print(&m, first ? NULL : &prev);
+    prev = m;
+    first = 0;
+    if (interval > 0) sleep(interval);
+  } while (interval > 0);
+  mirage_metrics_close(h);
+  return 0;
+}
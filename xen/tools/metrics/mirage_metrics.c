@@ -0,0 +1,123 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <xenctrl.h>
+#include <xenstore.h>
+
+#include "mirage_metrics.h"
+
+#define MAGIC 0x54454D4D            /* "MMET" */
+#define HEADER 16
+#define ATTEMPTS 1000
+
+const char *mirage_metrics_names[] = {
+  "updated", "minor_words", "promoted_words", "major_words",
+  "minor_collections", "major_collections", "compactions",
+  "heap_bytes", "top_heap_bytes", "heap_chunks",
+  "external_bytes", "external_peak", "region_pages", "region_mapped",
+  "events", "blocks", "run_ns", "sweep_ns", "blocked_ns", "timers",
+};
+const unsigned int mirage_metrics_nnames =
+  sizeof(mirage_metrics_names) / sizeof(mirage_metrics_names[0]);
+
+struct mirage_metrics_handle {
+  xc_gnttab *xcg;
+  void *page;
+};
+
+/* The page is written by a little-endian guest on the same host. */
+static uint32_t
+load32(const volatile void *page, int ofs)
+{
+  return *(const volatile uint32_t *) ((const volatile char *) page + ofs);
+}
+
+int
+mirage_metrics_decode(const volatile void *page, struct mirage_metrics *m)
+{
+  const volatile uint64_t *fields =
+    (const volatile uint64_t *) ((const volatile char *) page + HEADER);
+  uint32_t seq, n, i;
+  int attempt;
+
+  if (load32(page, 0) != MAGIC || load32(page, 4) != MIRAGE_METRICS_VERSION)
+    return -1;
+  for (attempt = 0; attempt < ATTEMPTS; attempt++) {
+    seq = load32(page, 8);
+    if (seq & 1) continue;
+    __sync_synchronize();
+    n = load32(page, 12);
+    if (n > MIRAGE_METRICS_MAX) n = MIRAGE_METRICS_MAX;
+    for (i = 0; i < n; i++) m->field[i] = fields[i];
+    m->nfields = n;
+    __sync_synchronize();
+    if (load32(page, 8) == seq) return 0;
+  }
+  return -1;
+}
+
+struct mirage_metrics_handle *
+mirage_metrics_open(int domid)
+{
+  struct mirage_metrics_handle *h;
+  struct xs_handle *xs;
+  char path[64], *ref;
+  unsigned int len;
+  int saved;
+
+  xs = xs_open(XS_OPEN_READONLY);
+  if (xs == NULL) return NULL;
+  snprintf(path, sizeof(path), "/local/domain/%d/data/metrics/page-ref", domid);
+  ref = xs_read(xs, XBT_NULL, path, &len);
+  xs_close(xs);
+  if (ref == NULL) return NULL;
+
+  h = calloc(1, sizeof(*h));
+  if (h == NULL) goto fail;
+  h->xcg = xc_gnttab_open(NULL, 0);
+  if (h->xcg == NULL) goto fail;
+  h->page = xc_gnttab_map_grant_ref(h->xcg, domid, strtoul(ref, NULL, 10),
+                                    PROT_READ);
+  if (h->page == NULL) goto fail;
+  free(ref);
+  return h;
+
+fail:
+  saved = errno;
+  if (h != NULL && h->xcg != NULL) xc_gnttab_close(h->xcg);
+  free(h);
+  free(ref);
+  errno = saved;
+  return NULL;
+}
+
+int
+mirage_metrics_read(struct mirage_metrics_handle *h, struct mirage_metrics *m)
+{
+  return mirage_metrics_decode(h->page, m);
+}
+
+void
+mirage_metrics_close(struct mirage_metrics_handle *h)
+{
+  xc_gnttab_munmap(h->xcg, h->page, 1);
+  xc_gnttab_close(h->xcg);
+  free(h);
+}
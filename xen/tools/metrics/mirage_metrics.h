@@ -0,0 +1,54 @@
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Reader for the metrics page of a Mirage domain.
+
+   The page is described in xen/lib/metrics.mli.  Its grant reference is
+   in /local/domain/<domid>/data/metrics/page-ref in XenStore. */
+
+#ifndef MIRAGE_METRICS_H
+#define MIRAGE_METRICS_H
+
+#include <stdint.h>
+
+#define MIRAGE_METRICS_VERSION 1
+#define MIRAGE_METRICS_MAX 500      /* fields that fit in a page */
+
+struct mirage_metrics {
+  uint32_t nfields;
+  uint64_t field[MIRAGE_METRICS_MAX];
+};
+
+/* Names of the fields known to this reader, in page order. */
+extern const char *mirage_metrics_names[];
+extern const unsigned int mirage_metrics_nnames;
+
+/* Copy a consistent snapshot of [page] to [m].  Return 0 on success,
+   -1 if [page] is not a metrics page of a known version, or if it
+   was being updated during every attempt. */
+int mirage_metrics_decode(const volatile void *page, struct mirage_metrics *m);
+
+struct mirage_metrics_handle;
+
+/* Map the metrics page of domain [domid]; NULL on failure, with errno
+   set. */
+struct mirage_metrics_handle *mirage_metrics_open(int domid);
+
+int mirage_metrics_read(struct mirage_metrics_handle *h,
+                        struct mirage_metrics *m);
+
+void mirage_metrics_close(struct mirage_metrics_handle *h);
+
+#endif /* MIRAGE_METRICS_H */